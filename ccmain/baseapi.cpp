@@ -18,6 +18,9 @@
  **********************************************************************/
 
 #include "baseapi.h"
+// svutil.h includes <string>, so it has to come before the min and max
+// macros of cutil.h.
+#include "svutil.h"
 
 
 // Include automatically generated configuration file if running autoconf.
@@ -52,13 +55,40 @@
 #include "tface.h"
 #include "permute.h"
 
+// The grey level thresholding uses SSE2 when the whole file is compiled
+// for it, as on x86-64.
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define THRESHOLD_SSE2
+#endif
+
 BOOL_VAR(tessedit_resegment_from_boxes, FALSE,
          "Take segmentation and labeling from box file");
 BOOL_VAR(tessedit_train_from_boxes, FALSE,
          "Generate training data from boxed chars");
+BOOL_VAR(tessedit_zero_copy_input, FALSE,
+         "Use binary images given to the API in place instead of copying");
+INT_VAR(tessedit_threshold_tile_size, 0,
+        "Size of tiles for local thresholding, 0 for a global threshold");
+INT_VAR(tessedit_threshold_threads, 4,
+        "Number of threads used for local thresholding");
 
 // Minimum sensible image size to be worth running tesseract.
 const int kMinRectSize = 10;
+// Most channels whose thresholds are kept on the stack.
+const int kMaxStackChannels = 4;
+// Number of separate banks of counts HistogramRect keeps.
+const int kHistogramBanks = 4;
+// Least difference between the means of the two classes of a tile for it
+// to get its own threshold.
+const int kMinTileContrast = 32;
+// How far the threshold of a tile without contrast is kept from the level
+// of its background.
+const int kFlatTileMargin = kMinTileContrast / 2;
+// Number of lines in each work item of LocalThresholdRect.
+const int kThresholdStripHeight = 32;
+// Bits of fraction in the interpolated thresholds.
+const int kThresholdFractionBits = 16;
 
 static STRING input_file = "noname.tif";
 
@@ -198,6 +228,66 @@ char* TessBaseAPI::TesseractRectUNLV(const unsigned char* imagedata,
   return TesseractToUNLV(page_res);
 }
 
+// Recognize a batch of image rectangles, handing each result to callback.
+// The page image keeps its memory between items of the same size, the
+// thresholds stay on the stack, the block list is emptied rather than
+// remade, and the text goes into one buffer that only grows.
+int TessBaseAPI::TesseractBatch(const TessBatchItem* items, int count,
+                                bool reset_adaptive,
+                                TessBatchCallback callback, void* cookie) {
+  BLOCK_LIST block_list;
+  char* text = NULL;
+  int text_size = 0;
+  int done = 0;
+  for (int i = 0; i < count; ++i) {
+    const TessBatchItem* item = &items[i];
+    if (item->width < kMinRectSize || item->height < kMinRectSize) {
+      if (callback != NULL)
+        callback(item, i, NULL, cookie);
+      continue;
+    }
+    if (reset_adaptive)
+      ResetAdaptiveClassifier();
+    CopyImageToTesseract(item->imagedata, item->bytes_per_pixel,
+                         item->bytes_per_line, item->left, item->top,
+                         item->width, item->height);
+    FindLines(&block_list);
+    PAGE_RES* page_res = Recognize(&block_list, NULL);
+    int length = TextLength(page_res);
+    if (length > text_size) {
+      delete [] text;
+      text_size = length * 2;
+      text = new char[text_size];
+    }
+    WriteText(page_res, text);
+    delete page_res;
+    block_list.clear();
+    ++done;
+    if (callback != NULL)
+      callback(item, i, text, cookie);
+  }
+  delete [] text;
+  return done;
+}
+
+// Recognize an image made by ThresholdToImage, making it the global
+// page image, and return the text in the given format.
+char* TessBaseAPI::RecognizeImage(IMAGE* image, TessOutputFormat format) {
+  page_image = *image;
+  BLOCK_LIST    block_list;
+
+  FindLines(&block_list);
+
+  // Now run the main recognition.
+  PAGE_RES* page_res = Recognize(&block_list, NULL);
+
+  if (format == TESS_OUTPUT_BOX_TEXT)
+    return TesseractToBoxText(page_res, 0, 0);
+  else if (format == TESS_OUTPUT_UNLV)
+    return TesseractToUNLV(page_res);
+  return TesseractToText(page_res);
+}
+
 // Call between pages or documents etc to free up memory and forget
 // adaptive data.
 void TessBaseAPI::ClearAdaptiveClassifier() {
@@ -242,24 +332,60 @@ void TessBaseAPI::CopyImageToTesseract(const unsigned char* imagedata,
                                        int bytes_per_line,
                                        int left, int top,
                                        int width, int height) {
+  if (bytes_per_pixel == 0 && tessedit_zero_copy_input && left % 8 == 0 &&
+      page_image.capture(const_cast<unsigned char*>(imagedata) +
+                         top * bytes_per_line + left / 8,
+                         width, height, 1, bytes_per_line) == 0) {
+    return;  // The lines are read where they are.
+  }
+  ThresholdToImage(imagedata, bytes_per_pixel, bytes_per_line,
+                   left, top, width, height, &page_image);
+}
+
+// Copy the given image rectangle to the given image, with adaptive
+// thresholding if the image is not already binary.
+void TessBaseAPI::ThresholdToImage(const unsigned char* imagedata,
+                                   int bytes_per_pixel,
+                                   int bytes_per_line,
+                                   int left, int top,
+                                   int width, int height,
+                                   IMAGE* image) {
   if (bytes_per_pixel > 0) {
-    // Threshold grey or color.
-    int* thresholds = new int[bytes_per_pixel];
-    int* hi_values = new int[bytes_per_pixel];
+    // Threshold grey or color. The usual 1, 3 or 4 channels fit on the
+    // stack, so there is nothing to allocate per call.
+    int stack_thresholds[kMaxStackChannels];
+    int stack_hi_values[kMaxStackChannels];
+    int* thresholds = stack_thresholds;
+    int* hi_values = stack_hi_values;
+    if (bytes_per_pixel > kMaxStackChannels) {
+      thresholds = new int[bytes_per_pixel];
+      hi_values = new int[bytes_per_pixel];
+    }
 
     // Compute the thresholds.
     OtsuThreshold(imagedata, bytes_per_pixel, bytes_per_line,
                   left, top, left + width, top + height,
                   thresholds, hi_values);
 
-    // Threshold the image to the tesseract global page_image.
-    ThresholdRect(imagedata, bytes_per_pixel, bytes_per_line,
-                  left, top, width, height,
-                  thresholds, hi_values);
-    delete [] thresholds;
-    delete [] hi_values;
+    // Threshold the image to the target image.
+    int tile_size = MAX(tessedit_threshold_tile_size, kMinRectSize);
+    if (tessedit_threshold_tile_size > 0 &&
+        (width >= 2 * tile_size || height >= 2 * tile_size)) {
+      LocalThresholdRect(imagedata, bytes_per_pixel, bytes_per_line,
+                         left, top, width, height,
+                         thresholds, hi_values, tile_size, image);
+    } else {
+      ThresholdRect(imagedata, bytes_per_pixel, bytes_per_line,
+                    left, top, width, height,
+                    thresholds, hi_values, image);
+    }
+    if (thresholds != stack_thresholds) {
+      delete [] thresholds;
+      delete [] hi_values;
+    }
   } else {
-    CopyBinaryRect(imagedata, bytes_per_line, left, top, width, height);
+    CopyBinaryRect(imagedata, bytes_per_line, left, top, width, height,
+                   image);
   }
 }
 
@@ -339,16 +465,32 @@ void TessBaseAPI::HistogramRect(const unsigned char* imagedata,
                                 int left, int top, int right, int bottom,
                                 int* histogram) {
   int width = right - left;
-  memset(histogram, 0, sizeof(*histogram) * 256);
+  // Consecutive pixels are counted in separate banks, so that a run of
+  // equal pixels does not make each increment wait for the one before.
+  int banks[kHistogramBanks][256];
+  memset(banks, 0, sizeof(banks));
   const unsigned char* pixels = imagedata +
                                 top*bytes_per_line +
                                 left*bytes_per_pixel;
+  int step = kHistogramBanks * bytes_per_pixel;
   for (int y = top; y < bottom; ++y) {
-    for (int x = 0; x < width; ++x) {
-      ++histogram[pixels[x * bytes_per_pixel]];
+    const unsigned char* pix = pixels;
+    int x = 0;
+    for (; x + kHistogramBanks <= width; x += kHistogramBanks) {
+      ++banks[0][pix[0]];
+      ++banks[1][pix[bytes_per_pixel]];
+      ++banks[2][pix[2 * bytes_per_pixel]];
+      ++banks[3][pix[3 * bytes_per_pixel]];
+      pix += step;
+    }
+    for (; x < width; ++x) {
+      ++banks[0][*pix];
+      pix += bytes_per_pixel;
     }
     pixels += bytes_per_line;
   }
+  for (int i = 0; i < 256; ++i)
+    histogram[i] = banks[0][i] + banks[1][i] + banks[2][i] + banks[3][i];
 }
 
 // Compute the Otsu threshold(s) for the given histogram.
@@ -394,8 +536,39 @@ int TessBaseAPI::OtsuStats(const int* histogram,
   return best_t;
 }
 
-// Threshold the given grey or color image into the tesseract global
-// image ready for recognition. Requires thresholds and hi_value
+#ifdef THRESHOLD_SSE2
+// Reverse the order of the bits in a byte.
+static inline uinT8 ReverseBits(uinT8 b) {
+  return ((b * 0x0802LU & 0x22110LU) | (b * 0x8020LU & 0x88440LU)) *
+         0x10101LU >> 16;
+}
+
+// Threshold the first pixels of a line of one byte per pixel, 16 at a
+// time, packing them into out as ThresholdRect does. Returns the number
+// of pixels done, a multiple of 16.
+static int ThresholdGreyLine(const unsigned char* pix, int width,
+                             int threshold, int hi_value, uinT8* out) {
+  if (hi_value < 0)
+    return 0;  // Nothing is black, which the plain loop does as well.
+  // above is set where the pixel is > threshold, flip where that is white.
+  __m128i min_above = _mm_set1_epi8(static_cast<char>(threshold + 1));
+  __m128i flip = _mm_set1_epi8(hi_value == 0 ? 0 : -1);
+  __m128i none_above = _mm_set1_epi8(threshold >= 255 ? -1 : 0);
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pix + x));
+    __m128i above = _mm_cmpeq_epi8(_mm_max_epu8(v, min_above), v);
+    above = _mm_andnot_si128(none_above, above);
+    int black = _mm_movemask_epi8(_mm_xor_si128(above, flip));
+    out[x / 8] = ReverseBits(~black & 0xff);
+    out[x / 8 + 1] = ReverseBits((~black >> 8) & 0xff);
+  }
+  return x;
+}
+#endif
+
+// Threshold the given grey or color image into the given image
+// ready for recognition. Requires thresholds and hi_value
 // produced by OtsuThreshold above.
 void TessBaseAPI::ThresholdRect(const unsigned char* imagedata,
                                 int bytes_per_pixel,
@@ -403,44 +576,369 @@ void TessBaseAPI::ThresholdRect(const unsigned char* imagedata,
                                 int left, int top,
                                 int width, int height,
                                 const int* thresholds,
-                                const int* hi_values) {
-  IMAGELINE line;
-  page_image.create(width, height, 1);
-  line.init(width);
-  // For each line in the image, fill the IMAGELINE class and put it into the
-  // Tesseract global page_image. Note that Tesseract stores images with the
-  // bottom at y=0 and 0 is black, so we need 2 kinds of inversion.
+                                const int* hi_values,
+                                IMAGE* image) {
+  image->reuse_or_create(width, height, 1);
+  // The bits are packed straight into the image buffer, which holds the
+  // top line first, 8 pixels to a byte with the first in the MSB, and
+  // 1 for white. Any bits past the width are left 0, as create leaves them.
+  int image_bytes_per_line = check_legal_image_size(width, height, 1);
+  uinT8* dest = image->get_buffer();
+  // black_tables[ch * 256 + value] is 1 if value makes the pixel black.
+  uinT8 stack_tables[kMaxStackChannels * 256];
+  uinT8* black_tables = stack_tables;
+  if (bytes_per_pixel > kMaxStackChannels)
+    black_tables = new uinT8[bytes_per_pixel * 256];
+  for (int ch = 0; ch < bytes_per_pixel; ++ch) {
+    for (int value = 0; value < 256; ++value) {
+      black_tables[ch * 256 + value] =
+          hi_values[ch] >= 0 &&
+          (value > thresholds[ch]) == (hi_values[ch] == 0);
+    }
+  }
   const unsigned char* data = imagedata + top*bytes_per_line +
                               left*bytes_per_pixel;
-  for (int y = height - 1 ; y >= 0; --y) {
+  for (int y = 0; y < height; ++y) {
     const unsigned char* pix = data;
-    for (int x = 0; x < width; ++x, pix += bytes_per_pixel) {
-      line.pixels[x] = 1;
+    uinT8* out = dest;
+    int x = 0;
+#ifdef THRESHOLD_SSE2
+    if (bytes_per_pixel == 1)
+      x = ThresholdGreyLine(pix, width, thresholds[0], hi_values[0], out);
+    pix += x;
+    out += x / 8;
+#endif
+    uinT8 bits = 0;
+    for (; x < width; ++x) {
+      int black = 0;
+      for (int ch = 0; ch < bytes_per_pixel; ++ch)
+        black |= black_tables[ch * 256 + pix[ch]];
+      bits = (bits << 1) | (black ^ 1);
+      pix += bytes_per_pixel;
+      if ((x & 7) == 7) {
+        *out++ = bits;
+        bits = 0;
+      }
+    }
+    if (width & 7)
+      *out = bits << (8 - (width & 7));
+    data += bytes_per_line;
+    dest += image_bytes_per_line;
+  }
+  if (black_tables != stack_tables)
+    delete [] black_tables;
+}
+
+// The work shared between the threads of LocalThresholdRect.
+struct LOCAL_THRESHOLD {
+  const unsigned char* imagedata;
+  int bytes_per_pixel;
+  int bytes_per_line;
+  int left;
+  int top;
+  int width;
+  int height;
+  const int* thresholds;     // Global thresholds and hi_values.
+  const int* hi_values;
+  int tiles_x;               // Number of tiles across and down.
+  int tiles_y;
+  int* tile_thresholds;      // bytes_per_pixel for each tile, row by row.
+  bool* tile_flat;           // True where the tile has too little contrast.
+  int* tile_limits;          // Furthest threshold of a flat tile from
+                             // its background.
+  uinT8* dest;               // Top line of the image buffer.
+  int dest_bytes_per_line;
+
+  SVMutex lock;              // Guards next_item.
+  int next_item;
+  int item_count;
+
+  // Start and centre of tile i of n over size pixels.
+  static int TileStart(int i, int n, int size) {
+    return i * size / n;
+  }
+  static int TileCentre(int i, int n, int size) {
+    return (TileStart(i, n, size) + TileStart(i + 1, n, size)) / 2;
+  }
+  // Returns the next item to work on, or -1 when there are none left.
+  int NextItem() {
+    lock.Lock();
+    int item = next_item < item_count ? next_item++ : -1;
+    lock.Unlock();
+    return item;
+  }
+};
+
+// Gives each flat tile of a LOCAL_THRESHOLD the mean threshold of the
+// nearest tiles with contrast, or the global threshold if there are none,
+// but no closer to its own background than its limit. Without the limit,
+// a dark but blank part of a page would come out black.
+static void FillFlatTiles(LOCAL_THRESHOLD* job) {
+  int bytes_per_pixel = job->bytes_per_pixel;
+  int tiles_x = job->tiles_x;
+  int tiles_y = job->tiles_y;
+  for (int tile_y = 0; tile_y < tiles_y; ++tile_y) {
+    for (int tile_x = 0; tile_x < tiles_x; ++tile_x) {
       for (int ch = 0; ch < bytes_per_pixel; ++ch) {
-        if (hi_values[ch] >= 0 &&
-            (pix[ch] > thresholds[ch]) == (hi_values[ch] == 0)) {
-          line.pixels[x] = 0;
-          break;
+        int index = (tile_y * tiles_x + tile_x) * bytes_per_pixel + ch;
+        if (!job->tile_flat[index])
+          continue;
+        // Search rings of tiles at increasing distance.
+        int total = 0;
+        int count = 0;
+        int max_dist = MAX(tiles_x, tiles_y);
+        for (int dist = 1; dist < max_dist && count == 0; ++dist) {
+          for (int y = tile_y - dist; y <= tile_y + dist; ++y) {
+            if (y < 0 || y >= tiles_y)
+              continue;
+            int step = y == tile_y - dist || y == tile_y + dist ? 1 : 2 * dist;
+            for (int x = tile_x - dist; x <= tile_x + dist; x += step) {
+              if (x < 0 || x >= tiles_x)
+                continue;
+              int other = (y * tiles_x + x) * bytes_per_pixel + ch;
+              if (!job->tile_flat[other]) {
+                total += job->tile_thresholds[other];
+                ++count;
+              }
+            }
+          }
         }
+        int threshold = count > 0 ? total / count : job->thresholds[ch];
+        if (job->hi_values[ch] == 0)
+          threshold = MAX(threshold, job->tile_limits[index]);
+        else
+          threshold = MIN(threshold, job->tile_limits[index]);
+        job->tile_thresholds[index] = threshold;
       }
     }
-    page_image.put_line(0, y, width, &line, 0);
-    data += bytes_per_line;
   }
 }
 
+void TessBaseAPI::LocalThresholdRect(const unsigned char* imagedata,
+                                     int bytes_per_pixel,
+                                     int bytes_per_line,
+                                     int left, int top,
+                                     int width, int height,
+                                     const int* thresholds,
+                                     const int* hi_values,
+                                     int tile_size,
+                                     IMAGE* image) {
+  image->reuse_or_create(width, height, 1);
+  LOCAL_THRESHOLD job;
+  job.imagedata = imagedata;
+  job.bytes_per_pixel = bytes_per_pixel;
+  job.bytes_per_line = bytes_per_line;
+  job.left = left;
+  job.top = top;
+  job.width = width;
+  job.height = height;
+  job.thresholds = thresholds;
+  job.hi_values = hi_values;
+  job.tiles_x = MAX(width / tile_size, 1);
+  job.tiles_y = MAX(height / tile_size, 1);
+  job.tile_thresholds = new int[job.tiles_x * job.tiles_y * bytes_per_pixel];
+  job.tile_flat = new bool[job.tiles_x * job.tiles_y * bytes_per_pixel];
+  job.tile_limits = new int[job.tiles_x * job.tiles_y * bytes_per_pixel];
+  job.dest = image->get_buffer();
+  job.dest_bytes_per_line = check_legal_image_size(width, height, 1);
+
+  // All the tile thresholds are needed before any line can be done, so
+  // run the threads once over the tile rows and again over the strips.
+  void* (*stages[])(void*) = { ThresholdTileRows, ThresholdLocalStrips };
+  int stage_items[] = {
+    job.tiles_y, (height + kThresholdStripHeight - 1) / kThresholdStripHeight
+  };
+  for (int stage = 0; stage < 2; ++stage) {
+    job.next_item = 0;
+    job.item_count = stage_items[stage];
+    int thread_count = MIN(MAX(tessedit_threshold_threads, 1),
+                           job.item_count);
+    // The calling thread is one of the workers. It takes the items of any
+    // thread that could not be started.
+    SVThread* threads = new SVThread[thread_count];
+    int started = 0;
+    for (int t = 1; t < thread_count; ++t) {
+      if (SVSync::StartJoinableThread(stages[stage], &job, &threads[started]))
+        ++started;
+    }
+    stages[stage](&job);
+    for (int t = 0; t < started; ++t)
+      SVSync::JoinThread(threads[t]);
+    delete [] threads;
+    if (stage == 0)
+      FillFlatTiles(&job);
+  }
+  delete [] job.tile_thresholds;
+  delete [] job.tile_flat;
+  delete [] job.tile_limits;
+}
+
+void* TessBaseAPI::ThresholdTileRows(void* arg) {
+  LOCAL_THRESHOLD* job = reinterpret_cast<LOCAL_THRESHOLD*>(arg);
+  int bytes_per_pixel = job->bytes_per_pixel;
+  int tile_y;
+  while ((tile_y = job->NextItem()) >= 0) {
+    int top = job->top + LOCAL_THRESHOLD::TileStart(tile_y, job->tiles_y,
+                                                    job->height);
+    int bottom = job->top + LOCAL_THRESHOLD::TileStart(tile_y + 1,
+                                                       job->tiles_y,
+                                                       job->height);
+    for (int tile_x = 0; tile_x < job->tiles_x; ++tile_x) {
+      int left = job->left + LOCAL_THRESHOLD::TileStart(tile_x, job->tiles_x,
+                                                        job->width);
+      int right = job->left + LOCAL_THRESHOLD::TileStart(tile_x + 1,
+                                                         job->tiles_x,
+                                                         job->width);
+      int index = (tile_y * job->tiles_x + tile_x) * bytes_per_pixel;
+      int* tile_thresholds = job->tile_thresholds + index;
+      bool* tile_flat = job->tile_flat + index;
+      int* tile_limits = job->tile_limits + index;
+      for (int ch = 0; ch < bytes_per_pixel; ++ch) {
+        tile_thresholds[ch] = job->thresholds[ch];
+        tile_flat[ch] = false;
+        if (job->hi_values[ch] < 0)
+          continue;  // The channel is not used at all.
+        int histogram[256];
+        HistogramRect(job->imagedata + ch, bytes_per_pixel,
+                      job->bytes_per_line, left, top, right, bottom,
+                      histogram);
+        int H;
+        int omega_0;
+        int t = OtsuStats(histogram, &H, &omega_0);
+        double sum_0 = 0.0;
+        double sum_1 = 0.0;
+        for (int i = 0; i < 256; ++i) {
+          if (i <= t)
+            sum_0 += i * static_cast<double>(histogram[i]);
+          else
+            sum_1 += i * static_cast<double>(histogram[i]);
+        }
+        // A tile of a single level has all of it in one class.
+        double mean_0 = omega_0 > 0 ? sum_0 / omega_0 : sum_1 / H;
+        double mean_1 = omega_0 < H ? sum_1 / (H - omega_0) : sum_0 / H;
+        // Only a tile with clearly separate classes, ie some foreground,
+        // gets to keep its own threshold. The rest are taken to be all
+        // background, so the threshold may not come closer than the
+        // margin to the background side of the tile.
+        if (mean_1 - mean_0 >= kMinTileContrast) {
+          tile_thresholds[ch] = t;
+        } else {
+          tile_flat[ch] = true;
+          if (job->hi_values[ch] == 0)
+            tile_limits[ch] = static_cast<int>(mean_1) + kFlatTileMargin;
+          else
+            tile_limits[ch] = static_cast<int>(mean_0) - kFlatTileMargin;
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
+void* TessBaseAPI::ThresholdLocalStrips(void* arg) {
+  LOCAL_THRESHOLD* job = reinterpret_cast<LOCAL_THRESHOLD*>(arg);
+  int bytes_per_pixel = job->bytes_per_pixel;
+  int width = job->width;
+  int tiles_x = job->tiles_x;
+  int tiles_y = job->tiles_y;
+  const int kHalf = 1 << (kThresholdFractionBits - 1);
+  // Thresholds of the tile columns at the current line, with fraction bits.
+  int* column_thresholds = new int[tiles_x * bytes_per_pixel];
+  // Threshold of each channel of each pixel of the current line.
+  int* line_thresholds = new int[width * bytes_per_pixel];
+  int strip;
+  while ((strip = job->NextItem()) >= 0) {
+    int y_end = MIN((strip + 1) * kThresholdStripHeight, job->height);
+    for (int y = strip * kThresholdStripHeight; y < y_end; ++y) {
+      // Interpolate between the rows of tiles with centres either side of y.
+      int row = 0;
+      while (row + 1 < tiles_y &&
+             LOCAL_THRESHOLD::TileCentre(row + 1, tiles_y, job->height) <= y)
+        ++row;
+      int next_row = row;
+      int dy = 0;
+      int span_y = 1;
+      int centre_y = LOCAL_THRESHOLD::TileCentre(row, tiles_y, job->height);
+      if (row + 1 < tiles_y && y > centre_y) {
+        next_row = row + 1;
+        span_y = LOCAL_THRESHOLD::TileCentre(next_row, tiles_y, job->height) -
+                 centre_y;
+        dy = y - centre_y;
+      }
+      const int* upper = job->tile_thresholds + row * tiles_x * bytes_per_pixel;
+      const int* lower = job->tile_thresholds +
+                         next_row * tiles_x * bytes_per_pixel;
+      for (int i = 0; i < tiles_x * bytes_per_pixel; ++i) {
+        column_thresholds[i] = (upper[i] << kThresholdFractionBits) +
+            ((lower[i] - upper[i]) << kThresholdFractionBits) / span_y * dy;
+      }
+      // Then along the line between the columns of tiles. Before the
+      // first and after the last centre, the threshold stays put.
+      for (int col = -1; col < tiles_x; ++col) {
+        int start = col < 0 ? 0 : LOCAL_THRESHOLD::TileCentre(col, tiles_x,
+                                                               width);
+        int end = col + 1 < tiles_x
+                ? LOCAL_THRESHOLD::TileCentre(col + 1, tiles_x, width) : width;
+        const int* from = column_thresholds + MAX(col, 0) * bytes_per_pixel;
+        const int* to = column_thresholds +
+                        MIN(col + 1, tiles_x - 1) * bytes_per_pixel;
+        for (int ch = 0; ch < bytes_per_pixel; ++ch) {
+          int value = from[ch];
+          int step = 0;
+          if (col >= 0 && col + 1 < tiles_x && end > start)
+            step = (to[ch] - from[ch]) / (end - start);
+          int* out = line_thresholds + start * bytes_per_pixel + ch;
+          for (int x = start; x < end; ++x) {
+            *out = (value + kHalf) >> kThresholdFractionBits;
+            value += step;
+            out += bytes_per_pixel;
+          }
+        }
+      }
+      // Threshold and pack the line as ThresholdRect does.
+      const unsigned char* pix = job->imagedata +
+                                 (job->top + y) * job->bytes_per_line +
+                                 job->left * bytes_per_pixel;
+      const int* threshold = line_thresholds;
+      uinT8* out = job->dest + y * job->dest_bytes_per_line;
+      uinT8 bits = 0;
+      for (int x = 0; x < width; ++x) {
+        int black = 0;
+        for (int ch = 0; ch < bytes_per_pixel; ++ch) {
+          int hi_value = job->hi_values[ch];
+          black |= hi_value >= 0 &&
+                   (pix[ch] > threshold[ch]) == (hi_value == 0);
+        }
+        bits = (bits << 1) | (black ^ 1);
+        pix += bytes_per_pixel;
+        threshold += bytes_per_pixel;
+        if ((x & 7) == 7) {
+          *out++ = bits;
+          bits = 0;
+        }
+      }
+      if (width & 7)
+        *out = bits << (8 - (width & 7));
+    }
+  }
+  delete [] column_thresholds;
+  delete [] line_thresholds;
+  return NULL;
+}
+
 // Cut out the requested rectangle of the binary image to the
-// tesseract global image ready for recognition.
+// given image ready for recognition.
 void TessBaseAPI::CopyBinaryRect(const unsigned char* imagedata,
                                  int bytes_per_line,
                                  int left, int top,
-                                 int width, int height) {
+                                 int width, int height,
+                                 IMAGE* image) {
   // Copy binary image, cutting out the required rectangle.
-  IMAGE image;
-  image.capture(const_cast<unsigned char*>(imagedata),
-                bytes_per_line*8, top + height, 1);
-  page_image.create(width, height, 1);
-  copy_sub_image(&image, left, 0, width, height, &page_image, 0, 0, false);
+  IMAGE source;
+  source.capture(const_cast<unsigned char*>(imagedata),
+                 bytes_per_line*8, top + height, 1);
+  image->reuse_or_create(width, height, 1);
+  copy_sub_image(&source, left, 0, width, height, image, 0, 0, false);
 }
 
 // Low-level function to recognize the current global image to a string.
@@ -539,31 +1037,36 @@ int TessBaseAPI::TextConf(PAGE_RES* page_res) {
 // The input page_res is deleted.
 char* TessBaseAPI::TesseractToText(PAGE_RES* page_res) {
   if (page_res != NULL) {
-    int total_length = TextLength(page_res);
-    PAGE_RES_IT   page_res_it(page_res);
-    char* result = new char[total_length];
-    char* ptr = result;
-    for (page_res_it.restart_page(); page_res_it.word () != NULL;
-         page_res_it.forward()) {
-      WERD_RES *word = page_res_it.word();
-      WERD_CHOICE* choice = word->best_choice;
-      if (choice != NULL) {
-        strcpy(ptr, choice->string().string());
-        ptr += strlen(ptr);
-        if (word->word->flag(W_EOL))
-          *ptr++ = '\n';
-        else
-          *ptr++ = ' ';
-      }
-    }
-    *ptr++ = '\n';
-    *ptr = '\0';
+    char* result = new char[TextLength(page_res)];
+    WriteText(page_res, result);
     delete page_res;
     return result;
   }
   return NULL;
 }
 
+// Write the text of page_res into result, which must have room for
+// TextLength(page_res) characters.
+void TessBaseAPI::WriteText(PAGE_RES* page_res, char* result) {
+  PAGE_RES_IT   page_res_it(page_res);
+  char* ptr = result;
+  for (page_res_it.restart_page(); page_res_it.word () != NULL;
+       page_res_it.forward()) {
+    WERD_RES *word = page_res_it.word();
+    WERD_CHOICE* choice = word->best_choice;
+    if (choice != NULL) {
+      strcpy(ptr, choice->string().string());
+      ptr += strlen(ptr);
+      if (word->word->flag(W_EOL))
+        *ptr++ = '\n';
+      else
+        *ptr++ = ' ';
+    }
+  }
+  *ptr++ = '\n';
+  *ptr = '\0';
+}
+
 static int ConvertWordToBoxText(WERD_RES *word,
                                 ROW_RES* row,
                                 int left,
@@ -1120,3 +1623,314 @@ int TessBaseAPI::TesseractExtractResult(char** string,
 int TessBaseAPI::IsValidWord(const char *string) {
   return valid_word(string);
 }
+
+// One setting made with TessBaseEngine::SetVariable.
+struct TessEngineVariable {
+  STRING name;
+  STRING value;
+  STRING saved;       // Value before this engine was loaded.
+  bool has_saved;     // saved is valid.
+};
+
+// Private data of a TessBaseEngine.
+class TessEngineData {
+ public:
+  TessEngineData()
+    : numeric_mode(false), initialized(false), adapted_templates(NULL),
+      variables(NULL), num_variables(0), max_variables(0) {}
+  ~TessEngineData() {
+    free_adapted_templates(adapted_templates);
+    delete [] variables;
+  }
+
+  STRING datapath;
+  STRING language;
+  STRING configfile;
+  bool numeric_mode;
+  bool initialized;
+  // What the adaptive classifier learned while this engine was loaded.
+  ADAPT_TEMPLATES adapted_templates;
+  TessEngineVariable* variables;
+  int num_variables;
+  int max_variables;
+};
+
+// The engine whose settings are currently in the globals, and the lock
+// that serializes all use of them.
+static TessBaseEngine* active_engine = NULL;
+static SVMutex engine_mutex;
+// Whether the language data is loaded, and what it was loaded with. It
+// stays loaded between engines that share these, so the classifier
+// variables exist exactly when engine_loaded is set.
+static bool engine_loaded = false;
+static STRING loaded_datapath;
+static STRING loaded_language;
+static STRING loaded_configfile;
+// Number of TessBaseEngines in existence. The last one to go unloads the
+// language data.
+static int num_engines = 0;
+// The data path, language and config file that every initialized engine
+// must share, and the number of initialized engines. Only one set of
+// language data is ever loaded, so an engine that wants another set is
+// refused while any other engine holds this one, rather than reloading
+// the data every time the two take turns.
+static STRING shared_datapath;
+static STRING shared_language;
+static STRING shared_configfile;
+static int num_initialized_engines = 0;
+
+// Size of the buffer used to read back old style variables.
+const int kMaxVariableValue = 1024;
+
+// Free the language data if it is loaded. Must be called with the lock held
+// and no engine active.
+static void UnloadEngineData() {
+  if (engine_loaded) {
+    TessBaseAPI::End();
+    engine_loaded = false;
+  }
+}
+
+TessBaseEngine::TessBaseEngine() : data_(new TessEngineData) {
+  engine_mutex.Lock();
+  ++num_engines;
+  engine_mutex.Unlock();
+}
+
+TessBaseEngine::~TessBaseEngine() {
+  engine_mutex.Lock();
+  if (active_engine == this)
+    Deactivate();
+  if (data_->initialized)
+    --num_initialized_engines;
+  if (--num_engines == 0)
+    UnloadEngineData();
+  engine_mutex.Unlock();
+  delete data_;
+}
+
+int TessBaseEngine::Init(const char* datapath, const char* language,
+                         const char* configfile, bool numeric_mode) {
+  STRING new_language = language != NULL ? language : "";
+  STRING new_configfile = configfile != NULL ? configfile : "";
+  engine_mutex.Lock();
+  int num_others = num_initialized_engines - (data_->initialized ? 1 : 0);
+  if (num_others > 0 &&
+      (shared_datapath != datapath ||
+       shared_language != new_language ||
+       shared_configfile != new_configfile)) {
+    engine_mutex.Unlock();
+    return -1;
+  }
+  if (active_engine == this)
+    Deactivate();
+  // Anything learned belongs to the old language data.
+  free_adapted_templates(data_->adapted_templates);
+  data_->adapted_templates = NULL;
+  data_->datapath = datapath;
+  data_->language = new_language;
+  data_->configfile = new_configfile;
+  data_->numeric_mode = numeric_mode;
+  if (!data_->initialized)
+    ++num_initialized_engines;
+  data_->initialized = true;
+  shared_datapath = data_->datapath;
+  shared_language = data_->language;
+  shared_configfile = data_->configfile;
+  engine_mutex.Unlock();
+  return 0;
+}
+
+// Save the current value of a variable so it can be put back later.
+static void SaveVariable(TessEngineVariable* var) {
+  char old_value[kMaxVariableValue];
+  var->has_saved = get_new_style_variable(var->name.string(), &var->saved);
+  if (!var->has_saved &&
+      get_old_style_variable(var->name.string(), old_value,
+                             kMaxVariableValue)) {
+    var->saved = old_value;
+    var->has_saved = true;
+  }
+}
+
+bool TessBaseEngine::SetVariable(const char* variable, const char* value) {
+  STRING dummy;
+  char old_value[kMaxVariableValue];
+  engine_mutex.Lock();
+  if (engine_loaded &&
+      !get_new_style_variable(variable, &dummy) &&
+      !get_old_style_variable(variable, old_value, kMaxVariableValue)) {
+    engine_mutex.Unlock();
+    return false;
+  }
+  int i;
+  for (i = 0; i < data_->num_variables &&
+       strcmp(data_->variables[i].name.string(), variable) != 0; ++i);
+  if (i == data_->num_variables) {
+    if (data_->num_variables == data_->max_variables) {
+      data_->max_variables = data_->max_variables == 0 ? 16
+                                                       : data_->max_variables * 2;
+      TessEngineVariable* variables =
+        new TessEngineVariable[data_->max_variables];
+      for (int v = 0; v < data_->num_variables; ++v)
+        variables[v] = data_->variables[v];
+      delete [] data_->variables;
+      data_->variables = variables;
+    }
+    ++data_->num_variables;
+    data_->variables[i].name = variable;
+    data_->variables[i].has_saved = false;
+    // If already loaded, save the value before it is changed.
+    if (active_engine == this)
+      SaveVariable(&data_->variables[i]);
+  }
+  data_->variables[i].value = value;
+  if (active_engine == this)
+    TessBaseAPI::SetVariable(variable, value);
+  engine_mutex.Unlock();
+  return true;
+}
+
+char* TessBaseEngine::TesseractRect(const unsigned char* imagedata,
+                                    int bytes_per_pixel, int bytes_per_line,
+                                    int left, int top,
+                                    int width, int height) {
+  engine_mutex.Lock();
+  if (!Activate()) {
+    engine_mutex.Unlock();
+    return NULL;
+  }
+  char* result = TessBaseAPI::TesseractRect(imagedata, bytes_per_pixel,
+                                            bytes_per_line, left, top,
+                                            width, height);
+  engine_mutex.Unlock();
+  return result;
+}
+
+char* TessBaseEngine::TesseractRectBoxes(const unsigned char* imagedata,
+                                         int bytes_per_pixel,
+                                         int bytes_per_line,
+                                         int left, int top,
+                                         int width, int height,
+                                         int imageheight) {
+  engine_mutex.Lock();
+  if (!Activate()) {
+    engine_mutex.Unlock();
+    return NULL;
+  }
+  char* result = TessBaseAPI::TesseractRectBoxes(imagedata, bytes_per_pixel,
+                                                 bytes_per_line, left, top,
+                                                 width, height, imageheight);
+  engine_mutex.Unlock();
+  return result;
+}
+
+char* TessBaseEngine::TesseractRectUNLV(const unsigned char* imagedata,
+                                        int bytes_per_pixel,
+                                        int bytes_per_line,
+                                        int left, int top,
+                                        int width, int height) {
+  engine_mutex.Lock();
+  if (!Activate()) {
+    engine_mutex.Unlock();
+    return NULL;
+  }
+  char* result = TessBaseAPI::TesseractRectUNLV(imagedata, bytes_per_pixel,
+                                                bytes_per_line, left, top,
+                                                width, height);
+  engine_mutex.Unlock();
+  return result;
+}
+
+int TessBaseEngine::TesseractBatch(const TessBatchItem* items, int count,
+                                   bool reset_adaptive,
+                                   TessBatchCallback callback, void* cookie) {
+  engine_mutex.Lock();
+  if (!Activate()) {
+    engine_mutex.Unlock();
+    return -1;
+  }
+  int result = TessBaseAPI::TesseractBatch(items, count, reset_adaptive,
+                                           callback, cookie);
+  engine_mutex.Unlock();
+  return result;
+}
+
+int TessBaseEngine::IsValidWord(const char *string) {
+  engine_mutex.Lock();
+  if (!Activate()) {
+    engine_mutex.Unlock();
+    return 0;
+  }
+  int result = TessBaseAPI::IsValidWord(string);
+  engine_mutex.Unlock();
+  return result;
+}
+
+void TessBaseEngine::ClearAdaptiveClassifier() {
+  engine_mutex.Lock();
+  if (active_engine == this)
+    TessBaseAPI::ClearAdaptiveClassifier();
+  free_adapted_templates(data_->adapted_templates);
+  data_->adapted_templates = NULL;
+  engine_mutex.Unlock();
+}
+
+void TessBaseEngine::End() {
+  engine_mutex.Lock();
+  if (active_engine == this)
+    Deactivate();
+  free_adapted_templates(data_->adapted_templates);
+  data_->adapted_templates = NULL;
+  engine_mutex.Unlock();
+}
+
+// Make this the active engine, deactivating any other first. Init makes
+// all initialized engines share one set of language data, so it is only
+// reloaded here when the engines that used the loaded set have all gone.
+bool TessBaseEngine::Activate() {
+  if (active_engine == this)
+    return true;
+  if (!data_->initialized)
+    return false;
+  if (active_engine != NULL)
+    active_engine->Deactivate();
+  if (engine_loaded &&
+      (loaded_datapath != data_->datapath ||
+       loaded_language != data_->language ||
+       loaded_configfile != data_->configfile))
+    UnloadEngineData();
+  if (!engine_loaded) {
+    TessBaseAPI::InitWithLanguage(
+        data_->datapath.string(), NULL,
+        data_->language.length() > 0 ? data_->language.string() : NULL,
+        data_->configfile.length() > 0 ? data_->configfile.string() : NULL,
+        data_->numeric_mode, 0, NULL);
+    engine_loaded = true;
+    loaded_datapath = data_->datapath;
+    loaded_language = data_->language;
+    loaded_configfile = data_->configfile;
+  }
+  bln_numericmode.set_value(data_->numeric_mode);
+  for (int i = 0; i < data_->num_variables; ++i) {
+    TessEngineVariable* var = &data_->variables[i];
+    SaveVariable(var);
+    TessBaseAPI::SetVariable(var->name.string(), var->value.string());
+  }
+  free_adapted_templates(SwapAdaptedTemplates(data_->adapted_templates));
+  data_->adapted_templates = NULL;
+  active_engine = this;
+  return true;
+}
+
+// Put back the variables this engine changed and take its adaptive data
+// out of the globals. The language data stays loaded for the next engine.
+void TessBaseEngine::Deactivate() {
+  data_->adapted_templates = SwapAdaptedTemplates(NULL);
+  for (int i = data_->num_variables - 1; i >= 0; --i) {
+    TessEngineVariable* var = &data_->variables[i];
+    if (var->has_saved)
+      TessBaseAPI::SetVariable(var->name.string(), var->saved.string());
+  }
+  active_engine = NULL;
+}
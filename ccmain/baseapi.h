@@ -24,6 +24,34 @@ class PAGE_RES;
 class BLOCK_LIST;
 class IMAGE;
 struct Pix;
+struct LOCAL_THRESHOLD;
+
+// One image rectangle of a batch given to TessBaseAPI::TesseractBatch.
+// The image arguments are as for TessBaseAPI::TesseractRect. user_data is
+// not looked at and is handed back with the result.
+struct TessBatchItem {
+  const unsigned char* imagedata;
+  int bytes_per_pixel;
+  int bytes_per_line;
+  int left;
+  int top;
+  int width;
+  int height;
+  void* user_data;
+};
+
+// Output formats of TessBaseAPI::RecognizeImage.
+enum TessOutputFormat {
+  TESS_OUTPUT_TEXT,      // As TesseractRect.
+  TESS_OUTPUT_BOX_TEXT,  // As TesseractRectBoxes.
+  TESS_OUTPUT_UNLV       // As TesseractRectUNLV.
+};
+
+// Receives the result of one batch item. text is NULL if the item was too
+// small to be worth recognizing. text belongs to the batch and is only
+// valid until the callback returns, so copy it if it is needed later.
+typedef void (*TessBatchCallback)(const TessBatchItem* item, int index,
+                                  const char* text, void* cookie);
 
 // Base class for all tesseract APIs.
 // Specific classes can add ability to work on different inputs or produce
@@ -89,6 +117,9 @@ class TessBaseAPI {
   // Binary images of 1 bit per pixel may also be given but they must be
   // byte packed with the MSB of the first byte being the first pixel, and a
   // 1 represents WHITE. For binary images set bytes_per_pixel=0.
+  // If tessedit_zero_copy_input is set and left is a multiple of 8, a binary
+  // image is used where it is instead of being copied, so it must not change
+  // or be freed until the next image is given.
   // The recognized text is returned as a char* which (in future will be coded
   // as UTF8 and) must be freed with the delete [] operator.
   static char* TesseractRect(const unsigned char* imagedata,
@@ -108,6 +139,36 @@ class TessBaseAPI {
                                  int bytes_per_pixel,
                                  int bytes_per_line,
                                  int left, int top, int width, int height);
+  // Recognize a batch of image rectangles, as TesseractRect on each in
+  // turn, and hand each result to callback along with cookie, in order.
+  // The page image, thresholds, block list and text buffer are kept from
+  // one item to the next instead of being made again for each one, which
+  // matters when there are many small images.
+  // If reset_adaptive is true, the adaptive classifier is cleared before
+  // each item so the results do not depend on the order of the items.
+  // Returns the number of items recognized.
+  static int TesseractBatch(const TessBatchItem* items, int count,
+                            bool reset_adaptive,
+                            TessBatchCallback callback, void* cookie);
+
+  // TesseractRect in two steps, for callers that want to work on
+  // several pages at once. ThresholdToImage only touches the image it is
+  // given, so it may run on other threads while RecognizeImage runs.
+  // RecognizeImage uses the global recognizer, like every other call here.
+  // (Line finding cannot be split off as well, as it runs the classifier
+  // to look for repeated characters.)
+  // Copy/threshold the image rectangle, as TesseractRect does, into
+  // image, which becomes a width x height binary image.
+  static void ThresholdToImage(const unsigned char* imagedata,
+                               int bytes_per_pixel,
+                               int bytes_per_line,
+                               int left, int top, int width, int height,
+                               IMAGE* image);
+  // Find the lines of an image made by ThresholdToImage, recognize them
+  // and return the text in the given format, to be freed with delete [].
+  // Box coordinates are relative to the image. The pixels of image are
+  // handed over to the global page image.
+  static char* RecognizeImage(IMAGE* image, TessOutputFormat format);
 
   // Call between pages or documents etc to free up memory and forget
   // adaptive data.
@@ -170,7 +231,7 @@ class TessBaseAPI {
                             int left, int top, int right, int bottom,
                             int* histogram);
 
-  // Threshold the given grey or color image into the tesseract global
+  // Threshold the given grey or color image into the given
   // image ready for recognition. Requires thresholds and hi_value
   // produced by OtsuThreshold above.
   static void ThresholdRect(const unsigned char* imagedata,
@@ -179,14 +240,42 @@ class TessBaseAPI {
                             int left, int top,
                             int width, int height,
                             const int* thresholds,
-                            const int* hi_values);
+                            const int* hi_values,
+                            IMAGE* image);
+
+  // Threshold the given grey or color image into the given image, with a
+  // threshold for each channel of each tile of about tile_size square.
+  // A tile with too little contrast to threshold by itself is taken to
+  // be background. It uses the thresholds of the nearest tiles with
+  // contrast, or else the given (global) threshold, but kept clear of its
+  // own background level. Each pixel gets a threshold interpolated
+  // between those of the nearest tile centres.
+  // The polarity always comes from the global hi_values.
+  // Tiles are worked on by tessedit_threshold_threads threads.
+  static void LocalThresholdRect(const unsigned char* imagedata,
+                                 int bytes_per_pixel,
+                                 int bytes_per_line,
+                                 int left, int top,
+                                 int width, int height,
+                                 const int* thresholds,
+                                 const int* hi_values,
+                                 int tile_size,
+                                 IMAGE* image);
+
+  // Thread functions of LocalThresholdRect, each taking a LOCAL_THRESHOLD
+  // and working on its items until there are none left.
+  // Computes the thresholds of rows of tiles.
+  static void* ThresholdTileRows(void* job);
+  // Thresholds strips of lines of the image.
+  static void* ThresholdLocalStrips(void* job);
 
   // Cut out the requested rectangle of the binary image to the
-  // tesseract global image ready for recognition.
+  // given image ready for recognition.
   static void CopyBinaryRect(const unsigned char* imagedata,
                              int bytes_per_line,
                              int left, int top,
-                             int width, int height);
+                             int width, int height,
+                             IMAGE* image);
 
   // Low-level function to recognize the current global image to a string.
   static char* RecognizeToString();
@@ -209,6 +298,9 @@ class TessBaseAPI {
   static int* AllTextConfidences(PAGE_RES* page_res);
   // Convert (and free) the internal data structures into a text string.
   static char* TesseractToText(PAGE_RES* page_res);
+  // Write the text of page_res into result, which must have room for
+  // TextLength(page_res) characters. The input page_res is NOT deleted.
+  static void WriteText(PAGE_RES* page_res, char* result);
   // Make a text string from the internal data structures.
   // The input page_res is deleted.
   // The text string takes the form of a box file as needed for training.
@@ -253,4 +345,75 @@ class TessBaseAPI {
                                     PAGE_RES* page_res);
 };
 
+class TessEngineData;
+
+// An instantiable handle on the engine. Each TessBaseEngine owns its own
+// numeric mode, variable settings and adaptive data, so several
+// differently configured engines can be kept in one process.
+// The handle gives no concurrency. The recognizer itself is still a
+// single set of process-wide globals, so every call on every engine is
+// serialized on one process-wide lock and engines used from several
+// threads simply take turns. When a call arrives for an engine other than
+// the active one, the active one puts back the variables it set and its
+// adaptive data is put aside, then the caller's variables and adaptive
+// data are put in their place.
+// Only one set of language data is loaded at a time, so all initialized
+// engines must share one data path, language and config file; Init
+// refuses any other while another engine holds them.
+// Do not mix TessBaseEngine with the static TessBaseAPI calls above.
+class TessBaseEngine {
+ public:
+  TessBaseEngine();
+  ~TessBaseEngine();
+
+  // Remember the settings to start the engine with. Nothing is loaded
+  // until the first recognition call. Arguments are as for
+  // TessBaseAPI::InitWithLanguage. Returns 0, or -1 and leaves the engine
+  // as it was if another initialized engine has a different data path,
+  // language or config file.
+  int Init(const char* datapath, const char* language,
+           const char* configfile, bool numeric_mode);
+
+  // Set a variable for this engine only. It is applied whenever this
+  // engine is activated and the previous value is put back when it is
+  // deactivated. Returns false if the name lookup failed. Classifier
+  // variables only exist while language data is loaded, so until then
+  // any name is accepted.
+  bool SetVariable(const char* variable, const char* value);
+
+  // As the TessBaseAPI functions of the same names, run on this engine.
+  // If Init has not succeeded they fail, returning NULL, -1 or 0.
+  char* TesseractRect(const unsigned char* imagedata,
+                      int bytes_per_pixel, int bytes_per_line,
+                      int left, int top, int width, int height);
+  char* TesseractRectBoxes(const unsigned char* imagedata,
+                           int bytes_per_pixel, int bytes_per_line,
+                           int left, int top, int width, int height,
+                           int imageheight);
+  char* TesseractRectUNLV(const unsigned char* imagedata,
+                          int bytes_per_pixel, int bytes_per_line,
+                          int left, int top, int width, int height);
+  int TesseractBatch(const TessBatchItem* items, int count,
+                     bool reset_adaptive,
+                     TessBatchCallback callback, void* cookie);
+  int IsValidWord(const char *string);
+
+  // Forget the adaptive data of this engine.
+  void ClearAdaptiveClassifier();
+
+  // Deactivate this engine and forget its adaptive data. It may still be
+  // used again later. The language data is freed when the last engine is
+  // destroyed.
+  void End();
+
+ private:
+  // Make this the active engine. Must be called with the lock held.
+  // Returns false if Init has not succeeded.
+  bool Activate();
+  // Undo Activate. Must be called with the lock held.
+  void Deactivate();
+
+  TessEngineData* data_;
+};
+
 #endif  // THIRD_PARTY_TESSERACT_CCMAIN_BASEAPI_H__
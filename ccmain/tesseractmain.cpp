@@ -18,6 +18,9 @@
  **********************************************************************/
 
 #include "mfcpch.h"
+// svutil.h includes <string>, so it has to come before the min and max
+// macros of cutil.h.
+#include "svutil.h"
 #include "applybox.h"
 #include "control.h"
 #include "tessvars.h"
@@ -25,6 +28,8 @@
 #include "baseapi.h"
 #include "pageres.h"
 #include "imgs.h"
+#include "imgtiff.h"
+#include "imgerrs.h"
 #include "varabled.h"
 #include "tprintf.h"
 #include "tesseractmain.h"
@@ -63,15 +68,23 @@ EXTERN INT_VAR (tessedit_serial_unlv, 0,
                 "0->Whole page, 1->serial no adapt, 2->serial with adapt");
 EXTERN INT_VAR (tessedit_page_number, -1,
                 "-1 -> All pages, else specifc page to process");
+EXTERN INT_VAR (tessedit_page_count, 1,
+                "Pages to process from tessedit_page_number, 0 -> to the end");
 EXTERN BOOL_VAR (tessedit_write_images, FALSE,
 "Capture the image from the IPE");
 EXTERN BOOL_VAR (tessedit_debug_to_screen, FALSE, "Dont use debug file");
+EXTERN BOOL_VAR (tessedit_pipeline_pages, FALSE,
+"Decode, threshold and recognize multiple pages at once");
 
 extern inT16 XOFFSET;
 extern inT16 YOFFSET;
 extern int NO_BLOCK;
 
 const int kMaxIntSize = 22;
+// Pages smaller than this are not recognized, as in TessBaseAPI.
+const int kMinPageSize = 10;
+// Most pages that may wait between two stages of the page pipeline.
+const int kPipelineDepth = 2;
 const ERRCODE USAGE = "Usage";
 char szAppName[] = "Tessedit";   //app name
 
@@ -135,6 +148,236 @@ void TesseractImage(const char* input_file, IMAGE* image, STRING* text_out) {
   }
 }
 
+// A page on its way through the page pipeline.
+struct PIPELINE_PAGE {
+  int page_number;
+  bool thresholded;    // false if the page was too small to bother with
+  IMAGE image;         // the decoded page, then its binary image
+};
+
+// A bounded queue of pages between two stages of the page pipeline.
+// put waits while the queue is full and get waits while it is empty.
+// A NULL page marks the end of the document.
+class PAGE_QUEUE {
+ public:
+  PAGE_QUEUE() : head_(0), tail_(0) {
+    for (int i = 0; i < kPipelineDepth; ++i)
+      free_.Signal();
+  }
+
+  void put(PIPELINE_PAGE* page) {
+    free_.Wait();
+    mutex_.Lock();
+    pages_[tail_] = page;
+    tail_ = (tail_ + 1) % kPipelineDepth;
+    mutex_.Unlock();
+    used_.Signal();
+  }
+
+  PIPELINE_PAGE* get() {
+    used_.Wait();
+    mutex_.Lock();
+    PIPELINE_PAGE* page = pages_[head_];
+    head_ = (head_ + 1) % kPipelineDepth;
+    mutex_.Unlock();
+    free_.Signal();
+    return page;
+  }
+
+ private:
+  PIPELINE_PAGE* pages_[kPipelineDepth];
+  int head_;
+  int tail_;
+  SVMutex mutex_;
+  SVSemaphore free_;   // counts empty slots
+  SVSemaphore used_;   // counts waiting pages
+};
+
+// Reads the given page of the input file into image.
+// Returns false if there is no such page.
+typedef bool (*PAGE_READER)(const char* input_file, int page_number,
+                            IMAGE* image);
+
+// Everything shared by the stages of the page pipeline.
+struct PAGE_PIPELINE {
+  const char* input_file;
+  PAGE_READER reader;
+  int first_page;
+  int last_page;       // -1 for all pages
+  PAGE_QUEUE decoded;  // pages waiting to be thresholded
+  PAGE_QUEUE binary;   // pages waiting to be recognized
+};
+
+// Decodes the given page for the page pipeline. Returns NULL if the page
+// is past the end of the range or could not be read.
+static PIPELINE_PAGE* decode_page(PAGE_PIPELINE* pipeline, int page_number) {
+  if (pipeline->last_page >= 0 && page_number > pipeline->last_page)
+    return NULL;
+  PIPELINE_PAGE* page = new PIPELINE_PAGE;
+  page->page_number = page_number;
+  page->thresholded = false;
+  if (!pipeline->reader(pipeline->input_file, page_number, &page->image)) {
+    delete page;
+    return NULL;
+  }
+  return page;
+}
+
+// Thresholds a decoded page for the page pipeline. This only touches the
+// page itself, so it can run alongside the recognition of another page.
+static void threshold_page(PIPELINE_PAGE* page) {
+  IMAGE* image = &page->image;
+  if (image->get_xsize() >= kMinPageSize &&
+      image->get_ysize() >= kMinPageSize) {
+    // A binary page is recognized as it is, without copying it, but
+    // with the resolution and interpretation a copy would have.
+    if (image->get_bpp() == 1) {
+      image->set_res(image_default_resolution);
+      image->set_white_high(TRUE);
+    } else {
+      int bytes_per_line = check_legal_image_size(image->get_xsize(),
+                                                  image->get_ysize(),
+                                                  image->get_bpp());
+      IMAGE binary;
+      TessBaseAPI::ThresholdToImage(image->get_buffer(),
+                                    image->get_bpp()/8,
+                                    bytes_per_line, 0, 0,
+                                    image->get_xsize(), image->get_ysize(),
+                                    &binary);
+      *image = binary;
+    }
+    page->thresholded = true;
+  }
+}
+
+// First stage of the page pipeline: decode the pages in turn.
+static void* decode_pages(void* arg) {
+  PAGE_PIPELINE* pipeline = reinterpret_cast<PAGE_PIPELINE*>(arg);
+  PIPELINE_PAGE* page;
+  int page_number = pipeline->first_page;
+  while ((page = decode_page(pipeline, page_number++)) != NULL)
+    pipeline->decoded.put(page);
+  pipeline->decoded.put(NULL);
+  return NULL;
+}
+
+// Second stage of the page pipeline: threshold each page.
+static void* threshold_pages(void* arg) {
+  PAGE_PIPELINE* pipeline = reinterpret_cast<PAGE_PIPELINE*>(arg);
+  PIPELINE_PAGE* page;
+  while ((page = pipeline->decoded.get()) != NULL) {
+    threshold_page(page);
+    pipeline->binary.put(page);
+  }
+  pipeline->binary.put(NULL);
+  return NULL;
+}
+
+// Run tesseract on pages first_page to last_page (-1 for all) of the
+// input, with decoding, thresholding and recognition of different pages
+// running at the same time on separate threads, so the time taken is
+// that of the slowest stage rather than the sum of them all.
+// Line finding and recognition stay on the calling thread, as both use
+// the globals of the classifier. A stage whose thread cannot be started
+// is done on the calling thread instead. Unlike TesseractImage, there is
+// no serial UNLV mode.
+void TesseractPipeline(const char* input_file, PAGE_READER reader,
+                       int first_page, int last_page, STRING* text_out) {
+  PAGE_PIPELINE pipeline;
+  pipeline.input_file = input_file;
+  pipeline.reader = reader;
+  pipeline.first_page = first_page;
+  pipeline.last_page = last_page;
+  SVThread decoder;
+  SVThread thresholder;
+  bool decoding = SVSync::StartJoinableThread(decode_pages, &pipeline,
+                                              &decoder);
+  bool thresholding = decoding &&
+      SVSync::StartJoinableThread(threshold_pages, &pipeline, &thresholder);
+
+  TessOutputFormat format = TESS_OUTPUT_TEXT;
+  if (tessedit_create_boxfile)
+    format = TESS_OUTPUT_BOX_TEXT;
+  else if (tessedit_write_unlv)
+    format = TESS_OUTPUT_UNLV;
+  int page_number = first_page;
+  for (;;) {
+    PIPELINE_PAGE* page;
+    if (thresholding) {
+      page = pipeline.binary.get();
+    } else {
+      if (decoding)
+        page = pipeline.decoded.get();
+      else
+        page = decode_page(&pipeline, page_number++);
+      if (page != NULL)
+        threshold_page(page);
+    }
+    if (page == NULL)
+      break;
+    if (page->page_number > 0)
+      tprintf("Page %d\n", page->page_number);
+    char page_str[kMaxIntSize];
+    snprintf(page_str, kMaxIntSize - 1, "%d", page->page_number);
+    TessBaseAPI::SetVariable("applybox_page", page_str);
+    if (page->thresholded) {
+      char* text = TessBaseAPI::RecognizeImage(&page->image, format);
+      *text_out += text;
+      delete [] text;
+      if (tessedit_write_images) {
+        page_image.write("tessinput.tif");
+      }
+    }
+    delete page;
+  }
+  // The stages have both passed on the end of the document, but may still
+  // be using the queues in pipeline.
+  if (thresholding)
+    SVSync::JoinThread(thresholder);
+  if (decoding)
+    SVSync::JoinThread(decoder);
+}
+
+// Page reader of the page pipeline for tif files read without libtiff.
+// The page is found with tif_page_directory, so reading page n does not
+// mean reading the n pages before it, only at most their tag tables.
+static bool read_indexed_page(const char* input_file, int page_number,
+                              IMAGE* image) {
+  if (image->read_header(input_file, page_number) < 0)
+    return false;
+  if (image->read(image->get_ysize()) < 0) {
+    // This may be on a pipeline thread, so report it and end the pages.
+    READFAILED.error("read_indexed_page", TESSLOG, "Page %d of %s",
+                     page_number, input_file);
+    return false;
+  }
+  return true;
+}
+
+#ifdef _TIFFIO_
+// Page reader of the page pipeline for tiff files. As in main, the file
+// is reopened for every page, since libtiff keeps all the pages it has
+// read in memory.
+static bool read_tiff_page(const char* input_file, int page_number,
+                           IMAGE* image) {
+  TIFF* archive = TIFFOpen(input_file, "r");
+  if (archive == NULL) {
+    // This may be on a pipeline thread, so report it and end the pages.
+    READFAILED.error("read_tiff_page", TESSLOG, input_file);
+    return false;
+  }
+  bool found = true;
+  if (page_number > 0) {
+    uinT32 directory = tif_page_directory(input_file, page_number);
+    found = directory != 0 && TIFFSetSubDirectory(archive, directory) != 0;
+  }
+  if (found)
+    read_tiff_image(archive, image);
+  TIFFClose(archive);
+  return found;
+}
+#endif
+
 /**********************************************************************
  *  main()
  *
@@ -176,14 +419,23 @@ int main(int argc, char **argv) {
 
   IMAGE image;
   STRING text_out;
-#ifdef _TIFFIO_
+  // The pages to process, last_page being -1 for all the rest. Separate
+  // processes can each take their own range of pages of the same file.
+  int first_page = tessedit_page_number < 0 ? 0 : tessedit_page_number;
+  int last_page = -1;
+  if (tessedit_page_number >= 0 && tessedit_page_count > 0)
+    last_page = first_page + tessedit_page_count - 1;
   int len = strlen(argv[1]);
-  if (len > 3 && strcmp("tif", argv[1] + len - 3) == 0) {
+  bool is_tif = len > 3 && strcmp("tif", argv[1] + len - 3) == 0;
+#ifdef _TIFFIO_
+  if (is_tif && tessedit_pipeline_pages && tessedit_serial_unlv == 0) {
+    // Decode, threshold and recognize different pages at once.
+    TesseractPipeline(argv[1], read_tiff_page, first_page, last_page,
+                      &text_out);
+  } else if (is_tif) {
     // Use libtiff to read a tif file so multi-page can be handled.
     // The page number so the tiff file can be closed and reopened.
-    int page_number = tessedit_page_number;
-    if (page_number < 0)
-      page_number = 0;
+    int page_number = first_page;
     TIFF* archive = NULL;
     do {
       // Since libtiff keeps all read images in memory we have to close the
@@ -195,12 +447,16 @@ int main(int argc, char **argv) {
         READFAILED.error (argv[0], EXIT, argv[1]);
         return 1;
       }
-      if (page_number > 0)
+      // Jump straight to the appropriate page.
+      if (page_number > 0) {
+        uinT32 directory = tif_page_directory(argv[1], page_number);
+        if (directory == 0 || !TIFFSetSubDirectory(archive, directory)) {
+          TIFFClose(archive);
+          BADIMAGEPAGE.error(argv[0], EXIT, "%s page %d", argv[1],
+                             page_number);
+          return 1;
+        }
         tprintf("Page %d\n", page_number);
-
-      // Seek to the appropriate page.
-      for (int i = 0; i < page_number; ++i) {
-        TIFFReadDirectory(archive);
       }
       char page_str[kMaxIntSize];
       snprintf(page_str, kMaxIntSize - 1, "%d", page_number);
@@ -214,17 +470,36 @@ int main(int argc, char **argv) {
       TesseractImage(argv[1], &image, &text_out);
     // Do this while there are more pages in the tiff file.
     } while (TIFFReadDirectory(archive) &&
-             (page_number <= tessedit_page_number || tessedit_page_number < 0));
+             (page_number <= last_page || last_page < 0));
     TIFFClose(archive);
   } else {
 #endif
-    if (image.read_header(argv[1]) < 0)
-      READFAILED.error (argv[0], EXIT, argv[1]);
-    if (image.read(image.get_ysize ()) < 0) {
-      MEMORY_OUT.error(argv[0], EXIT, "Read of image %s",
-        argv[1]);
+    if (is_tif) {
+      int page_count = tif_page_count(argv[1]);
+      if (page_count <= 0)
+        READFAILED.error (argv[0], EXIT, argv[1]);
+      if (last_page < 0 || last_page >= page_count)
+        last_page = page_count - 1;
+    } else {
+      first_page = last_page = 0;
+    }
+    if (is_tif && tessedit_pipeline_pages && tessedit_serial_unlv == 0) {
+      // Decode, threshold and recognize different pages at once.
+      TesseractPipeline(argv[1], read_indexed_page, first_page, last_page,
+                        &text_out);
+    } else {
+      for (int page_number = first_page; page_number <= last_page;
+           ++page_number) {
+        if (page_number > 0)
+          tprintf("Page %d\n", page_number);
+        char page_str[kMaxIntSize];
+        snprintf(page_str, kMaxIntSize - 1, "%d", page_number);
+        TessBaseAPI::SetVariable("applybox_page", page_str);
+        if (!read_indexed_page(argv[1], page_number, &image))
+          READFAILED.error (argv[0], EXIT, argv[1]);
+        TesseractImage(argv[1], &image, &text_out);
+      }
     }
-    TesseractImage(argv[1], &image, &text_out);
 #ifdef _TIFFIO_
   }
 #endif
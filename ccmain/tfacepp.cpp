@@ -31,6 +31,7 @@
 #include          "tessvars.h"
 #include          "globals.h"
 #include          "reject.h"
+#include          "matchtab.h"
 
 #define EXTERN
 
@@ -165,6 +166,9 @@ WERD_CHOICE *recog_word_recursive(                           //recog one owrd
     else
       last_word_on_line = FALSE;
     initial_blob_choice_len = blob_choices->length ();
+                                 //row as make_tess_row gives it
+    set_match_row (denorm->row ()->ascenders () * denorm->scale (),
+      denorm->row ()->descenders () * denorm->scale ());
     tessword = make_tess_word (word, NULL);
     tess_ratings = cc_recog (tessword, &tess_choice, &tess_raw,
       testing
@@ -29,6 +29,121 @@ ICOORD C_OUTLINE::step_coords[4] = {
   ICOORD (-1, 0), ICOORD (0, -1), ICOORD (1, 0), ICOORD (0, 1)
 };
 
+                                 //chunk header
+struct STEP_CHUNK
+{
+  STEP_CHUNK *next;              //next allocated chunk
+  inT32 size;                    //bytes of steps after header
+};
+
+inT32 OUTLINE_ARENA::total_arenas = 0;
+inT32 OUTLINE_ARENA::live_arenas = 0;
+inT32 OUTLINE_ARENA::total_outlines = 0;
+inT32 OUTLINE_ARENA::total_bytes = 0;
+inT32 OUTLINE_ARENA::total_chunks = 0;
+
+/**********************************************************************
+ * OUTLINE_ARENA::OUTLINE_ARENA
+ *
+ * Make an empty arena. It gets its first chunk on the first allocation.
+ **********************************************************************/
+
+OUTLINE_ARENA::OUTLINE_ARENA() {  //constructor
+  chunks = NULL;
+  chunk_used = 0;
+  refs = 0;
+  closed = FALSE;
+  outlines = 0;
+  bytes = 0;
+  chunkcount = 0;
+}
+
+
+/**********************************************************************
+ * OUTLINE_ARENA::~OUTLINE_ARENA
+ *
+ * Free all the chunks in one go. Only called when no outline uses them.
+ **********************************************************************/
+
+OUTLINE_ARENA::~OUTLINE_ARENA() {  //destructor
+  STEP_CHUNK *chunk;             //chunk to free
+
+  while (chunks != NULL) {
+    chunk = chunks;
+    chunks = chunk->next;
+    free_mem(chunk);
+  }
+}
+
+
+/**********************************************************************
+ * OUTLINE_ARENA::alloc_steps
+ *
+ * Get a zeroed step array from the first chunk, starting a new chunk if
+ * it will not fit. Outlines longer than a chunk get a chunk to themselves.
+ **********************************************************************/
+
+uinT8 *OUTLINE_ARENA::alloc_steps(             //get zeroed steps
+                                  inT32 size   //bytes wanted
+                                 ) {
+  STEP_CHUNK *chunk;             //new chunk
+  inT32 chunk_size;              //bytes in new chunk
+  uinT8 *result;                 //return value
+
+  if (chunks == NULL || chunk_used + size > chunks->size) {
+    chunk_size = size > STEP_CHUNK_SIZE ? size : STEP_CHUNK_SIZE;
+    chunk = (STEP_CHUNK *) alloc_mem (sizeof (STEP_CHUNK) + chunk_size);
+    chunk->next = chunks;
+    chunk->size = chunk_size;
+    chunks = chunk;
+    chunk_used = 0;
+    chunkcount++;
+  }
+  result = (uinT8 *) (chunks + 1) + chunk_used;
+  chunk_used += size;
+  memset(result, 0, size);
+  refs++;
+  outlines++;
+  bytes += size;
+  return result;
+}
+
+
+/**********************************************************************
+ * OUTLINE_ARENA::free_steps
+ *
+ * An outline has given back its steps. The memory is not reused, but
+ * the arena goes when the last outline goes after it is closed.
+ **********************************************************************/
+
+void OUTLINE_ARENA::free_steps() {  //an outline has gone
+  refs--;
+  if (closed && refs == 0) {
+    live_arenas--;
+    delete this;
+  }
+}
+
+
+/**********************************************************************
+ * OUTLINE_ARENA::close
+ *
+ * The owner has finished making outlines. Add the counts to the totals
+ * and delete the arena now if none of its outlines are left.
+ **********************************************************************/
+
+void OUTLINE_ARENA::close() {  //no more outlines
+  closed = TRUE;
+  total_arenas++;
+  total_outlines += outlines;
+  total_bytes += bytes;
+  total_chunks += chunkcount;
+  if (refs == 0)
+    delete this;
+  else
+    live_arenas++;
+}
+
 /**********************************************************************
  * C_OUTLINE::C_OUTLINE
  *
@@ -39,19 +154,28 @@ C_OUTLINE::C_OUTLINE (
 //constructor
 CRACKEDGE * startpt,             //outline to convert
 ICOORD bot_left,                 //bounding box
-ICOORD top_right, inT16 length   //length of loop
+ICOORD top_right, inT16 length,  //length of loop
+OUTLINE_ARENA * step_arena       //memory for steps
 ):box (bot_left, top_right), start (startpt->pos) {
   inT16 stepindex;               //index to step
   CRACKEDGE *edgept;             //current point
 
   stepcount = length;            //no of steps
+  arena = NULL;
   if (length == 0) {
     steps = NULL;
     return;
   }
+  if (step_arena != NULL) {
+                                 //from scan's arena
+    steps = step_arena->alloc_steps (step_mem());
+    arena = step_arena;
+  }
+  else {
                                  //get memory
-  steps = (uinT8 *) alloc_mem (step_mem());
-  memset(steps, 0, step_mem());
+    steps = (uinT8 *) alloc_mem (step_mem());
+    memset(steps, 0, step_mem());
+  }
   edgept = startpt;
 
   for (stepindex = 0; stepindex < length; stepindex++) {
@@ -84,6 +208,7 @@ inT16 length                     //length of loop
 
   pos = startpt;
   stepcount = length;            //no of steps
+  arena = NULL;
                                  //get memory
   steps = (uinT8 *) alloc_mem (step_mem());
   memset(steps, 0, step_mem());
@@ -143,6 +268,7 @@ C_OUTLINE::C_OUTLINE(                     //constructor
   uinT8 new_step;
 
   stepcount = srcline->stepcount * 2;
+  arena = NULL;
                                  //get memory
   steps = (uinT8 *) alloc_mem (step_mem());
   memset(steps, 0, step_mem());
@@ -603,8 +729,7 @@ const C_OUTLINE & source         //from this
 ) {
   box = source.box;
   start = source.start;
-  if (steps != NULL)
-    free_mem(steps);
+  free_steps();
   stepcount = source.stepcount;
   steps = (uinT8 *) alloc_mem (step_mem());
   memmove (steps, source.steps, step_mem());
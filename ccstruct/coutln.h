@@ -31,6 +31,8 @@
 
                                  //mask to get step
 #define STEP_MASK       3
+                                 //bytes in an arena chunk
+#define STEP_CHUNK_SIZE 8192
 
 enum C_OUTLINE_FLAGS
 {
@@ -38,6 +40,56 @@ enum C_OUTLINE_FLAGS
 };
 
 class DLLSYM C_OUTLINE;          //forward declaration
+struct STEP_CHUNK;
+
+/**********************************************************************
+ * OUTLINE_ARENA
+ *
+ * Holds the step arrays of the outlines made by one edge scan in a few
+ * big chunks instead of a malloc each. Every outline in the arena holds
+ * a reference, and all the chunks are freed at once when the scan has
+ * closed the arena and the last of its outlines is deleted, which is
+ * normally when the blocks of the page are deleted.
+ * Only one thread may allocate from an arena at a time.
+ **********************************************************************/
+
+class DLLSYM OUTLINE_ARENA
+{
+  public:
+    OUTLINE_ARENA();             //empty arena
+
+    uinT8 *alloc_steps(                //get zeroed steps
+                       inT32 size);    //bytes wanted
+    void free_steps();           //an outline has gone
+    void close();                //no more outlines
+
+    inT32 get_outlines() const {  //step arrays given out
+      return outlines;
+    }
+    inT32 get_bytes() const {    //bytes given out
+      return bytes;
+    }
+    inT32 get_chunks() const {   //chunks allocated
+      return chunkcount;
+    }
+
+    static inT32 total_arenas;   //arenas closed
+    static inT32 live_arenas;    //closed but still in use
+    static inT32 total_outlines; //step arrays in all arenas
+    static inT32 total_bytes;    //bytes in all arenas
+    static inT32 total_chunks;   //chunks in all arenas
+
+  private:
+    ~OUTLINE_ARENA();            //frees all chunks
+
+    STEP_CHUNK *chunks;          //chunks of this arena
+    inT32 chunk_used;            //bytes used in first chunk
+    inT32 refs;                  //outlines still alive
+    BOOL8 closed;                //owner has finished
+    inT32 outlines;              //step arrays given out
+    inT32 bytes;                 //bytes given out
+    inT32 chunkcount;            //chunks allocated
+};
 
 ELISTIZEH_S (C_OUTLINE)
 class DLLSYM C_OUTLINE:public ELIST_LINK
@@ -45,21 +97,21 @@ class DLLSYM C_OUTLINE:public ELIST_LINK
   public:
     C_OUTLINE() {  //empty constructor
       steps = NULL;
+      arena = NULL;
     }
     C_OUTLINE(                     //constructor
               CRACKEDGE *startpt,  //from edge detector
               ICOORD bot_left,     //bounding box //length of loop
               ICOORD top_right,
-              inT16 length);
+              inT16 length,
+              OUTLINE_ARENA *step_arena = NULL);  //memory for steps
     C_OUTLINE(ICOORD startpt,    //start of loop
               DIR128 *new_steps,  //steps in loop
               inT16 length);     //length of loop
                                  //outline to copy
     C_OUTLINE(C_OUTLINE *srcline, FCOORD rotation);  //and rotate
     ~C_OUTLINE () {              //destructor
-      if (steps != NULL)
-        free_mem(steps);
-      steps = NULL;
+      free_steps();
     }
 
     BOOL8 flag(                               //test flag
@@ -155,6 +207,7 @@ class DLLSYM C_OUTLINE:public ELIST_LINK
     void de_dump(  //read external bits
                  FILE *f) {
       steps = (uinT8 *) de_serialise_bytes (f, step_mem());
+      arena = NULL;              //steps are on the heap now
       children.de_dump (f);
     }
 
@@ -164,10 +217,19 @@ class DLLSYM C_OUTLINE:public ELIST_LINK
 
   private:
     int step_mem() const { return (stepcount+3) / 4; }
+    void free_steps() {          //give back step array
+      if (arena != NULL)
+        arena->free_steps ();
+      else if (steps != NULL)
+        free_mem(steps);
+      steps = NULL;
+      arena = NULL;
+    }
 
     TBOX box;                     //boudning box
     ICOORD start;                //start coord
     uinT8 *steps;                //step array
+    OUTLINE_ARENA *arena;        //owner of steps or NULL
     inT16 stepcount;             //no of steps
     BITS16 flags;                //flags about outline
     C_OUTLINE_LIST children;     //child elements
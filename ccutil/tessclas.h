@@ -6,6 +6,7 @@
 #define TBLOBFLAGS      4        /*No of flags in a blob */
 #define MAX_WO_CLASSES    3
 #define EDGEPTFLAGS     4        /*concavity,length etc. */
+#define EDGEPT_POOLED   2        /*flag: owned by the chop pool */
 
 typedef struct
 {
@@ -656,6 +656,52 @@ bool set_new_style_variable(const char *variable, const char* value) {
   return foundit;
 }
 
+/**********************************************************************
+ * get_new_style_variable
+ *
+ * Write the current value of the named variable to value in the form
+ * accepted by set_new_style_variable. Returns false if there is no
+ * variable of that name.
+ **********************************************************************/
+
+bool get_new_style_variable(const char *variable, STRING *value) {
+  INT_VARIABLE_C_IT int_it = INT_VARIABLE::get_head();
+  BOOL_VARIABLE_C_IT BOOL_it = BOOL_VARIABLE::get_head();
+  STRING_VARIABLE_C_IT STRING_it = STRING_VARIABLE::get_head();
+  double_VARIABLE_C_IT double_it = double_VARIABLE::get_head();
+  char buf[64];
+
+  for (STRING_it.mark_cycle_pt();
+       !STRING_it.cycled_list(); STRING_it.forward()) {
+    if (strcmp(variable, STRING_it.data()->name_str()) == 0) {
+      *value = STRING_it.data()->string();
+      return true;
+    }
+  }
+  for (int_it.mark_cycle_pt(); !int_it.cycled_list(); int_it.forward()) {
+    if (strcmp(variable, int_it.data()->name_str()) == 0) {
+      sprintf(buf, INT32FORMAT, (inT32) *int_it.data());
+      *value = buf;
+      return true;
+    }
+  }
+  for (BOOL_it.mark_cycle_pt(); !BOOL_it.cycled_list(); BOOL_it.forward()) {
+    if (strcmp(variable, BOOL_it.data()->name_str()) == 0) {
+      *value = (BOOL8) *BOOL_it.data() ? "T" : "F";
+      return true;
+    }
+  }
+  for (double_it.mark_cycle_pt();
+       !double_it.cycled_list(); double_it.forward()) {
+    if (strcmp(variable, double_it.data()->name_str()) == 0) {
+      sprintf(buf, "%.17g", (double) *double_it.data());
+      *value = buf;
+      return true;
+    }
+  }
+  return false;
+}
+
 /**********************************************************************
  * print_variables
  *
@@ -30,6 +30,8 @@ class DLLSYM INT_VARIABLE;
 extern DLLSYM BOOL8 read_variables_file(const char *file  //name to read
                                        );
 bool set_new_style_variable(const char *variable, const char* value);
+                                 //read back as text
+bool get_new_style_variable(const char *variable, STRING *value);
                                  //print all vars
 extern DLLSYM void print_variables(FILE *fp  //file to print on
                                   );
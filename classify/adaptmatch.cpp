@@ -558,6 +558,10 @@ double_VAR(tessedit_class_miss_scale, 0.00390625,
 int tess_cn_matching = 0;
 int tess_bn_matching = 0;
 
+/* Counts changes to the adapted templates, so that results of the
+adaptive classifier kept from before a change can be told apart. */
+int AdaptedTemplatesChanges = 0;
+
 /**----------------------------------------------------------------------------
               Public Code
 ----------------------------------------------------------------------------**/
@@ -593,8 +597,10 @@ LIST AdaptiveClassifier(TBLOB *Blob, TBLOB *DotBlob, TEXTROW *Row) {
     NumAdaptationsFailed = 0;
     ResetAdaptiveClassifier();
   }
-  if (AdaptedTemplates == NULL)
+  if (AdaptedTemplates == NULL) {
     AdaptedTemplates = NewAdaptedTemplates ();
+    AdaptedTemplatesChanges++;
+  }
   EnterClassifyMode;
 
   Results.BlobLength = MAX_INT32;
@@ -871,13 +877,17 @@ void InitAdaptiveClassifier() {
   fflush(stdout);
   #endif
 
-  #ifdef __UNIX__
-  File = Efopen (Filename.string(), "r");
-  #else
-  File = Efopen (Filename.string(), "rb");
-  #endif
-  PreTrainedTemplates = ReadIntTemplates (File, TRUE);
-  fclose(File);
+  /* Use a template image in place if there is one */
+  PreTrainedTemplates = MapIntTemplates (Filename.string());
+  if (PreTrainedTemplates == NULL) {
+    #ifdef __UNIX__
+    File = Efopen (Filename.string(), "r");
+    #else
+    File = Efopen (Filename.string(), "rb");
+    #endif
+    PreTrainedTemplates = ReadIntTemplates (File, TRUE);
+    fclose(File);
+  }
 
   Filename = language_data_path_prefix;
   Filename += BuiltInCutoffsFile;
@@ -935,6 +945,7 @@ void InitAdaptiveClassifier() {
       free_adapted_templates(AdaptedTemplates);
     AdaptedTemplates = NewAdaptedTemplates ();
   }
+  AdaptedTemplatesChanges++;
   old_enable_learning = EnableLearning;
 
 }                                /* InitAdaptiveClassifier */
@@ -942,6 +953,28 @@ void InitAdaptiveClassifier() {
 void ResetAdaptiveClassifier() {
   free_adapted_templates(AdaptedTemplates);
   AdaptedTemplates = NULL;
+  AdaptedTemplatesChanges++;
+}
+
+// Install Templates as the adapted templates and return the ones they
+// replace, which now belong to the caller. Either may be NULL. The
+// templates must have been adapted against the pre-trained templates now
+// loaded.
+ADAPT_TEMPLATES SwapAdaptedTemplates(ADAPT_TEMPLATES Templates) {
+  ADAPT_TEMPLATES Previous = AdaptedTemplates;
+  int i;
+
+  AdaptedTemplates = Templates;
+  if (Templates != NULL && PreTrainedTemplates != NULL) {
+    for (i = 0; i < NumClassesIn (Templates->Templates); i++) {
+      BaselineCutoffs[i] =
+        CharNormCutoffs[IndexForClassId (PreTrainedTemplates,
+        ClassIdForIndex (Templates->Templates, i))];
+    }
+  }
+  NumAdaptationsFailed = 0;
+  AdaptedTemplatesChanges++;
+  return Previous;
 }
 
 
@@ -1120,6 +1153,7 @@ void MakeNewAdaptedClass(TBLOB *Blob,
   CLASS_INDEX ClassIndex;
   TEMP_CONFIG Config;
 
+  AdaptedTemplatesChanges++;
   NormMethod = baseline;
   Features = ExtractOutlineFeatures (Blob, LineStats);
   NumFeatures = NumFeaturesIn (Features);
@@ -1351,6 +1385,7 @@ void AdaptToChar(TBLOB *Blob,
         return;
       }
 
+      AdaptedTemplatesChanges++;
       TempConfig = TempConfigFor (Class, IntResult.Config);
       IncreaseConfidence(TempConfig);
       if (LearningDebugLevel >= 1)
@@ -1365,6 +1400,7 @@ void AdaptToChar(TBLOB *Blob,
       if (LearningDebugLevel >= 1)
         cprintf ("Found poor match to temp config %d = %4.1f%%.\n",
           IntResult.Config, (1.0 - IntResult.Rating) * 100.0);
+      AdaptedTemplatesChanges++;
       NewTempConfigId = MakeNewTemporaryConfig(AdaptedTemplates,
                                                ClassId,
                                                NumFeatures,
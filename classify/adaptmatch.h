@@ -38,6 +38,7 @@ extern int ReliableConfigThreshold;
 extern int tess_cn_matching;
 extern int tess_bn_matching;
 extern int LearningDebugLevel;
+extern int AdaptedTemplatesChanges;
 
 /**----------------------------------------------------------------------------
           Public Function Prototypes
@@ -56,6 +57,8 @@ void InitAdaptiveClassifier();
 
 void ResetAdaptiveClassifier();
 
+ADAPT_TEMPLATES SwapAdaptedTemplates(ADAPT_TEMPLATES Templates);
+
 void InitAdaptiveClassifierVars();
 
 void PrintAdaptiveStatistics(FILE *File);
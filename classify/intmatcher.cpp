@@ -24,8 +24,39 @@
 #include "callcpp.h"
 #include "scrollview.h"
 #include "globals.h"
+#include "emalloc.h"
 #include <math.h>
 
+/* The class pruner has SSE2 and AVX2 kernels on x86 compilers that let us
+ * select the instruction set per function; the CPU is checked at run time.
+ * Clang and GCC 5 on say so with __has_attribute, GCC 4.9 does not. */
+#ifdef __has_attribute
+#define SIMD_HAS_TARGET __has_attribute(target)
+#else
+#define SIMD_HAS_TARGET 0
+#endif
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+  (SIMD_HAS_TARGET || \
+   (!defined(__clang__) && __GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#define SIMD_SSE2
+#define SIMD_AVX2
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#define SIMD_CPU_HAS(isa) __builtin_cpu_supports(isa)
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE2
+#define SIMD_TARGET(isa)
+#define SIMD_CPU_HAS(isa) 1
+#endif
+
+/* The integer matcher helpers are inlined into the matcher itself, so they
+ * use SSE2 only when the whole file is compiled for it, as on x86-64. */
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IM_SSE2
+#endif
+
 #define CLASS_MASK_SIZE ((MAX_NUM_CLASSES*NUM_BITS_PER_CLASS \
 		+BITS_PER_WERD-1)/BITS_PER_WERD)
 
@@ -96,7 +127,12 @@ static uinT32 TableTruncShiftBits;
 
 uinT32 EvidenceMultMask;
 
-static inT16 LocalMatcherMultiplier;
+/* Scratch state used by the matcher entry points that take no state. */
+static INT_MATCHER_STATE_STRUCT DefaultMatcherState;
+
+#ifdef SIMD_AVX2
+static int HaveAVX2 = 0;
+#endif
 
 make_int_var (ClassPrunerThreshold, 229, MakeClassPrunerThreshold,
 16, 20, SetClassPrunerThreshold,
@@ -140,6 +176,14 @@ make_int_var (AdaptProtoThresh, 230, MakeAdaptProtoThresh,
 make_int_var (AdaptFeatureThresh, 230, MakeAdaptFeatureThresh,
 16, 30, SetAdaptFeatureThresh,
 "Threshold for good features during adaptive 0-255:   ");
+
+make_int_var (ClassPrunerKernel, 0, MakeClassPrunerKernel,
+16, 31, SetClassPrunerKernel,
+"Class Pruner Kernel 0=best 1=scalar 2=sse2 3=avx2:   ");
+
+make_int_var (ClassPrunerMaxResults, 0, MakeClassPrunerMaxResults,
+16, 32, SetClassPrunerMaxResults,
+"Max classes returned by Class Pruner 0=all:   ");
 //extern int display_ratings;
 //extern inT32                                  cp_maps[4];
 
@@ -150,6 +194,21 @@ int set_proto_bits;
 int config_shifts;
 int set_config_bits;
 
+static inline void IMMaxConfigEvidence(uinT8 FeatureEvidence[MAX_NUM_CONFIGS],
+                                       uinT32 ConfigWord,
+                                       uinT8 Evidence);
+
+static inline int IMAddFeatureEvidence(int SumOfFeatureEvidence[MAX_NUM_CONFIGS],
+                                       uinT8 FeatureEvidence[MAX_NUM_CONFIGS],
+                                       int NumConfigs);
+
+static inline void IMAddProtoEvidence(int SumOfFeatureEvidence[MAX_NUM_CONFIGS],
+                                      uinT32 ConfigWord,
+                                      int Evidence);
+
+static inline int IMSumProtoEvidence(uinT8 ProtoEvidence[MAX_PROTO_INDEX],
+                                     int ProtoLength);
+
 /**----------------------------------------------------------------------------
               Public Code
 ----------------------------------------------------------------------------**/
@@ -161,8 +220,29 @@ int ClassPruner(INT_TEMPLATES IntTemplates,
                 CLASS_CUTOFF_ARRAY ExpectedNumFeatures,
                 CLASS_PRUNER_RESULTS Results,
                 int Debug) {
+/*
+ **      Operation:
+ **              Run the class pruner with the default matcher state.
+ **              Not reentrant: see the version that takes a state.
+ */
+  return ClassPruner(&DefaultMatcherState, IntTemplates, NumFeatures,
+                     Features, NormalizationFactors, ExpectedNumFeatures,
+                     Results, Debug);
+}
+
+
+/*---------------------------------------------------------------------------*/
+int ClassPruner(INT_MATCHER_STATE State,
+                INT_TEMPLATES IntTemplates,
+                inT16 NumFeatures,
+                INT_FEATURE_ARRAY Features,
+                CLASS_NORMALIZATION_ARRAY NormalizationFactors,
+                CLASS_CUTOFF_ARRAY ExpectedNumFeatures,
+                CLASS_PRUNER_RESULTS Results,
+                int Debug) {
 /*
  **      Parameters:
+ **              State                  Scratch tables for this call
  **              IntTemplates           Class pruner tables
  **              NumFeatures            Number of features in blob
  **              Features               Array of features
@@ -178,10 +258,13 @@ int ClassPruner(INT_TEMPLATES IntTemplates,
  **      Globals:
  **              ClassPrunerThreshold   Cutoff threshold
  **              ClassPrunerMultiplier  Normalization factor multiplier
+ **              ClassPrunerMaxResults  Max number of classes returned
  **      Operation:
  **              Prune the classes using a modified fast match table.
  **              Return a sorted list of classes along with the number
- **              of pruned classes in that list.
+ **              of pruned classes in that list.  If more than
+ **              ClassPrunerMaxResults classes survive, only the best
+ **              ones are sorted and returned.
  **      Return: Number of pruned classes.
  **      Exceptions: none
  **      History: Tue Feb 19 10:24:24 MST 1991, RWM, Created.
@@ -197,10 +280,10 @@ int ClassPruner(INT_TEMPLATES IntTemplates,
   int NumPruners;
   inT32 feature_index;           //current feature
 
-  static int ClassCount[MAX_NUM_CLASSES];
-  static int NormCount[MAX_NUM_CLASSES];
-  static int SortKey[MAX_NUM_CLASSES + 1];
-  static int SortIndex[MAX_NUM_CLASSES + 1];
+  int *ClassCount = State->ClassCount;
+  int *NormCount = State->NormCount;
+  int *SortKey = State->SortKey;
+  int *SortIndex = State->SortIndex;
   CLASS_INDEX Class;
   int out_class;
   int MaxNumClasses;
@@ -219,55 +302,7 @@ int ClassPruner(INT_TEMPLATES IntTemplates,
   }
 
   /* Update Class Counts */
-  NumPruners = NumClassPrunersIn (IntTemplates);
-  for (feature_index = 0; feature_index < NumFeatures; feature_index++) {
-    feature = &Features[feature_index];
-    feature_address = (((feature->X * NUM_CP_BUCKETS >> 8) * NUM_CP_BUCKETS
-      +
-      (feature->Y * NUM_CP_BUCKETS >> 8)) *
-      NUM_CP_BUCKETS +
-      (feature->Theta * NUM_CP_BUCKETS >> 8)) << 1;
-    ClassPruner = ClassPrunersFor (IntTemplates);
-    class_index = 0;
-    for (PrunerSet = 0; PrunerSet < NumPruners; PrunerSet++, ClassPruner++) {
-      BasePrunerAddress = (uinT32 *) (*ClassPruner) + feature_address;
-
-      for (Word = 0; Word < WERDS_PER_CP_VECTOR; Word++) {
-        PrunerWord = *BasePrunerAddress++;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-        PrunerWord >>= 2;
-        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
-      }
-    }
-  }
+  CPUpdateClassCounts(State, IntTemplates, NumFeatures, Features, ClassCount);
 
   /* Adjust Class Counts for Number of Expected Features */
   for (Class = 0; Class < MaxNumClasses; Class++) {
@@ -304,12 +339,26 @@ int ClassPruner(INT_TEMPLATES IntTemplates,
     SortKey[NumClasses] = NormCount[Class];
   }
 
+  State->CPCalls++;
+  State->CPSurvivors += NumClasses;
+  State->CPLastSurvivors = NumClasses;
+  if (NumClasses > State->CPMaxSurvivors)
+    State->CPMaxSurvivors = NumClasses;
+
+  /* Keep only the best classes if asked to */
+  if (ClassPrunerMaxResults > 0 && NumClasses > ClassPrunerMaxResults) {
+    SelectTopK(ClassPrunerMaxResults, NumClasses, SortKey, SortIndex);
+    NumClasses = ClassPrunerMaxResults;
+  }
+  State->CPResults += NumClasses;
+
   /* Sort Classes using Heapsort Algorithm */
   if (NumClasses > 1)
     HeapSort(NumClasses, SortKey, SortIndex);
 
   if (display_ratings > 1) {
-    cprintf ("CP:%d classes, %d features:\n", NumClasses, NumFeatures);
+    cprintf ("CP:%d classes (%d survived), %d features:\n",
+             NumClasses, State->CPLastSurvivors, NumFeatures);
     for (Class = 0; Class < NumClasses; Class++) {
       classch = ClassIdForIndex (IntTemplates, SortIndex[NumClasses - Class]);
       cprintf ("%s:C=%d, E=%d, N=%d, Rat=%d\n",
@@ -390,8 +439,31 @@ void IntegerMatcher(INT_CLASS ClassTemplate,
                     uinT8 NormalizationFactor,
                     INT_RESULT Result,
                     int Debug) {
+/*
+ **      Operation:
+ **              Run the integer matcher with the default matcher state.
+ **              Not reentrant: see the version that takes a state.
+ */
+  IntegerMatcher(&DefaultMatcherState, ClassTemplate, ProtoMask, ConfigMask,
+                 BlobLength, NumFeatures, Features, NormalizationFactor,
+                 Result, Debug);
+}
+
+
+/*---------------------------------------------------------------------------*/
+void IntegerMatcher(INT_MATCHER_STATE State,
+                    INT_CLASS ClassTemplate,
+                    BIT_VECTOR ProtoMask,
+                    BIT_VECTOR ConfigMask,
+                    uinT16 BlobLength,
+                    inT16 NumFeatures,
+                    INT_FEATURE_ARRAY Features,
+                    uinT8 NormalizationFactor,
+                    INT_RESULT Result,
+                    int Debug) {
 /*
  **      Parameters:
+ **              State                     Scratch tables for this call
  **              ClassTemplate             Prototypes & tables for a class
  **              BlobLength                Length of unormalized blob
  **              NumFeatures               Number of features in blob
@@ -402,7 +474,6 @@ void IntegerMatcher(INT_CLASS ClassTemplate,
  **                                        (0.0 -> 1.0), 0=good, 1=bad
  **              Debug                     Debugger flag: 1=debugger on
  **      Globals:
- **              LocalMatcherMultiplier    Normalization factor multiplier
  **              IntThetaFudge             Theta fudge factor used for
  **                                        evidence calculation
  **      Operation:
@@ -414,9 +485,9 @@ void IntegerMatcher(INT_CLASS ClassTemplate,
  **      Exceptions: none
  **      History: Tue Feb 19 16:36:23 MST 1991, RWM, Created.
  */
-  static uinT8 FeatureEvidence[MAX_NUM_CONFIGS];
-  static int SumOfFeatureEvidence[MAX_NUM_CONFIGS];
-  static uinT8 ProtoEvidence[MAX_NUM_PROTOS][MAX_PROTO_INDEX];
+  uinT8 *FeatureEvidence = State->FeatureEvidence;
+  int *SumOfFeatureEvidence = State->SumOfFeatureEvidence;
+  uinT8 (*ProtoEvidence)[MAX_PROTO_INDEX] = State->ProtoEvidence;
   int Feature;
   int BestMatch;
 
@@ -478,11 +549,13 @@ void IntegerMatcher(INT_CLASS ClassTemplate,
                     SumOfFeatureEvidence,
                     BlobLength,
                     NormalizationFactor,
+                    State->LocalMatcherMultiplier,
                     Result);
 
 #ifndef GRAPHICS_DISABLED
   if (PrintMatchSummaryOn (Debug))
-    IMDebugBestMatch(BestMatch, Result, BlobLength, NormalizationFactor);
+    IMDebugBestMatch(BestMatch, Result, BlobLength, NormalizationFactor,
+                     State->LocalMatcherMultiplier);
 
   if (MatchDebuggingOn (Debug))
     cprintf ("Match Complete --------------------------------------------\n");
@@ -500,8 +573,30 @@ int FindGoodProtos(INT_CLASS ClassTemplate,
                    INT_FEATURE_ARRAY Features,
                    PROTO_ID *ProtoArray,
                    int Debug) {
+/*
+ **      Operation:
+ **              Find good protos with the default matcher state.
+ **              Not reentrant: see the version that takes a state.
+ */
+  return FindGoodProtos(&DefaultMatcherState, ClassTemplate, ProtoMask,
+                        ConfigMask, BlobLength, NumFeatures, Features,
+                        ProtoArray, Debug);
+}
+
+
+/*---------------------------------------------------------------------------*/
+int FindGoodProtos(INT_MATCHER_STATE State,
+                   INT_CLASS ClassTemplate,
+                   BIT_VECTOR ProtoMask,
+                   BIT_VECTOR ConfigMask,
+                   uinT16 BlobLength,
+                   inT16 NumFeatures,
+                   INT_FEATURE_ARRAY Features,
+                   PROTO_ID *ProtoArray,
+                   int Debug) {
 /*
  **      Parameters:
+ **              State                     Scratch tables for this call
  **              ClassTemplate             Prototypes & tables for a class
  **              ProtoMask                 AND Mask for proto word
  **              ConfigMask                AND Mask for config word
@@ -511,7 +606,6 @@ int FindGoodProtos(INT_CLASS ClassTemplate,
  **              ProtoArray                Array of good protos
  **              Debug                     Debugger flag: 1=debugger on
  **      Globals:
- **              LocalMatcherMultiplier    Normalization factor multiplier
  **              IntThetaFudge             Theta fudge factor used for
  **                                        evidence calculation
  **              AdaptProtoThresh          Threshold for good protos
@@ -524,12 +618,10 @@ int FindGoodProtos(INT_CLASS ClassTemplate,
  **      Exceptions: none
  **      History: Tue Mar 12 17:09:26 MST 1991, RWM, Created
  */
-  static uinT8 FeatureEvidence[MAX_NUM_CONFIGS];
-  static int SumOfFeatureEvidence[MAX_NUM_CONFIGS];
-  static uinT8 ProtoEvidence[MAX_NUM_PROTOS][MAX_PROTO_INDEX];
+  uinT8 *FeatureEvidence = State->FeatureEvidence;
+  int *SumOfFeatureEvidence = State->SumOfFeatureEvidence;
+  uinT8 (*ProtoEvidence)[MAX_PROTO_INDEX] = State->ProtoEvidence;
   int Feature;
-  register uinT8 *UINT8Pointer;
-  register int ProtoIndex;
   int NumProtos;
   int NumGoodProtos;
   uinT16 ActualProtoNum;
@@ -563,11 +655,8 @@ int FindGoodProtos(INT_CLASS ClassTemplate,
   NumGoodProtos = 0;
   for (ActualProtoNum = 0; ActualProtoNum < NumProtos; ActualProtoNum++) {
     /* Compute Average for Actual Proto */
-    Temp = 0;
-    UINT8Pointer = &(ProtoEvidence[ActualProtoNum][0]);
-    for (ProtoIndex = LengthForProtoId (ClassTemplate, ActualProtoNum);
-      ProtoIndex > 0; ProtoIndex--, UINT8Pointer++)
-    Temp += *UINT8Pointer;
+    Temp = IMSumProtoEvidence (ProtoEvidence[ActualProtoNum],
+      LengthForProtoId (ClassTemplate, ActualProtoNum));
 
     Temp /= LengthForProtoId (ClassTemplate, ActualProtoNum);
 
@@ -595,8 +684,30 @@ int FindBadFeatures(INT_CLASS ClassTemplate,
                     INT_FEATURE_ARRAY Features,
                     FEATURE_ID *FeatureArray,
                     int Debug) {
+/*
+ **      Operation:
+ **              Find bad features with the default matcher state.
+ **              Not reentrant: see the version that takes a state.
+ */
+  return FindBadFeatures(&DefaultMatcherState, ClassTemplate, ProtoMask,
+                         ConfigMask, BlobLength, NumFeatures, Features,
+                         FeatureArray, Debug);
+}
+
+
+/*---------------------------------------------------------------------------*/
+int FindBadFeatures(INT_MATCHER_STATE State,
+                    INT_CLASS ClassTemplate,
+                    BIT_VECTOR ProtoMask,
+                    BIT_VECTOR ConfigMask,
+                    uinT16 BlobLength,
+                    inT16 NumFeatures,
+                    INT_FEATURE_ARRAY Features,
+                    FEATURE_ID *FeatureArray,
+                    int Debug) {
 /*
  **      Parameters:
+ **              State                     Scratch tables for this call
  **              ClassTemplate             Prototypes & tables for a class
  **              ProtoMask                 AND Mask for proto word
  **              ConfigMask                AND Mask for config word
@@ -606,7 +717,6 @@ int FindBadFeatures(INT_CLASS ClassTemplate,
  **              FeatureArray              Array of bad features
  **              Debug                     Debugger flag: 1=debugger on
  **      Globals:
- **              LocalMatcherMultiplier    Normalization factor multiplier
  **              IntThetaFudge             Theta fudge factor used for
  **                                        evidence calculation
  **              AdaptFeatureThresh        Threshold for bad features
@@ -619,9 +729,9 @@ int FindBadFeatures(INT_CLASS ClassTemplate,
  **      Exceptions: none
  **      History: Tue Mar 12 17:09:26 MST 1991, RWM, Created
  */
-  static uinT8 FeatureEvidence[MAX_NUM_CONFIGS];
-  static int SumOfFeatureEvidence[MAX_NUM_CONFIGS];
-  static uinT8 ProtoEvidence[MAX_NUM_PROTOS][MAX_PROTO_INDEX];
+  uinT8 *FeatureEvidence = State->FeatureEvidence;
+  int *SumOfFeatureEvidence = State->SumOfFeatureEvidence;
+  uinT8 (*ProtoEvidence)[MAX_PROTO_INDEX] = State->ProtoEvidence;
   int Feature;
   register uinT8 *UINT8Pointer;
   register int ConfigNum;
@@ -688,6 +798,11 @@ void InitIntegerMatcher() {
   /* Set default mode of operation of IntegerMatcher */
   SetCharNormMatch();
 
+#ifdef SIMD_AVX2
+  __builtin_cpu_init ();
+  HaveAVX2 = SIMD_CPU_HAS ("avx2") ? 1 : 0;
+#endif
+
   /* Initialize table for evidence to similarity lookup */
   for (i = 0; i < SE_TABLE_SIZE; i++) {
     IntSimilarity = i << (27 - SE_TABLE_BITS);
@@ -732,6 +847,8 @@ void InitIntegerMatcherVars() {
   MakeIntEvidenceTruncBits();
   MakeSEExponentialMultiplier();
   MakeSimilarityCenter();
+  MakeClassPrunerKernel();
+  MakeClassPrunerMaxResults();
 }
 
 
@@ -741,6 +858,19 @@ void PrintIntMatcherStats(FILE *f) {
     protoword_lookups, zero_protowords, proto_shifts);
   fprintf (f, "set_proto_bits=%d, config_shifts=%d, set_config_bits=%d\n",
     set_proto_bits, config_shifts, set_config_bits);
+  PrintIntMatcherStats(f, &DefaultMatcherState);
+}
+
+
+/*-------------------------------------------------------------------------*/
+void PrintIntMatcherStats(FILE *f, INT_MATCHER_STATE State) {
+  fprintf (f, "class_pruner_calls=%d, survivors=%d (avg=%4.2f, max=%d)\n",
+    State->CPCalls, State->CPSurvivors,
+    State->CPCalls == 0 ? 0.0 : (float) State->CPSurvivors / State->CPCalls,
+    State->CPMaxSurvivors);
+  fprintf (f, "class_pruner_results=%d (avg=%4.2f)\n",
+    State->CPResults,
+    State->CPCalls == 0 ? 0.0 : (float) State->CPResults / State->CPCalls);
 }
 
 
@@ -766,19 +896,564 @@ void SetFeatureThresh(FLOAT32 Threshold) {
 
 /*--------------------------------------------------------------------------*/
 void SetBaseLineMatch() {
-  LocalMatcherMultiplier = 0;
+  SetBaseLineMatch(&DefaultMatcherState);
+}
+
+
+/*--------------------------------------------------------------------------*/
+void SetBaseLineMatch(INT_MATCHER_STATE State) {
+  State->LocalMatcherMultiplier = 0;
 }
 
 
 /*--------------------------------------------------------------------------*/
 void SetCharNormMatch() {
-  LocalMatcherMultiplier = IntegerMatcherMultiplier;
+  SetCharNormMatch(&DefaultMatcherState);
+}
+
+
+/*--------------------------------------------------------------------------*/
+void SetCharNormMatch(INT_MATCHER_STATE State) {
+  State->LocalMatcherMultiplier = IntegerMatcherMultiplier;
+}
+
+
+/*--------------------------------------------------------------------------*/
+INT_MATCHER_STATE NewIntMatcherState() {
+/*
+ **      Parameters: none
+ **      Globals:
+ **              IntegerMatcherMultiplier  Normalization factor multiplier
+ **      Operation:
+ **              Allocate the scratch tables for one thread of matching.
+ **              Any number of states may match against the same
+ **              templates concurrently once InitIntegerMatcher has run.
+ **              The new state is set up for char norm matching.
+ **      Return: New matcher state, free with FreeIntMatcherState.
+ **      Exceptions: none
+ */
+  INT_MATCHER_STATE State;
+
+  State = (INT_MATCHER_STATE) Emalloc (sizeof (INT_MATCHER_STATE_STRUCT));
+  memset(State, 0, sizeof (INT_MATCHER_STATE_STRUCT));
+  SetCharNormMatch(State);
+  return State;
+}
+
+
+/*--------------------------------------------------------------------------*/
+void FreeIntMatcherState(INT_MATCHER_STATE State) {
+  Efree(State);
 }
 
 
 /**----------------------------------------------------------------------------
               Private Code
 ----------------------------------------------------------------------------**/
+/*---------------------------------------------------------------------------*/
+static inline uinT32 CPFeatureAddress(INT_FEATURE Feature) {
+/*
+ **      Parameters:
+ **              Feature       Feature to look up in the class pruners
+ **      Operation:
+ **              Compute the word offset of the pruner vector for Feature
+ **              within a single CLASS_PRUNER_STRUCT.
+ **      Return: Word offset of the pruner vector.
+ **      Exceptions: none
+ */
+  return (((Feature->X * NUM_CP_BUCKETS >> 8) * NUM_CP_BUCKETS +
+    (Feature->Y * NUM_CP_BUCKETS >> 8)) * NUM_CP_BUCKETS +
+    (Feature->Theta * NUM_CP_BUCKETS >> 8)) * WERDS_PER_CP_VECTOR;
+}
+
+
+/*---------------------------------------------------------------------------*/
+static void CPUpdateClassCountsScalar(INT_TEMPLATES IntTemplates,
+                                      inT16 NumFeatures,
+                                      INT_FEATURE_ARRAY Features,
+                                      int ClassCount[]) {
+/*
+ **      Operation:
+ **              Reference class pruner kernel: unpack each pruner word
+ **              two bits at a time and add the mapped distance to the
+ **              count of every class.
+ */
+  uinT32 PrunerWord;
+  inT32 class_index;
+  int Word;
+  uinT32 *BasePrunerAddress;
+  uinT32 feature_address;
+  CLASS_PRUNER *ClassPruner;
+  int PrunerSet;
+  int NumPruners;
+  inT32 feature_index;
+
+  NumPruners = NumClassPrunersIn (IntTemplates);
+  for (feature_index = 0; feature_index < NumFeatures; feature_index++) {
+    feature_address = CPFeatureAddress (&Features[feature_index]);
+    ClassPruner = ClassPrunersFor (IntTemplates);
+    class_index = 0;
+    for (PrunerSet = 0; PrunerSet < NumPruners; PrunerSet++, ClassPruner++) {
+      BasePrunerAddress = (uinT32 *) (*ClassPruner) + feature_address;
+
+      for (Word = 0; Word < WERDS_PER_CP_VECTOR; Word++) {
+        PrunerWord = *BasePrunerAddress++;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+        PrunerWord >>= 2;
+        ClassCount[class_index++] += cp_maps[PrunerWord & 3];
+      }
+    }
+  }
+}
+
+
+#ifdef SIMD_SSE2
+/*---------------------------------------------------------------------------*/
+static void CPSetupByteCounts(INT_MATCHER_STATE State) {
+/*
+ **      Operation:
+ **              Rebuild the mapped distances of the 4 classes packed into
+ **              each possible pruner byte if cp_maps has changed since
+ **              they were last built for State.
+ */
+  int Byte;
+  int Class;
+
+  if (memcmp (State->CPByteCountMaps, cp_maps,
+              sizeof (State->CPByteCountMaps)) == 0)
+    return;
+  for (Byte = 0; Byte < 256; Byte++)
+    for (Class = 0; Class < 4; Class++)
+      State->CPByteCounts[Byte][Class] =
+        cp_maps[(Byte >> (Class * NUM_BITS_PER_CLASS)) & 3];
+  memcpy (State->CPByteCountMaps, cp_maps, sizeof (State->CPByteCountMaps));
+}
+
+
+/*---------------------------------------------------------------------------*/
+SIMD_TARGET ("sse2")
+static void CPUpdateClassCountsSSE2(INT_MATCHER_STATE State,
+                                    INT_TEMPLATES IntTemplates,
+                                    inT16 NumFeatures,
+                                    INT_FEATURE_ARRAY Features,
+                                    int ClassCount[]) {
+/*
+ **      Operation:
+ **              SSE2 class pruner kernel.  The counts for the 32 classes
+ **              of one pruner are held in 8 registers while all features
+ **              are scanned, and each pruner byte adds the mapped
+ **              distances of its 4 classes through the byte table
+ **              of State.
+ */
+  uinT32 FeatureAddress[MAX_NUM_INT_FEATURES];
+  CLASS_PRUNER *ClassPruner;
+  uinT32 *PrunerBase;
+  uinT32 *Words;
+  __m128i Counts[CLASSES_PER_CP / 4];
+  int NumPruners;
+  int PrunerSet;
+  int Feature;
+  int Word;
+  int Byte;
+  int i;
+
+  CPSetupByteCounts(State);
+  for (Feature = 0; Feature < NumFeatures; Feature++)
+    FeatureAddress[Feature] = CPFeatureAddress (&Features[Feature]);
+
+  NumPruners = NumClassPrunersIn (IntTemplates);
+  ClassPruner = ClassPrunersFor (IntTemplates);
+  for (PrunerSet = 0; PrunerSet < NumPruners;
+       PrunerSet++, ClassPruner++, ClassCount += CLASSES_PER_CP) {
+    PrunerBase = (uinT32 *) (*ClassPruner);
+    for (i = 0; i < CLASSES_PER_CP / 4; i++)
+      Counts[i] = _mm_loadu_si128 ((__m128i *) (ClassCount + i * 4));
+
+    for (Feature = 0; Feature < NumFeatures; Feature++) {
+      Words = PrunerBase + FeatureAddress[Feature];
+      for (Word = 0; Word < (int) WERDS_PER_CP_VECTOR; Word++) {
+        uinT32 PrunerWord = Words[Word];
+        for (Byte = 0; Byte < 4; Byte++, PrunerWord >>= 8) {
+          i = Word * 4 + Byte;
+          Counts[i] = _mm_add_epi32 (Counts[i],
+            _mm_loadu_si128 ((__m128i *)
+                             State->CPByteCounts[PrunerWord & 0xff]));
+        }
+      }
+    }
+
+    for (i = 0; i < CLASSES_PER_CP / 4; i++)
+      _mm_storeu_si128 ((__m128i *) (ClassCount + i * 4), Counts[i]);
+  }
+}
+#endif
+
+
+#ifdef SIMD_AVX2
+/*---------------------------------------------------------------------------*/
+SIMD_TARGET ("avx2")
+static void CPUpdateClassCountsAVX2(INT_TEMPLATES IntTemplates,
+                                    inT16 NumFeatures,
+                                    INT_FEATURE_ARRAY Features,
+                                    int ClassCount[]) {
+/*
+ **      Operation:
+ **              AVX2 class pruner kernel.  Each pruner word is broadcast
+ **              to 8 lanes, shifted per lane to expose one 2-bit class
+ **              distance each, and mapped through cp_maps with a lane
+ **              permute.  The 32 counts of a pruner stay in 4 registers.
+ */
+  uinT32 FeatureAddress[MAX_NUM_INT_FEATURES];
+  CLASS_PRUNER *ClassPruner;
+  uinT32 *PrunerBase;
+  uinT32 *Words;
+  __m256i Counts[CLASSES_PER_CP / 8];
+  __m256i LowShifts;
+  __m256i HighShifts;
+  __m256i ClassMask;
+  __m256i Maps;
+  __m256i PrunerWord;
+  int NumPruners;
+  int PrunerSet;
+  int Feature;
+  int Word;
+  int i;
+
+  for (Feature = 0; Feature < NumFeatures; Feature++)
+    FeatureAddress[Feature] = CPFeatureAddress (&Features[Feature]);
+
+  LowShifts = _mm256_setr_epi32 (0, 2, 4, 6, 8, 10, 12, 14);
+  HighShifts = _mm256_setr_epi32 (16, 18, 20, 22, 24, 26, 28, 30);
+  ClassMask = _mm256_set1_epi32 (3);
+  Maps = _mm256_setr_epi32 (cp_maps[0], cp_maps[1], cp_maps[2], cp_maps[3],
+                            cp_maps[0], cp_maps[1], cp_maps[2], cp_maps[3]);
+
+  NumPruners = NumClassPrunersIn (IntTemplates);
+  ClassPruner = ClassPrunersFor (IntTemplates);
+  for (PrunerSet = 0; PrunerSet < NumPruners;
+       PrunerSet++, ClassPruner++, ClassCount += CLASSES_PER_CP) {
+    PrunerBase = (uinT32 *) (*ClassPruner);
+    for (i = 0; i < CLASSES_PER_CP / 8; i++)
+      Counts[i] = _mm256_loadu_si256 ((__m256i *) (ClassCount + i * 8));
+
+    for (Feature = 0; Feature < NumFeatures; Feature++) {
+      Words = PrunerBase + FeatureAddress[Feature];
+      for (Word = 0; Word < (int) WERDS_PER_CP_VECTOR; Word++) {
+        PrunerWord = _mm256_set1_epi32 (Words[Word]);
+        Counts[Word * 2] = _mm256_add_epi32 (Counts[Word * 2],
+          _mm256_permutevar8x32_epi32 (Maps,
+            _mm256_and_si256 (_mm256_srlv_epi32 (PrunerWord, LowShifts),
+                              ClassMask)));
+        Counts[Word * 2 + 1] = _mm256_add_epi32 (Counts[Word * 2 + 1],
+          _mm256_permutevar8x32_epi32 (Maps,
+            _mm256_and_si256 (_mm256_srlv_epi32 (PrunerWord, HighShifts),
+                              ClassMask)));
+      }
+    }
+
+    for (i = 0; i < CLASSES_PER_CP / 8; i++)
+      _mm256_storeu_si256 ((__m256i *) (ClassCount + i * 8), Counts[i]);
+  }
+}
+#endif
+
+
+/*---------------------------------------------------------------------------*/
+void CPUpdateClassCounts(INT_MATCHER_STATE State,
+                         INT_TEMPLATES IntTemplates,
+                         inT16 NumFeatures,
+                         INT_FEATURE_ARRAY Features,
+                         int ClassCount[]) {
+/*
+ **      Parameters:
+ **              State                  Matcher state owning ClassCount
+ **              IntTemplates           Class pruner tables
+ **              NumFeatures            Number of features in blob
+ **              Features               Array of features
+ **              ClassCount             Counts to add the evidence of every
+ **                                     feature to (by CLASS_INDEX)
+ **      Globals:
+ **              ClassPrunerKernel      Kernel to use, 0 = best available
+ **      Operation:
+ **              Add the mapped class pruner distance of every feature to
+ **              the count of every class, using the widest kernel the CPU
+ **              supports unless ClassPrunerKernel asks for a narrower one.
+ **              All kernels produce identical counts.
+ **      Return: none
+ **      Exceptions: none
+ */
+#ifdef SIMD_AVX2
+  if ((ClassPrunerKernel == 0 || ClassPrunerKernel == 3) && HaveAVX2) {
+    CPUpdateClassCountsAVX2(IntTemplates, NumFeatures, Features, ClassCount);
+    return;
+  }
+#endif
+#ifdef SIMD_SSE2
+  if (ClassPrunerKernel != 1 && SIMD_CPU_HAS ("sse2")) {
+    CPUpdateClassCountsSSE2(State, IntTemplates, NumFeatures, Features,
+                            ClassCount);
+    return;
+  }
+#endif
+  CPUpdateClassCountsScalar(IntTemplates, NumFeatures, Features, ClassCount);
+}
+
+
+#ifdef IM_SSE2
+/*---------------------------------------------------------------------------*/
+static inline void IMExpandConfigWord(uinT32 ConfigWord,
+                                      __m128i *LowMask,
+                                      __m128i *HighMask) {
+/*
+ **      Parameters:
+ **              ConfigWord     32 config bits
+ **              LowMask        Byte mask for configs 0-15
+ **              HighMask       Byte mask for configs 16-31
+ **      Operation:
+ **              Expand each bit of ConfigWord into a byte of 0xff or 0.
+ */
+  const __m128i BitSelect = _mm_set_epi8 (-128, 64, 32, 16, 8, 4, 2, 1,
+                                          -128, 64, 32, 16, 8, 4, 2, 1);
+  __m128i Bytes;
+
+  /* Spread config byte i over the 8 mask bytes of configs 8i to 8i+7 */
+  Bytes = _mm_cvtsi32_si128 (ConfigWord);
+  Bytes = _mm_unpacklo_epi8 (Bytes, Bytes);
+  Bytes = _mm_unpacklo_epi16 (Bytes, Bytes);
+  *LowMask = _mm_unpacklo_epi32 (Bytes, Bytes);
+  *HighMask = _mm_unpackhi_epi32 (Bytes, Bytes);
+  *LowMask = _mm_cmpeq_epi8 (_mm_and_si128 (*LowMask, BitSelect), BitSelect);
+  *HighMask = _mm_cmpeq_epi8 (_mm_and_si128 (*HighMask, BitSelect),
+                              BitSelect);
+}
+#endif
+
+
+/*---------------------------------------------------------------------------*/
+static inline void IMMaxConfigEvidence(uinT8 FeatureEvidence[MAX_NUM_CONFIGS],
+                                       uinT32 ConfigWord,
+                                       uinT8 Evidence) {
+/*
+ **      Parameters:
+ **              FeatureEvidence  Feature Evidence Table
+ **              ConfigWord       Configs the current proto belongs to
+ **              Evidence         Evidence of the feature for the proto
+ **      Operation:
+ **              Raise the feature evidence of every config in ConfigWord
+ **              to at least Evidence.
+ */
+#ifdef IM_SSE2
+  __m128i LowMask;
+  __m128i HighMask;
+  __m128i Value;
+
+  if (ConfigWord == 0)
+    return;
+  IMExpandConfigWord(ConfigWord, &LowMask, &HighMask);
+  Value = _mm_set1_epi8 ((char) Evidence);
+  _mm_storeu_si128 ((__m128i *) FeatureEvidence,
+    _mm_max_epu8 (_mm_loadu_si128 ((__m128i *) FeatureEvidence),
+                  _mm_and_si128 (Value, LowMask)));
+  _mm_storeu_si128 ((__m128i *) (FeatureEvidence + 16),
+    _mm_max_epu8 (_mm_loadu_si128 ((__m128i *) (FeatureEvidence + 16)),
+                  _mm_and_si128 (Value, HighMask)));
+#else
+  register uinT8 *UINT8Pointer;
+  uinT8 config_byte;
+  inT32 config_offset;
+
+  UINT8Pointer = FeatureEvidence - 8;
+  config_byte = 0;
+  while (ConfigWord != 0 || config_byte != 0) {
+    while (config_byte == 0) {
+      config_byte = ConfigWord & 0xff;
+      ConfigWord >>= 8;
+      UINT8Pointer += 8;
+    }
+    config_offset = offset_table[config_byte];
+    config_byte = next_table[config_byte];
+    if (Evidence > UINT8Pointer[config_offset])
+      UINT8Pointer[config_offset] = Evidence;
+  }
+#endif
+}
+
+
+/*---------------------------------------------------------------------------*/
+static inline int IMAddFeatureEvidence(int SumOfFeatureEvidence[MAX_NUM_CONFIGS],
+                                       uinT8 FeatureEvidence[MAX_NUM_CONFIGS],
+                                       int NumConfigs) {
+/*
+ **      Parameters:
+ **              SumOfFeatureEvidence  Sum of Feature Evidence Table
+ **              FeatureEvidence       Feature Evidence Table
+ **              NumConfigs            Number of Configurations
+ **      Operation:
+ **              Add the evidence of the current feature for each config
+ **              into the sum of feature evidence.
+ **      Return: Sum of the feature evidence over all configs.
+ */
+  int SumOverConfigs = 0;
+  int ConfigNum = 0;
+
+#ifdef IM_SSE2
+  const __m128i Zero = _mm_setzero_si128 ();
+  __m128i Bytes;
+  __m128i Words;
+  __m128i Sum;
+
+  for (; ConfigNum + 16 <= NumConfigs; ConfigNum += 16) {
+    Bytes = _mm_loadu_si128 ((__m128i *) (FeatureEvidence + ConfigNum));
+    Sum = _mm_sad_epu8 (Bytes, Zero);
+    SumOverConfigs += _mm_cvtsi128_si32 (Sum) +
+      _mm_cvtsi128_si32 (_mm_srli_si128 (Sum, 8));
+
+    Words = _mm_unpacklo_epi8 (Bytes, Zero);
+    _mm_storeu_si128 ((__m128i *) (SumOfFeatureEvidence + ConfigNum),
+      _mm_add_epi32 (_mm_loadu_si128 ((__m128i *)
+                                      (SumOfFeatureEvidence + ConfigNum)),
+                     _mm_unpacklo_epi16 (Words, Zero)));
+    _mm_storeu_si128 ((__m128i *) (SumOfFeatureEvidence + ConfigNum + 4),
+      _mm_add_epi32 (_mm_loadu_si128 ((__m128i *)
+                                      (SumOfFeatureEvidence + ConfigNum + 4)),
+                     _mm_unpackhi_epi16 (Words, Zero)));
+    Words = _mm_unpackhi_epi8 (Bytes, Zero);
+    _mm_storeu_si128 ((__m128i *) (SumOfFeatureEvidence + ConfigNum + 8),
+      _mm_add_epi32 (_mm_loadu_si128 ((__m128i *)
+                                      (SumOfFeatureEvidence + ConfigNum + 8)),
+                     _mm_unpacklo_epi16 (Words, Zero)));
+    _mm_storeu_si128 ((__m128i *) (SumOfFeatureEvidence + ConfigNum + 12),
+      _mm_add_epi32 (_mm_loadu_si128 ((__m128i *)
+                                      (SumOfFeatureEvidence + ConfigNum + 12)),
+                     _mm_unpackhi_epi16 (Words, Zero)));
+  }
+#endif
+  for (; ConfigNum < NumConfigs; ConfigNum++) {
+    int evidence = FeatureEvidence[ConfigNum];
+    SumOverConfigs += evidence;
+    SumOfFeatureEvidence[ConfigNum] += evidence;
+  }
+  return SumOverConfigs;
+}
+
+
+/*---------------------------------------------------------------------------*/
+static inline void IMAddProtoEvidence(int SumOfFeatureEvidence[MAX_NUM_CONFIGS],
+                                      uinT32 ConfigWord,
+                                      int Evidence) {
+/*
+ **      Parameters:
+ **              SumOfFeatureEvidence  Sum of Feature Evidence Table
+ **              ConfigWord            Configs the proto belongs to
+ **              Evidence              Summed evidence of the proto
+ **      Operation:
+ **              Add Evidence to the sum of every config in ConfigWord.
+ */
+#ifdef IM_SSE2
+  __m128i ByteMask[2];
+  __m128i WordMask;
+  __m128i Value;
+  int *IntPointer;
+  int Half;
+
+  if (ConfigWord == 0)
+    return;
+  IMExpandConfigWord(ConfigWord, &ByteMask[0], &ByteMask[1]);
+  Value = _mm_set1_epi32 (Evidence);
+  IntPointer = SumOfFeatureEvidence;
+  for (Half = 0; Half < 2; Half++, IntPointer += 16) {
+    /* Sign extend the byte masks to 32 bit lanes, 4 configs at a time */
+    WordMask = _mm_unpacklo_epi8 (ByteMask[Half], ByteMask[Half]);
+    _mm_storeu_si128 ((__m128i *) IntPointer,
+      _mm_add_epi32 (_mm_loadu_si128 ((__m128i *) IntPointer),
+        _mm_and_si128 (Value, _mm_unpacklo_epi16 (WordMask, WordMask))));
+    _mm_storeu_si128 ((__m128i *) (IntPointer + 4),
+      _mm_add_epi32 (_mm_loadu_si128 ((__m128i *) (IntPointer + 4)),
+        _mm_and_si128 (Value, _mm_unpackhi_epi16 (WordMask, WordMask))));
+    WordMask = _mm_unpackhi_epi8 (ByteMask[Half], ByteMask[Half]);
+    _mm_storeu_si128 ((__m128i *) (IntPointer + 8),
+      _mm_add_epi32 (_mm_loadu_si128 ((__m128i *) (IntPointer + 8)),
+        _mm_and_si128 (Value, _mm_unpacklo_epi16 (WordMask, WordMask))));
+    _mm_storeu_si128 ((__m128i *) (IntPointer + 12),
+      _mm_add_epi32 (_mm_loadu_si128 ((__m128i *) (IntPointer + 12)),
+        _mm_and_si128 (Value, _mm_unpackhi_epi16 (WordMask, WordMask))));
+  }
+#else
+  register int *IntPointer;
+
+  IntPointer = SumOfFeatureEvidence;
+  while (ConfigWord) {
+    if (ConfigWord & 1)
+      *IntPointer += Evidence;
+    IntPointer++;
+    ConfigWord >>= 1;
+  }
+#endif
+}
+
+
+/*---------------------------------------------------------------------------*/
+static inline int IMSumProtoEvidence(uinT8 ProtoEvidence[MAX_PROTO_INDEX],
+                                     int ProtoLength) {
+/*
+ **      Parameters:
+ **              ProtoEvidence   Evidence list of one proto
+ **              ProtoLength     Length of the proto
+ **      Operation:
+ **              Sum the evidence of a proto.  IMClearTables zeroes the
+ **              whole list and IMUpdateTablesForFeature never writes past
+ **              ProtoLength, so the vector code can sum the entire list.
+ **      Return: Sum of the first ProtoLength evidence values.
+ */
+#ifdef IM_SSE2
+  const __m128i Zero = _mm_setzero_si128 ();
+  __m128i Sum;
+
+  Sum = _mm_add_epi64 (
+    _mm_sad_epu8 (_mm_loadu_si128 ((__m128i *) ProtoEvidence), Zero),
+    _mm_sad_epu8 (_mm_loadl_epi64 ((__m128i *) (ProtoEvidence + 16)), Zero));
+  return _mm_cvtsi128_si32 (Sum) + _mm_cvtsi128_si32 (_mm_srli_si128 (Sum, 8));
+#else
+  register uinT8 *UINT8Pointer;
+  register int Temp;
+
+  Temp = 0;
+  UINT8Pointer = ProtoEvidence;
+  for (; ProtoLength > 0; ProtoLength--, UINT8Pointer++)
+    Temp += *UINT8Pointer;
+  return Temp;
+#endif
+}
+
+
 /*---------------------------------------------------------------------------*/
 void
 IMClearTables (INT_CLASS ClassTemplate,
@@ -916,8 +1591,6 @@ int Debug) {
   uinT8 proto_byte;
   inT32 proto_word_offset;
   inT32 proto_offset;
-  uinT8 config_byte;
-  inT32 config_offset;
   PROTO_SET ProtoSet;
   uinT32 *ProtoPrunerPtr;
   INT_PROTO Proto;
@@ -929,8 +1602,6 @@ int Debug) {
   register uinT8 *UINT8Pointer;
   register int ProtoIndex;
   uinT8 Temp;
-  register int *IntPointer;
-  int ConfigNum;
   register inT32 M3;
   register inT32 A3;
   register uinT32 A4;
@@ -1000,21 +1671,7 @@ int Debug) {
               Evidence, ConfigMask, ConfigWord);
 
           ConfigWord &= *ConfigMask;
-
-          UINT8Pointer = FeatureEvidence - 8;
-          config_byte = 0;
-          while (ConfigWord != 0 || config_byte != 0) {
-            while (config_byte == 0) {
-              config_byte = ConfigWord & 0xff;
-              ConfigWord >>= 8;
-              UINT8Pointer += 8;
-              //                                              config_shifts++;
-            }
-            config_offset = offset_table[config_byte];
-            config_byte = next_table[config_byte];
-            if (Evidence > UINT8Pointer[config_offset])
-              UINT8Pointer[config_offset] = Evidence;
-          }
+          IMMaxConfigEvidence(FeatureEvidence, ConfigWord, Evidence);
 
           UINT8Pointer =
             &(ProtoEvidence[ActualProtoNum + proto_offset][0]);
@@ -1038,16 +1695,8 @@ int Debug) {
   if (PrintFeatureMatchesOn (Debug))
     IMDebugConfigurationSum (FeatureNum, FeatureEvidence,
       NumIntConfigsIn (ClassTemplate));
-  IntPointer = SumOfFeatureEvidence;
-  UINT8Pointer = FeatureEvidence;
-  int SumOverConfigs = 0;
-  for (ConfigNum = NumIntConfigsIn (ClassTemplate); ConfigNum > 0;
-  ConfigNum--) {
-    int evidence = *UINT8Pointer++;
-    SumOverConfigs += evidence;
-    *IntPointer++ += evidence;
-  }
-  return SumOverConfigs;
+  return IMAddFeatureEvidence(SumOfFeatureEvidence, FeatureEvidence,
+                              NumIntConfigsIn (ClassTemplate));
 }
 
 
@@ -1319,13 +1968,10 @@ inT16 NumFeatures) {
  **      Exceptions: none
  **      History: Wed Feb 27 14:12:28 MST 1991, RWM, Created.
  */
-  register uinT8 *UINT8Pointer;
-  register int *IntPointer;
   register uinT32 ConfigWord;
   int ProtoSetIndex;
   register uinT16 ProtoNum;
   PROTO_SET ProtoSet;
-  register int ProtoIndex;
   int NumProtos;
   uinT16 ActualProtoNum;
   int Temp;
@@ -1339,21 +1985,12 @@ inT16 NumFeatures) {
     for (ProtoNum = 0;
       ((ProtoNum < PROTOS_PER_PROTO_SET)
     && (ActualProtoNum < NumProtos)); ProtoNum++, ActualProtoNum++) {
-      Temp = 0;
-      UINT8Pointer = &(ProtoEvidence[ActualProtoNum][0]);
-      for (ProtoIndex = LengthForProtoId (ClassTemplate, ActualProtoNum);
-        ProtoIndex > 0; ProtoIndex--, UINT8Pointer++)
-      Temp += *UINT8Pointer;
+      Temp = IMSumProtoEvidence (ProtoEvidence[ActualProtoNum],
+        LengthForProtoId (ClassTemplate, ActualProtoNum));
 
       ConfigWord = (ProtoSet->Protos[ProtoNum]).Configs[0];
       ConfigWord &= *ConfigMask;
-      IntPointer = SumOfFeatureEvidence;
-      while (ConfigWord) {
-        if (ConfigWord & 1)
-          *IntPointer += Temp;
-        IntPointer++;
-        ConfigWord >>= 1;
-      }
+      IMAddProtoEvidence(SumOfFeatureEvidence, ConfigWord, Temp);
     }
   }
 }
@@ -1394,7 +2031,8 @@ int
 IMFindBestMatch (INT_CLASS ClassTemplate,
 int SumOfFeatureEvidence[MAX_NUM_CONFIGS],
 uinT16 BlobLength,
-uinT8 NormalizationFactor, INT_RESULT Result) {
+uinT8 NormalizationFactor,
+inT16 LocalMatcherMultiplier, INT_RESULT Result) {
 /*
  **      Parameters:
  **      Globals:
@@ -1451,7 +2089,8 @@ uinT8 NormalizationFactor, INT_RESULT Result) {
 void IMDebugBestMatch(int BestMatch,
                       INT_RESULT Result,
                       uinT16 BlobLength,
-                      uinT8 NormalizationFactor) {
+                      uinT8 NormalizationFactor,
+                      inT16 LocalMatcherMultiplier) {
 /*
  **      Parameters:
  **      Globals:
@@ -1474,6 +2113,80 @@ void IMDebugBestMatch(int BestMatch,
 }
 #endif
 
+/*---------------------------------------------------------------------------*/
+void SelectTopK(int k, int n, int ra[], int rb[]) {
+/*
+ **      Parameters:
+ **              k      Number of elements to keep
+ **              n      Number of elements
+ **              ra     Key array [1..n]
+ **              rb     Index array [1..n]
+ **      Globals:
+ **      Operation:
+ **              Move the k elements with the largest keys into [1..k],
+ **              in no particular order, keeping the index array tied to
+ **              the key array.  Of equal keys the one with the lower
+ **              index is kept, so rb must be ascending on entry.
+ **              [1..k] is kept as a heap with the smallest kept key, and
+ **              of those the highest index, at the root, so each
+ **              remaining element costs O(log k).  A later element has a
+ **              higher index than anything in the heap, so it only
+ **              replaces the root if its key is strictly larger.
+ **      Return:
+ **      Exceptions: none
+ */
+  int i, l, rra, rrb;
+
+  if (k >= n)
+    return;
+  for (l = k >> 1; l >= 1; l--)
+    SiftDownMinHeap(l, k, ra, rb);
+
+  for (i = k + 1; i <= n; i++) {
+    if (ra[i] > ra[1]) {
+      rra = ra[1];
+      rrb = rb[1];
+      ra[1] = ra[i];
+      rb[1] = rb[i];
+      ra[i] = rra;
+      rb[i] = rrb;
+      SiftDownMinHeap(1, k, ra, rb);
+    }
+  }
+}
+
+
+/*---------------------------------------------------------------------------*/
+void SiftDownMinHeap(int i, int n, int ra[], int rb[]) {
+/*
+ **      Parameters:
+ **              i      Element to sift down
+ **              n      Number of elements in the heap
+ **              ra     Key array [1..n]
+ **              rb     Index array [1..n]
+ **      Operation:
+ **              Restore the min-heap order of ra below element i.
+ **              Equal keys are ordered by descending index, so the
+ **              highest index of the smallest key is at the top.
+ */
+  int j, rra, rrb;
+
+  rra = ra[i];
+  rrb = rb[i];
+  for (j = i << 1; j <= n; i = j, j <<= 1) {
+    if (j < n && (ra[j + 1] < ra[j] ||
+                  (ra[j + 1] == ra[j] && rb[j + 1] > rb[j])))
+      ++j;
+    if (ra[j] > rra || (ra[j] == rra && rb[j] < rrb))
+      break;
+    ra[i] = ra[j];
+    rb[i] = rb[j];
+  }
+  ra[i] = rra;
+  rb[i] = rrb;
+}
+
+
 /*---------------------------------------------------------------------------*/
 void
 HeapSort (int n, register int ra[], register int rb[]) {
@@ -51,6 +51,31 @@ typedef CP_RESULT_STRUCT CLASS_PRUNER_RESULTS[MAX_NUM_CLASSES];
 
 typedef uinT8 CLASS_NORMALIZATION_ARRAY[MAX_NUM_CLASSES];
 
+/* Scratch tables for one thread of matching.  Every thread that classifies
+   concurrently needs its own state; the templates are only read. */
+typedef struct
+{
+  int ClassCount[MAX_NUM_CLASSES];
+  int NormCount[MAX_NUM_CLASSES];
+  int SortKey[MAX_NUM_CLASSES + 1];
+  int SortIndex[MAX_NUM_CLASSES + 1];
+  uinT8 FeatureEvidence[MAX_NUM_CONFIGS];
+  int SumOfFeatureEvidence[MAX_NUM_CONFIGS];
+  uinT8 ProtoEvidence[MAX_NUM_PROTOS][MAX_PROTO_INDEX];
+  inT32 CPByteCounts[256][4];
+  inT32 CPByteCountMaps[4];
+  inT16 LocalMatcherMultiplier;
+  /* Class pruner statistics */
+  int CPCalls;                   /* Number of blobs pruned */
+  int CPSurvivors;               /* Total classes over the threshold */
+  int CPMaxSurvivors;            /* Most classes over threshold for a blob */
+  int CPLastSurvivors;           /* Classes over threshold for last blob */
+  int CPResults;                 /* Total classes returned */
+}
+
+
+INT_MATCHER_STATE_STRUCT, *INT_MATCHER_STATE;
+
 /*----------------------------------------------------------------------------
             Variables
 -----------------------------------------------------------------------------*/
@@ -68,6 +93,15 @@ int ClassPruner(INT_TEMPLATES IntTemplates,
                 CLASS_PRUNER_RESULTS Results,
                 int Debug);
 
+int ClassPruner(INT_MATCHER_STATE State,
+                INT_TEMPLATES IntTemplates,
+                inT16 NumFeatures,
+                INT_FEATURE_ARRAY Features,
+                CLASS_NORMALIZATION_ARRAY NormalizationFactors,
+                CLASS_CUTOFF_ARRAY ExpectedNumFeatures,
+                CLASS_PRUNER_RESULTS Results,
+                int Debug);
+
 void IntegerMatcher(INT_CLASS ClassTemplate,
                     BIT_VECTOR ProtoMask,
                     BIT_VECTOR ConfigMask,
@@ -78,6 +112,17 @@ void IntegerMatcher(INT_CLASS ClassTemplate,
                     INT_RESULT Result,
                     int Debug);
 
+void IntegerMatcher(INT_MATCHER_STATE State,
+                    INT_CLASS ClassTemplate,
+                    BIT_VECTOR ProtoMask,
+                    BIT_VECTOR ConfigMask,
+                    uinT16 BlobLength,
+                    inT16 NumFeatures,
+                    INT_FEATURE_ARRAY Features,
+                    uinT8 NormalizationFactor,
+                    INT_RESULT Result,
+                    int Debug);
+
 int FindGoodProtos(INT_CLASS ClassTemplate,
                    BIT_VECTOR ProtoMask,
                    BIT_VECTOR ConfigMask,
@@ -87,6 +132,16 @@ int FindGoodProtos(INT_CLASS ClassTemplate,
                    PROTO_ID *ProtoArray,
                    int Debug);
 
+int FindGoodProtos(INT_MATCHER_STATE State,
+                   INT_CLASS ClassTemplate,
+                   BIT_VECTOR ProtoMask,
+                   BIT_VECTOR ConfigMask,
+                   uinT16 BlobLength,
+                   inT16 NumFeatures,
+                   INT_FEATURE_ARRAY Features,
+                   PROTO_ID *ProtoArray,
+                   int Debug);
+
 int FindBadFeatures(INT_CLASS ClassTemplate,
                     BIT_VECTOR ProtoMask,
                     BIT_VECTOR ConfigMask,
@@ -96,23 +151,49 @@ int FindBadFeatures(INT_CLASS ClassTemplate,
                     FEATURE_ID *FeatureArray,
                     int Debug);
 
+int FindBadFeatures(INT_MATCHER_STATE State,
+                    INT_CLASS ClassTemplate,
+                    BIT_VECTOR ProtoMask,
+                    BIT_VECTOR ConfigMask,
+                    uinT16 BlobLength,
+                    inT16 NumFeatures,
+                    INT_FEATURE_ARRAY Features,
+                    FEATURE_ID *FeatureArray,
+                    int Debug);
+
+INT_MATCHER_STATE NewIntMatcherState();
+
+void FreeIntMatcherState(INT_MATCHER_STATE State);
+
 void InitIntegerMatcher();
 
 void InitIntegerMatcherVars();
 
 void PrintIntMatcherStats(FILE *f);
 
+void PrintIntMatcherStats(FILE *f, INT_MATCHER_STATE State);
+
 void SetProtoThresh(FLOAT32 Threshold);
 
 void SetFeatureThresh(FLOAT32 Threshold);
 
 void SetBaseLineMatch();
 
+void SetBaseLineMatch(INT_MATCHER_STATE State);
+
 void SetCharNormMatch();
 
+void SetCharNormMatch(INT_MATCHER_STATE State);
+
 /**----------------------------------------------------------------------------
           Private Function Prototypes
 ----------------------------------------------------------------------------**/
+void CPUpdateClassCounts(INT_MATCHER_STATE State,
+                         INT_TEMPLATES IntTemplates,
+                         inT16 NumFeatures,
+                         INT_FEATURE_ARRAY Features,
+                         int ClassCount[]);
+
 void IMClearTables (INT_CLASS ClassTemplate,
 int SumOfFeatureEvidence[MAX_NUM_CONFIGS],
 uinT8 ProtoEvidence[MAX_NUM_PROTOS][MAX_PROTO_INDEX]);
@@ -179,15 +260,21 @@ inT16 NumFeatures, inT32 used_features);
 int IMFindBestMatch (INT_CLASS ClassTemplate,
 int SumOfFeatureEvidence[MAX_NUM_CONFIGS],
 uinT16 BlobLength,
-uinT8 NormalizationFactor, INT_RESULT Result);
+uinT8 NormalizationFactor,
+inT16 LocalMatcherMultiplier, INT_RESULT Result);
 
 #ifndef GRAPHICS_DISABLED
 void IMDebugBestMatch(int BestMatch,
                       INT_RESULT Result,
                       uinT16 BlobLength,
-                      uinT8 NormalizationFactor);
+                      uinT8 NormalizationFactor,
+                      inT16 LocalMatcherMultiplier);
 #endif
 
+void SelectTopK(int k, int n, int ra[], int rb[]);
+
+void SiftDownMinHeap(int i, int n, int ra[], int rb[]);
+
 void HeapSort (int n, register int ra[], register int rb[]);
 
 /**----------------------------------------------------------------------------
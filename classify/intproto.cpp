@@ -36,6 +36,9 @@
 #include <assert.h>
 #ifdef __UNIX__
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 /* match debug display constants*/
@@ -57,6 +60,14 @@
 #define INT_MAX_Y (  DISPLAY_OFFSET)
 #define DOUBLE_OFFSET 0.095
 
+/* first word of a template image, never a valid unicharset size in
+   either byte order */
+#define INT_TEMPLATES_IMAGE_MAGIC 0xC1A55140
+#define INT_TEMPLATES_IMAGE_VERSION 1
+/* alignment of the tables in a template image */
+#define INT_TEMPLATES_IMAGE_ALIGN 64
+#define MAX_INT_TEMPLATES_IMAGES  8
+
 /* define pad used to snap near horiz/vertical protos to horiz/vertical */
 #define HV_TOLERANCE  (0.0025)   /* approx 0.9 degrees */
 
@@ -99,6 +110,51 @@ typedef struct
 
 FILL_SPEC;
 
+/* header of a template image; all offsets are from the start of the file */
+typedef struct
+{
+  uinT32 Magic;
+  uinT32 Version;
+  int UnicharsetSize;
+  int NumClasses;
+  int NumClassPruners;
+  uinT32 ClassOffset;            /* INT_CLASS_IMAGE[NumClasses] */
+  uinT32 ClassPrunerOffset;      /* CLASS_PRUNER_STRUCT[NumClassPruners] */
+  uinT32 Size;                   /* of the whole image */
+  CLASS_TO_INDEX IndexFor;
+  INDEX_TO_CLASS ClassIdFor;
+}
+
+
+INT_TEMPLATES_IMAGE;
+
+/* one class of a template image */
+typedef struct
+{
+  uinT16 NumProtos;
+  uinT8 NumProtoSets;
+  uinT8 NumConfigs;
+  uinT16 ConfigLengths[MAX_NUM_CONFIGS];
+  uinT32 ProtoLengthsOffset;
+  uinT32 ProtoSetOffset[MAX_NUM_PROTO_SETS];
+}
+
+
+INT_CLASS_IMAGE;
+
+/* templates whose tables live in an image rather than in separate
+   allocations */
+typedef struct
+{
+  INT_TEMPLATES Templates;
+  void *Base;
+  size_t Size;
+  BOOL8 Mapped;                  /* else Base was Emalloced */
+}
+
+
+IMAGE_TEMPLATES;
+
 enum IntmatcherDebugAction {
   IDA_ADAPTIVE,
   IDA_STATIC,
@@ -268,6 +324,10 @@ make_float_const (PPSidePad, 2.5, MakePPSidePad);
 ScrollView *IntMatchWindow = NULL;
 //extern int LearningDebugLevel;
 
+/* templates loaded from images, so free_int_templates knows not to free
+   their tables one by one */
+static IMAGE_TEMPLATES ImageTemplates[MAX_INT_TEMPLATES_IMAGES];
+
 /**----------------------------------------------------------------------------
               Public Code
 ----------------------------------------------------------------------------**/
@@ -853,8 +913,24 @@ INT_TEMPLATES NewIntTemplates() {
 
 /*---------------------------------------------------------------------------*/
 void free_int_templates(INT_TEMPLATES templates) {
-  int i;
+  int i, slot;
 
+  for (slot = 0; slot < MAX_INT_TEMPLATES_IMAGES; slot++) {
+    if (ImageTemplates[slot].Templates == templates) {
+      /* only the classes are separate, all the tables are in the image */
+      for (i = 0; i < NumClassesIn (templates); i++)
+        Efree (ClassForIndex (templates, i));
+#ifdef __UNIX__
+      if (ImageTemplates[slot].Mapped)
+        munmap (ImageTemplates[slot].Base, ImageTemplates[slot].Size);
+      else
+#endif
+        Efree (ImageTemplates[slot].Base);
+      ImageTemplates[slot].Templates = NULL;
+      Efree(templates);
+      return;
+    }
+  }
   for (i = 0; i < NumClassesIn (templates); i++)
     free_int_class (ClassForIndex (templates, i));
   for (i = 0; i < NumClassPrunersIn (templates); i++)
@@ -1012,6 +1088,192 @@ INT_TEMPLATES ReadIntTemplates(FILE *File, BOOL8 swap) {
 }                                /* ReadIntTemplates */
 
 
+/*---------------------------------------------------------------------------*/
+/* Return the size of the open File, or -1 if it can't be found. */
+static long ImageFileSize(FILE *File) {
+#ifdef __UNIX__
+  struct stat Stat;
+
+  if (fstat (fileno (File), &Stat) != 0)
+    return -1;
+  return Stat.st_size;
+#else
+  if (fseek (File, 0, SEEK_END) != 0)
+    return -1;
+  return ftell (File);
+#endif
+}
+
+
+/*---------------------------------------------------------------------------*/
+/* Return TRUE if Length bytes at Offset lie within an image of Size bytes
+   and start where WriteImageTable would have put them. */
+static BOOL8 TableInImage(uinT32 Offset, size_t Length, uinT32 Size) {
+  return Offset % INT_TEMPLATES_IMAGE_ALIGN == 0 && Offset <= Size &&
+    Length <= Size - Offset;
+}
+
+
+/*---------------------------------------------------------------------------*/
+/* Return TRUE if every table of the image at Base, whose header has
+   already been checked, lies within the image. */
+static BOOL8 ImageTablesValid(const char *Base) {
+  const INT_TEMPLATES_IMAGE *Image = (const INT_TEMPLATES_IMAGE *) Base;
+  const INT_CLASS_IMAGE *ClassImage;
+  int i, j;
+
+  ClassImage = (const INT_CLASS_IMAGE *) (Base + Image->ClassOffset);
+  for (i = 0; i < Image->NumClasses; i++, ClassImage++) {
+    if (ClassImage->NumProtoSets > MAX_NUM_PROTO_SETS ||
+      ClassImage->NumConfigs > MAX_NUM_CONFIGS ||
+      ClassImage->NumProtos >
+      ClassImage->NumProtoSets * PROTOS_PER_PROTO_SET)
+      return FALSE;
+    if (!TableInImage (ClassImage->ProtoLengthsOffset,
+      sizeof (uinT8) * ClassImage->NumProtoSets * PROTOS_PER_PROTO_SET,
+      Image->Size))
+      return FALSE;
+    for (j = 0; j < ClassImage->NumProtoSets; j++)
+      if (!TableInImage (ClassImage->ProtoSetOffset[j],
+        sizeof (PROTO_SET_STRUCT), Image->Size))
+        return FALSE;
+  }
+  return TRUE;
+}
+
+
+/*---------------------------------------------------------------------------*/
+INT_TEMPLATES MapIntTemplates(const char *Filename) {
+/*
+ **	Parameters:
+ **		Filename	name of a file that may hold a template image
+ **	Globals:
+ **		ImageTemplates	templates that have been loaded from images
+ **	Operation: If Filename holds a template image written by
+ **		WriteIntTemplatesImage, map it read-only into memory and
+ **		build templates whose class pruners, proto sets and proto
+ **		lengths point straight into it, so that all processes
+ **		using the file share one copy of the tables. Where the
+ **		file can't be mapped it is read into memory instead.
+ **		The templates must be freed with free_int_templates and
+ **		must not be modified. Every table is checked to lie
+ **		within the file before it is used.
+ **	Return: The templates, or NULL if Filename is not an image or
+ **		the image is truncated or corrupt, in which case the
+ **		caller should read it with ReadIntTemplates.
+ **	Exceptions: Exits if the image does not match the unicharset.
+ */
+  int i, j, Slot;
+  FILE *File;
+  INT_TEMPLATES_IMAGE Header;
+  INT_TEMPLATES_IMAGE *Image;
+  INT_CLASS_IMAGE *ClassImage;
+  INT_TEMPLATES Templates;
+  INT_CLASS Class;
+  char *Base;
+  BOOL8 Mapped = FALSE;
+  long FileSize;
+
+  File = fopen (Filename, "rb");
+  if (File == NULL)
+    return NULL;
+  if (fread (&Header, sizeof (Header), 1, File) != 1 ||
+    Header.Magic != INT_TEMPLATES_IMAGE_MAGIC) {
+    fclose(File);
+    return NULL;
+  }
+  if (Header.Version != INT_TEMPLATES_IMAGE_VERSION ||
+    Header.UnicharsetSize != unicharset.size ()) {
+    cprintf ("Error: template image %s does not match the unicharset.\n",
+      Filename);
+    exit (1);
+  }
+  FileSize = ImageFileSize (File);
+  if (FileSize < 0 || Header.Size > (unsigned long) FileSize ||
+    Header.Size < sizeof (INT_TEMPLATES_IMAGE) ||
+    Header.NumClasses < 0 || Header.NumClasses > MAX_NUM_CLASSES ||
+    Header.NumClassPruners < 0 ||
+    Header.NumClassPruners > MAX_NUM_CLASS_PRUNERS ||
+    !TableInImage (Header.ClassOffset,
+    sizeof (INT_CLASS_IMAGE) * Header.NumClasses, Header.Size) ||
+    !TableInImage (Header.ClassPrunerOffset,
+    sizeof (CLASS_PRUNER_STRUCT) * Header.NumClassPruners, Header.Size)) {
+    cprintf ("Error: template image %s is truncated or corrupt.\n",
+      Filename);
+    fclose(File);
+    return NULL;
+  }
+  for (Slot = 0; Slot < MAX_INT_TEMPLATES_IMAGES; Slot++)
+    if (ImageTemplates[Slot].Templates == NULL)
+      break;
+  if (Slot == MAX_INT_TEMPLATES_IMAGES) {
+    fclose(File);
+    return NULL;
+  }
+
+  Base = NULL;
+#ifdef __UNIX__
+  Base = (char *) mmap (NULL, Header.Size, PROT_READ, MAP_SHARED,
+    fileno (File), 0);
+  if (Base == (char *) MAP_FAILED)
+    Base = NULL;
+  else
+    Mapped = TRUE;
+#endif
+  if (Base == NULL) {
+    Base = (char *) Emalloc (Header.Size);
+    fseek(File, 0, SEEK_SET);
+    if (fread (Base, 1, Header.Size, File) != Header.Size)
+      cprintf ("Bad read of template image!\n");
+  }
+  fclose(File);
+  Image = (INT_TEMPLATES_IMAGE *) Base;
+  /* the file may have changed since the header was read */
+  if (memcmp (Image, &Header, sizeof (Header)) != 0 ||
+    !ImageTablesValid (Base)) {
+    cprintf ("Error: template image %s is truncated or corrupt.\n",
+      Filename);
+#ifdef __UNIX__
+    if (Mapped)
+      munmap (Base, Header.Size);
+    else
+#endif
+      Efree (Base);
+    return NULL;
+  }
+
+  Templates = NewIntTemplates ();
+  NumClassesIn (Templates) = Image->NumClasses;
+  NumClassPrunersIn (Templates) = Image->NumClassPruners;
+  memcpy (Templates->IndexFor, Image->IndexFor, sizeof (CLASS_TO_INDEX));
+  memcpy (Templates->ClassIdFor, Image->ClassIdFor, sizeof (INDEX_TO_CLASS));
+  for (i = 0; i < NumClassPrunersIn (Templates); i++)
+    Templates->ClassPruner[i] = (CLASS_PRUNER)
+      (Base + Image->ClassPrunerOffset + i * sizeof (CLASS_PRUNER_STRUCT));
+
+  ClassImage = (INT_CLASS_IMAGE *) (Base + Image->ClassOffset);
+  for (i = 0; i < NumClassesIn (Templates); i++, ClassImage++) {
+    Class = (INT_CLASS) Emalloc (sizeof (INT_CLASS_STRUCT));
+    Class->NumProtos = ClassImage->NumProtos;
+    Class->NumProtoSets = ClassImage->NumProtoSets;
+    Class->NumConfigs = ClassImage->NumConfigs;
+    memcpy (Class->ConfigLengths, ClassImage->ConfigLengths,
+      sizeof (Class->ConfigLengths));
+    Class->ProtoLengths = (uinT8 *) (Base + ClassImage->ProtoLengthsOffset);
+    for (j = 0; j < NumProtoSetsIn (Class); j++)
+      ProtoSetIn (Class, j) =
+        (PROTO_SET) (Base + ClassImage->ProtoSetOffset[j]);
+    ClassForIndex (Templates, i) = Class;
+  }
+
+  ImageTemplates[Slot].Templates = Templates;
+  ImageTemplates[Slot].Base = Base;
+  ImageTemplates[Slot].Size = Header.Size;
+  ImageTemplates[Slot].Mapped = Mapped;
+  return (Templates);
+}                                /* MapIntTemplates */
+
+
 /*---------------------------------------------------------------------------*/
 #ifndef GRAPHICS_DISABLED
 void ShowMatchDisplay() {
@@ -1145,6 +1407,107 @@ void WriteIntTemplates(FILE *File, INT_TEMPLATES Templates,
 }                                /* WriteIntTemplates */
 
 
+/*---------------------------------------------------------------------------*/
+/* Write Size bytes of Data at the current end of an image, which is
+   first padded out to a multiple of INT_TEMPLATES_IMAGE_ALIGN. Returns
+   the offset the data was written at. */
+static uinT32 WriteImageTable(FILE *File, uinT32 *End,
+                              const void *Data, size_t Size) {
+  uinT32 Offset;
+
+  while (*End % INT_TEMPLATES_IMAGE_ALIGN != 0) {
+    fputc (0, File);
+    (*End)++;
+  }
+  Offset = *End;
+  fwrite (Data, 1, Size, File);
+  *End += Size;
+  return Offset;
+}
+
+
+/*---------------------------------------------------------------------------*/
+void WriteIntTemplatesImage(FILE *File, INT_TEMPLATES Templates,
+                            const UNICHARSET& target_unicharset) {
+/*
+ **	Parameters:
+ **		File		open file to write the image to
+ **		Templates	templates to save into File
+ **		target_unicharset	unicharset the templates are for
+ **	Globals: none
+ **	Operation: This routine writes Templates to File as an image
+ **		that MapIntTemplates can use in place: a header with the
+ **		class maps, a fixed size record per class, then the class
+ **		pruners, proto sets and proto lengths, each aligned and in
+ **		the byte order of this machine. File must be open for
+ **		binary writing and positioned at its start.
+ **	Return: none
+ **	Exceptions: none
+ */
+  int i, j;
+  INT_CLASS Class;
+  INT_TEMPLATES_IMAGE *Header;
+  INT_CLASS_IMAGE *Classes;
+  uinT32 End;
+
+  Header = (INT_TEMPLATES_IMAGE *) Emalloc (sizeof (INT_TEMPLATES_IMAGE));
+  memset(Header, 0, sizeof (INT_TEMPLATES_IMAGE));
+  Classes = (INT_CLASS_IMAGE *)
+    Emalloc (sizeof (INT_CLASS_IMAGE) * (NumClassesIn (Templates) + 1));
+  memset(Classes, 0, sizeof (INT_CLASS_IMAGE) * NumClassesIn (Templates));
+  Header->Magic = INT_TEMPLATES_IMAGE_MAGIC;
+  Header->Version = INT_TEMPLATES_IMAGE_VERSION;
+  Header->UnicharsetSize = target_unicharset.size ();
+  Header->NumClasses = NumClassesIn (Templates);
+  Header->NumClassPruners = NumClassPrunersIn (Templates);
+  memcpy (Header->IndexFor, Templates->IndexFor, sizeof (CLASS_TO_INDEX));
+  memcpy (Header->ClassIdFor, Templates->ClassIdFor,
+    sizeof (INDEX_TO_CLASS));
+
+  /* leave room for the header and class records, which are written
+     last once all the offsets are known */
+  End = 0;
+  WriteImageTable (File, &End, Header, sizeof (INT_TEMPLATES_IMAGE));
+  Header->ClassOffset = WriteImageTable (File, &End, Classes,
+    sizeof (INT_CLASS_IMAGE) * NumClassesIn (Templates));
+
+  for (i = 0; i < NumClassPrunersIn (Templates); i++) {
+    if (i == 0)
+      Header->ClassPrunerOffset =
+        WriteImageTable (File, &End, Templates->ClassPruner[i],
+        sizeof (CLASS_PRUNER_STRUCT));
+    else
+      WriteImageTable (File, &End, Templates->ClassPruner[i],
+        sizeof (CLASS_PRUNER_STRUCT));
+  }
+
+  for (i = 0; i < NumClassesIn (Templates); i++) {
+    Class = ClassForIndex (Templates, i);
+    Classes[i].NumProtos = Class->NumProtos;
+    Classes[i].NumProtoSets = Class->NumProtoSets;
+    Classes[i].NumConfigs = Class->NumConfigs;
+    memcpy (Classes[i].ConfigLengths, Class->ConfigLengths,
+      sizeof (Classes[i].ConfigLengths));
+    for (j = 0; j < NumProtoSetsIn (Class); j++)
+      Classes[i].ProtoSetOffset[j] =
+        WriteImageTable (File, &End, ProtoSetIn (Class, j),
+        sizeof (PROTO_SET_STRUCT));
+    Classes[i].ProtoLengthsOffset =
+      WriteImageTable (File, &End, Class->ProtoLengths,
+      sizeof (uinT8) * MaxNumIntProtosIn (Class));
+  }
+  Header->Size = End;
+
+  fseek(File, 0, SEEK_SET);
+  fwrite (Header, sizeof (INT_TEMPLATES_IMAGE), 1, File);
+  fseek(File, Header->ClassOffset, SEEK_SET);
+  fwrite (Classes, sizeof (INT_CLASS_IMAGE), NumClassesIn (Templates), File);
+  fseek(File, 0, SEEK_END);
+  Efree(Classes);
+  Efree(Header);
+}                                /* WriteIntTemplatesImage */
+
+
 /**----------------------------------------------------------------------------
               Private Code
 ----------------------------------------------------------------------------**/
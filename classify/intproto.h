@@ -236,6 +236,8 @@ void free_int_templates(INT_TEMPLATES templates);
 
 INT_TEMPLATES ReadIntTemplates(FILE *File, BOOL8 swap);
 
+INT_TEMPLATES MapIntTemplates(const char *Filename);
+
 void ShowMatchDisplay();
 
 CLASS_ID GetClassToDebug(const char *Prompt);
@@ -243,6 +245,9 @@ CLASS_ID GetClassToDebug(const char *Prompt);
 void WriteIntTemplates(FILE *File, INT_TEMPLATES Templates,
                        const UNICHARSET& target_unicharset);
 
+void WriteIntTemplatesImage(FILE *File, INT_TEMPLATES Templates,
+                            const UNICHARSET& target_unicharset);
+
 /*
 #if defined(__STDC__) || defined(__cplusplus)
 # define        _ARGS(s) s
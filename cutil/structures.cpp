@@ -61,6 +61,27 @@ freelist, LISTBLOCK, "LIST", listcount);
 newstructure (newblob, TBLOB, freeblob, BLOBBLOCK, "newblob", blobcount);
 oldstructure (oldblob, TBLOB, freeblob, "BLOB", blobcount);
 
-newstructure (newedgept, EDGEPT, freeedgept, EDGEPTBLOCK, "newedgept",
-edgeptcount);
-oldstructure (oldedgept, EDGEPT, freeedgept, "EDGEPT", edgeptcount);
+/**********************************************************************
+ * newedgept
+ *
+ * Make a new EDGEPT with everything zeroed, so oldedgept can test its
+ * flags before the caller has set them.
+ **********************************************************************/
+EDGEPT *newedgept() {
+  return new EDGEPT();
+}
+
+/**********************************************************************
+ * oldedgept
+ *
+ * Free an EDGEPT and return the next one.  Points made by the chopper
+ * belong to its pool, and are left for the pool to take back.
+ **********************************************************************/
+EDGEPT *oldedgept(EDGEPT *deadelement) {
+  EDGEPT *returnelement;         /*return next ptr */
+
+  returnelement = deadelement->next;
+  if (!deadelement->flags[EDGEPT_POOLED])
+    delete deadelement;
+  return returnelement;
+}
@@ -250,6 +250,33 @@ bool set_old_style_variable(const char* variable, const char* value) {
 }
 
 
+/**********************************************************************
+ * get_old_style_variable
+ *
+ * Write the current value of the named variable into value (of the
+ * given size) in the form accepted by set_old_style_variable. Returns
+ * false if there is no such variable.
+ **********************************************************************/
+bool get_old_style_variable(const char* variable, char* value, int size) {
+  char* var_variable = strdup(variable);
+  VARIABLE *this_var;
+
+  this_var = (VARIABLE *)first_node(search(variable_list, var_variable,
+                                           same_var_name));
+  free(var_variable);
+  if (this_var == NULL)
+    return false;
+  /* The writers prefix the name and round floats, so format directly */
+  if (this_var->type_writer == float_write)
+    snprintf(value, size, "%.9g", *((float *) this_var->address));
+  else if (this_var->type_writer == int_write)
+    snprintf(value, size, "%d", *((int *) this_var->address));
+  else if (*((char **) this_var->address) != NULL)
+    snprintf(value, size, "%s", *((char **) this_var->address));
+  else
+    value[0] = '\0';
+  return true;
+}
 /**********************************************************************
  * same_var_name
  *
@@ -159,6 +159,8 @@ void read_variables(const char *filename);
 
 bool set_old_style_variable(const char* variable, const char* value);
 
+bool get_old_style_variable(const char* variable, char* value, int size);
+
 int same_var_name(void *item1,   //VARIABLE *variable,
                   void *item2);  //char     *string)
 
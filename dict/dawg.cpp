@@ -29,6 +29,10 @@
 #include <windows.h>
 #else
 #include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 #include "dawg.h"
 #include "cutil.h"
@@ -38,12 +42,24 @@
 #include "strngs.h"
 #include "emalloc.h"
 
+/*----------------------------------------------------------------------
+              T y p e s
+----------------------------------------------------------------------*/
+typedef struct
+{
+  EDGE_ARRAY dawg;                 /* Edges handed out to the caller */
+  void       *base;                /* Start of the mapping */
+  size_t     size;                 /* Length of the mapping */
+} MAPPED_DAWG;
+
 /*----------------------------------------------------------------------
               V a r i a b l e s
 ----------------------------------------------------------------------*/
 inT32 debug          = 0;
 inT32 case_sensative = 1;
 
+static MAPPED_DAWG mapped_dawgs[MAX_MAPPED_DAWGS];
+
 /*----------------------------------------------------------------------
               F u n c t i o n s
 ----------------------------------------------------------------------*/
@@ -292,16 +308,69 @@ void print_dawg_node(EDGE_ARRAY dawg, NODE_REF node) {
 }
 
 
+/**********************************************************************
+ * map_native_dawg
+ *
+ * Map the edges of a native DAWG file read-only into memory, so that all
+ * processes using the file share a single copy in the page cache.
+ * Returns NULL if the file could not be mapped.
+ **********************************************************************/
+static EDGE_ARRAY map_native_dawg(const char *filename, inT32 num_edges) {
+#ifdef __MSW32__
+  return NULL;
+#else
+  int        fd;
+  int        slot;
+  struct stat file_stat;
+  size_t     size;
+  void       *base;
+
+  for (slot = 0; slot < MAX_MAPPED_DAWGS; slot++)
+    if (mapped_dawgs[slot].dawg == NULL) break;
+  if (slot == MAX_MAPPED_DAWGS)
+    return NULL;
+
+  size = NATIVE_DAWG_HEADER_SIZE + sizeof (EDGE_RECORD) * num_edges;
+  fd = open (filename, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat (fd, &file_stat) != 0 || file_stat.st_size < (off_t) size) {
+    close(fd);
+    return NULL;
+  }
+  base = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  mapped_dawgs[slot].base = base;
+  mapped_dawgs[slot].size = size;
+  mapped_dawgs[slot].dawg =
+    (EDGE_ARRAY) ((char *) base + NATIVE_DAWG_HEADER_SIZE);
+  return mapped_dawgs[slot].dawg;
+#endif
+}
+
+
 /**********************************************************************
  * read_squished_dawg
  *
- * Read the DAWG from a file and return it. Must be freed with memfree.
+ * Read the DAWG from a file and return it. Must be freed with
+ * free_squished_dawg. A native DAWG file (see write_native_dawg) is
+ * mapped read-only rather than copied, so the result must not be
+ * modified. The number of edges is returned in num_edges if it is not
+ * NULL.
  **********************************************************************/
 EDGE_ARRAY read_squished_dawg(const char *filename) {
+  return read_squished_dawg(filename, NULL);
+}
+
+EDGE_ARRAY read_squished_dawg(const char *filename, inT32 *edge_count) {
   FILE       *file;
   EDGE_REF   edge;
   inT32      num_edges = 0;
-  inT32      node_count = 0;
+  uinT32     magic = 0;
+  EDGE_ARRAY dawg;
 
   if (debug) print_string ("read_debug");
 
@@ -310,29 +379,87 @@ EDGE_ARRAY read_squished_dawg(const char *filename) {
   #else
   file = open_file (filename, "rb");
   #endif
-  fread (&num_edges,  sizeof (inT32), 1, file);
-  num_edges = ntohl(num_edges);
+  fread (&magic, sizeof (uinT32), 1, file);
+  if (magic == NATIVE_DAWG_MAGIC) {
+    fread (&num_edges, sizeof (inT32), 1, file);
+  } else {
+    num_edges = ntohl(magic);
+  }
   if (num_edges > MAX_NUM_EDGES_IN_SQUISHED_DAWG_FILE || num_edges < 0) {
     tprintf("(ENDIAN)Error: trying to read a DAWG '%s' that contains "
             "%d edges while the maximum is %d.\n",
             filename, num_edges, MAX_NUM_EDGES_IN_SQUISHED_DAWG_FILE);
     exit(1);
   }
+  if (edge_count != NULL)
+    *edge_count = num_edges;
+
+  if (magic == NATIVE_DAWG_MAGIC) {
+    dawg = map_native_dawg (filename, num_edges);
+    if (dawg == NULL) {
+      /* Can't map it, but the edges can still be used as they are */
+      dawg = (EDGE_ARRAY) memalloc (sizeof (EDGE_RECORD) * num_edges);
+      fread (dawg, sizeof (EDGE_RECORD), num_edges, file);
+    }
+    fclose(file);
+    return dawg;
+  }
 
-  uinT32 *dawg_32 = (uinT32*) Emalloc(num_edges * sizeof (uinT32));
+  /* Read the 32 bit edges into the front of the buffer and widen them
+     in place from the back, so the file is only copied once */
+  dawg = (EDGE_ARRAY) memalloc (sizeof (EDGE_RECORD) * num_edges);
+  uinT32 *dawg_32 = (uinT32 *) dawg;
   fread(&dawg_32[0], sizeof (uinT32), num_edges, file);
   fclose(file);
-  EDGE_ARRAY dawg = (EDGE_ARRAY) memalloc(sizeof(EDGE_RECORD) * num_edges);
 
-  for (edge = 0; edge < num_edges; ++edge)
+  for (edge = num_edges - 1; edge >= 0; --edge)
     dawg[edge] = ntohl(dawg_32[edge]);
 
-  Efree(dawg_32);
+  return dawg;
+}
 
-  for (edge = 0; edge < num_edges; ++edge)
-    if (last_edge (dawg, edge)) node_count++;
 
-  return dawg;
+/**********************************************************************
+ * free_squished_dawg
+ *
+ * Release a DAWG returned by read_squished_dawg.
+ **********************************************************************/
+void free_squished_dawg(EDGE_ARRAY dawg) {
+  int slot;
+
+  if (dawg == NULL)
+    return;
+  for (slot = 0; slot < MAX_MAPPED_DAWGS; slot++) {
+    if (mapped_dawgs[slot].dawg == dawg) {
+#ifndef __MSW32__
+      munmap (mapped_dawgs[slot].base, mapped_dawgs[slot].size);
+#endif
+      mapped_dawgs[slot].dawg = NULL;
+      return;
+    }
+  }
+  memfree(dawg);
+}
+
+
+/**********************************************************************
+ * write_native_dawg
+ *
+ * Write a DAWG as returned by read_squished_dawg in the native byte
+ * order and edge size, so that read_squished_dawg can map it in place.
+ * The file is only readable on machines of the same byte order.
+ **********************************************************************/
+void write_native_dawg(const char *filename,
+                       EDGE_ARRAY dawg,
+                       inT32      num_edges) {
+  FILE       *file;
+  uinT32     magic = NATIVE_DAWG_MAGIC;
+
+  file = open_file (filename, "wb");
+  fwrite (&magic, sizeof (uinT32), 1, file);
+  fwrite (&num_edges, sizeof (inT32), 1, file);
+  fwrite (dawg, sizeof (EDGE_RECORD), num_edges, file);
+  fclose(file);
 }
 
 
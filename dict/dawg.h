@@ -82,6 +82,13 @@
 
 #define MAX_NUM_EDGES_IN_SQUISHED_DAWG_FILE 2000000
 
+/* First word of a native DAWG file. Read as the big-endian edge count of
+   the portable format it is negative in either byte order. The header is
+   this word and the edge count, which keeps the edges 8 byte aligned. */
+#define NATIVE_DAWG_MAGIC      0x8A57DA80
+#define NATIVE_DAWG_HEADER_SIZE 8
+#define MAX_MAPPED_DAWGS       16
+
 #define REFFORMAT "%lld"
 
 typedef uinT64 EDGE_RECORD;
@@ -338,6 +345,14 @@ void print_dawg_node(EDGE_ARRAY dawg, NODE_REF node);
 
 EDGE_ARRAY read_squished_dawg(const char *filename);
 
+EDGE_ARRAY read_squished_dawg(const char *filename, inT32 *edge_count);
+
+void free_squished_dawg(EDGE_ARRAY dawg);
+
+void write_native_dawg(const char *filename,
+                       EDGE_ARRAY dawg,
+                       inT32      num_edges);
+
 inT32 verify_trailing_punct(EDGE_ARRAY dawg, char *word, inT32 char_index);
 
 inT32 word_in_dawg(EDGE_ARRAY dawg, const char *string);
@@ -394,7 +394,7 @@ void init_permdawg() {
 }
 
 void end_permdawg() {
-  memfree(frequent_words);
+  free_squished_dawg(frequent_words);
   frequent_words = NULL;
 }
 
@@ -1042,7 +1042,7 @@ void init_permute() {
 void end_permute() {
   if (word_dawg == NULL)
     return;  // Not safe to call twice.
-  memfree(word_dawg);
+  free_squished_dawg(word_dawg);
   word_dawg = NULL;
   memfree(document_words);
   document_words =  NULL;
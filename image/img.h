@@ -56,8 +56,9 @@ class DLLSYM IMAGE               //encapsulated image
     IMAGE & operator= (          //assignment
       IMAGE & source);
 
-    inT8 read_header(                    //get file header
-                     const char *name);  //name of image
+    inT8 read_header(                     //get file header
+                     const char *name,    //name of image
+                     inT32 page = 0);     //page number from 0
 
     inT8 read(                  //get rest of image
               inT32 buflines);  //size of buffer
@@ -70,11 +71,18 @@ class DLLSYM IMAGE               //encapsulated image
                 inT32 y,               //ysize required
                 inT8 bits_per_pixel);  //bpp required
 
-    inT8 capture(                       //capture raw image
-                 uinT8 *pixels,         //pixels to capture
-                 inT32 x,               //x size required
-                 inT32 y,               //ysize required
-                 inT8 bits_per_pixel);  //bpp required
+    inT8 reuse_or_create(              //create, keeping memory
+                         inT32 x,      //x size required
+                         inT32 y,      //ysize required
+                         inT8 bits_per_pixel);  //bpp required
+
+    inT8 capture(                          //capture raw image
+                 uinT8 *pixels,            //pixels to capture
+                 inT32 x,                  //x size required
+                 inT32 y,                  //ysize required
+                 inT8 bits_per_pixel,      //bpp required
+                 inT32 bytes_per_line = 0, //0 for packed lines
+                 BOOL8 bottom_up = FALSE); //first line is bottom
 
     void destroy();  //destroy image
 
@@ -95,6 +103,10 @@ class DLLSYM IMAGE               //encapsulated image
     BOOL8 white_high() {  //photo interp
       return photo_interp;
     }
+    void set_white_high(  //set photo interp
+                        BOOL8 white_is_high) {
+      photo_interp = white_is_high;
+    }
     uinT8 get_white_level() {  //access function
       return (1 << bpp) - 1;
     }
@@ -110,6 +122,9 @@ class DLLSYM IMAGE               //encapsulated image
     }
     //access function
 
+    uinT8 *get_raw_line(           //get packed line
+                        inT32 y);  //line to get
+
     uinT8 pixel(           //access pixel
                 inT32 x,   //x coord
                 inT32 y);  //y coord
@@ -30,6 +30,7 @@ const ERRCODE BADIMAGECOORDS = "Coordinates in image out of bounds";
 const ERRCODE BADIMAGESEEK = "Can't seek backwards in a buffered image!";
 const ERRCODE BADIMAGESIZE = "Illegal image size";
 const ERRCODE BADIMAGEFORMAT = "Illegal image format";
+const ERRCODE BADIMAGEPAGE = "No such page in image";
 const ERRCODE BADBPP = "Only 1,2,4,5,6,8 bpp are supported";
 const ERRCODE BADWINDOW = "Convolution window must have odd dimensions";
 #endif
@@ -109,21 +109,36 @@ static inT8 name_to_image_type(                  //get image type
  * read_header
  *
  * Read the header of an image, typed according to the extension of
- * the name.  Return is 0 for success, -1 for failure.
+ * the name.  Pages after the first can only be read from tif files, and
+ * are found with tif_page_directory, through the page index if there is
+ * one, without reading the pages before.
+ * Return is 0 for success, -1 for failure.
  **********************************************************************/
 
-inT8 IMAGE::read_header(                  //get file header
-                        const char *name  //name of image
+inT8 IMAGE::read_header(                   //get file header
+                        const char *name,  //name of image
+                        inT32 page         //page number from 0
                        ) {
   inT8 type;                     //image type
+  uinT32 directory;              //tag table of page
 
   destroy();  //destroy old image
                                  //get type
   type = name_to_image_type (name);
-  if (type < 0 || imagetypes[type].opener == NULL) {
+  if (type < 0 || imagetypes[type].opener == NULL
+  || (page > 0 && imagetypes[type].opener != open_tif_image)) {
     CANTREADIMAGETYPE.error ("IMAGE::read_header", TESSLOG, name);
     return -1;                   //read not supported
   }
+  directory = 0;
+  if (page > 0) {
+    directory = tif_page_directory (name, page);
+    if (directory == 0) {
+      BADIMAGEPAGE.error ("IMAGE::read_header", TESSLOG, "%s page %d",
+        name, page);
+      return -1;
+    }
+  }
   #ifdef __UNIX__
   if ((fd = open (name, O_RDONLY)) < 0)
   #endif
@@ -134,9 +149,13 @@ inT8 IMAGE::read_header(                  //get file header
     CANTOPENFILE.error ("IMAGE::read_header", TESSLOG, name);
     return -1;                   //failed
   }
-  lineskip =
-    (*imagetypes[type].opener) (fd, &xsize, &ysize, &bpp, &photo_interp,
-    &res);
+  if (page > 0)
+    lineskip = open_tif_directory (fd, directory, &xsize, &ysize, &bpp,
+      &photo_interp, &res);
+  else
+    lineskip =
+      (*imagetypes[type].opener) (fd, &xsize, &ysize, &bpp, &photo_interp,
+      &res);
   if (lineskip == -1) {
                                  //get header
     bpp = 0;                     //still empty
@@ -180,7 +199,7 @@ inT8 IMAGE::read(                //get rest of image
   if (fd < 0 || image != NULL)
     IMAGEUNDEFINED.error ("IMAGE::read", ABORT, NULL);
 
-  if (buflines <= 0 || buflines > ysize || reader == NULL)
+  if (buflines <= 0 || buflines > ysize || reader == NULL || lineskip < 0)
     buflines = ysize;            //default to all
   bufheight = buflines;
   image =
@@ -280,9 +299,19 @@ inT8 IMAGE::write(                  //write image
                   const char *name  //name to write
                  ) {
   inT8 type;                     //type of image
+  IMAGE packed;                  //copy with packed lines
 
   if (bpp == 0 || image == NULL || bufheight != ysize)
     IMAGEUNDEFINED.error ("IMAGE::write", ABORT, NULL);
+  if (xdim != check_legal_image_size (xsize, ysize, bpp)) {
+                                 //captured with other lines
+    if (packed.create (xsize, ysize, bpp) < 0)
+      return -1;
+    copy_sub_image (this, 0, 0, xsize, ysize, &packed, 0, 0, FALSE);
+    packed.photo_interp = photo_interp;
+    packed.res = res;
+    return packed.write (name);
+  }
   if (fd >= 0) {
     close(fd);  //close old file
     fd = -1;                     //no longer open
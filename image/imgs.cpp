@@ -46,6 +46,28 @@
 #include          "imgio.h"
 #include          "imgunpk.h"
 
+/* The bpp conversions in copy_sub_image use SSE2 when the whole file is
+ * compiled for it, as on x86-64, and SSSE3 byte shuffles for 24 bpp on
+ * x86 compilers that select the instruction set per function, with the
+ * CPU checked at run time. Clang and GCC 5 on say they can select it with
+ * __has_attribute, GCC 4.9 does not. */
+#ifdef __has_attribute
+#define IMG_HAS_TARGET __has_attribute(target)
+#else
+#define IMG_HAS_TARGET 0
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMG_SSE2
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+  (IMG_HAS_TARGET || \
+   (!defined(__clang__) && __GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <tmmintrin.h>
+#define IMG_SSSE3
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
 #define FIXED_COLOURS   32       /*number of fixed colours */
 #define MIN_4BIT      48         /*4bpp range */
 #define MAX_4BIT      64
@@ -64,6 +86,8 @@ static uinT8 grey_scales[FIXED_COLOURS] = {
 #define EXTERN
 
 EXTERN INT_VAR (image_default_resolution, 300, "Image resolution dpi");
+EXTERN BOOL_VAR (image_fast_convert, TRUE,
+"Convert 1, 8 and 24 bpp lines directly in copy_sub_image");
 
 /**********************************************************************
  * IMAGE
@@ -143,6 +167,49 @@ inT8 IMAGE::create(                     //get rest of image
 }
 
 
+/**********************************************************************
+ * get_raw_line
+ *
+ * Return a pointer to line y of the buffer, with the pixels packed as
+ * they are stored, reading more of the image in if need be. The
+ * pointer is only valid until the next line is got.
+ **********************************************************************/
+
+uinT8 *IMAGE::get_raw_line(          //get packed line
+                           inT32 y   //line to get
+                          ) {
+  this->check_legal_access (0, y, xsize);
+  return image + xdim * (ymax - 1 - y);
+}
+
+
+/**********************************************************************
+ * reuse_or_create
+ *
+ * As create, but if the image already owns memory of exactly the size
+ * needed, keep it rather than freeing it and allocating it again.
+ * The old pixels are NOT cleared, so the caller must write every pixel.
+ **********************************************************************/
+
+inT8 IMAGE::reuse_or_create(                  //create, keeping memory
+                            inT32 x,          //x size required
+                            inT32 y,          //ysize required
+                            inT8 bits_per_pixel  //bpp required
+                           ) {
+  uinT8 *pixels;                 //memory for image
+
+  if (image == NULL || captured || ymin != 0 || y != bufheight
+    || check_legal_image_size (x, y, bits_per_pixel) != xdim)
+    return create (x, y, bits_per_pixel);
+  pixels = image;
+  image = NULL;                  //so capture doesn't free it
+  this->capture (pixels, x, y, bits_per_pixel);
+  captured = FALSE;
+  res = image_default_resolution;
+  return 0;                      //success
+}
+
+
 /**********************************************************************
  * destroy
  *
@@ -166,19 +233,37 @@ void IMAGE::destroy() {  //get rid of image
  * capture
  *
  * Assign a given memory area to an image to use as an image of
- * given size and bpp.
+ * given size and bpp. The lines may be bytes_per_line apart, if more
+ * than they need, and may be stored bottom line first. Only the pixels
+ * of the lines are touched, so the memory may be shared with others,
+ * but it must stay valid for as long as the image is used.
  **********************************************************************/
 
-inT8 IMAGE::capture(                     //get rest of image
-                    uinT8 *pixels,       //image memory
-                    inT32 x,             //x size required
-                    inT32 y,             //ysize required
-                    inT8 bits_per_pixel  //bpp required
+inT8 IMAGE::capture(                      //get rest of image
+                    uinT8 *pixels,        //image memory
+                    inT32 x,              //x size required
+                    inT32 y,              //ysize required
+                    inT8 bits_per_pixel,  //bpp required
+                    inT32 bytes_per_line, //0 for packed lines
+                    BOOL8 bottom_up       //first line is bottom
                    ) {
   destroy();
   xdim = check_legal_image_size (x, y, bits_per_pixel);
   if (xdim < 0)
     return -1;
+  if (bytes_per_line != 0) {
+    if (bytes_per_line < xdim) {
+      BADIMAGESIZE.error ("IMAGE::capture", TESSLOG,
+        "Only %d bytes per line for (%d,%d)", bytes_per_line, x, y);
+      return -1;
+    }
+    xdim = bytes_per_line;
+  }
+  if (bottom_up) {
+                                 //top line is last
+    pixels += (y - 1) * xdim;
+    xdim = -xdim;                //and lines go back
+  }
   xsize = x;
   ysize = y;
   bufheight = y;
@@ -259,6 +344,329 @@ inT32 check_legal_image_size(                     //get rest of image
 }
 
 
+#define CONVERT_CHUNK 64         //pixels per step of 2 stage converts
+
+static uinT8 reversed_bytes[256];//bits of byte in reverse order
+static BOOL8 convert_tables_done = FALSE;
+#ifdef IMG_SSSE3
+static BOOL8 have_ssse3 = FALSE;  //set when the CPU is checked
+#endif
+
+/**********************************************************************
+ * make_convert_tables
+ *
+ * Fill in the tables used by the direct bpp conversions.
+ **********************************************************************/
+
+static void make_convert_tables() {  //set up conversions
+  int byte;                      //byte to reverse
+  int bit;                       //bit of byte
+
+  for (byte = 0; byte < 256; byte++) {
+    reversed_bytes[byte] = 0;
+    for (bit = 0; bit < 8; bit++)
+      if (byte & (1 << bit))
+        reversed_bytes[byte] |= 0x80 >> bit;
+  }
+#ifdef IMG_SSSE3
+  __builtin_cpu_init ();
+  have_ssse3 = __builtin_cpu_supports ("ssse3") ? TRUE : FALSE;
+#endif
+  convert_tables_done = TRUE;
+}
+
+
+/**********************************************************************
+ * expand_bits
+ *
+ * Expand count pixels of a 1 bpp line, from pixel bit of src onwards,
+ * to a byte each of 0 or white.
+ **********************************************************************/
+
+static void expand_bits(                  //1 bpp to bytes
+                        const uinT8 *src, //packed line
+                        inT32 bit,        //first pixel
+                        uinT8 *dest,      //byte per pixel
+                        inT32 count,      //no of pixels
+                        uinT8 white       //value of 1 bits
+                       ) {
+  const uinT8 *bits;             //unpacked byte
+  inT32 index;                   //pixel of byte
+
+  src += bit / 8;
+  bit %= 8;
+  for (; bit != 0 && count > 0; count--) {
+    *dest++ = (*src >> (7 - bit)) & 1 ? white : 0;
+    if (++bit == 8) {
+      bit = 0;                   //now on a byte
+      src++;
+    }
+  }
+#ifdef IMG_SSE2
+  __m128i masks = _mm_set_epi8 (1, 2, 4, 8, 16, 32, 64, (char) 128,
+    1, 2, 4, 8, 16, 32, 64, (char) 128);
+  __m128i whites = _mm_set1_epi8 ((char) white);
+  __m128i pixels;                //2 bytes spread to 16
+  for (; count >= 16; count -= 16, src += 2, dest += 16) {
+    pixels = _mm_cvtsi32_si128 (src[0] | src[1] << 8);
+    pixels = _mm_unpacklo_epi8 (pixels, pixels);
+    pixels = _mm_unpacklo_epi16 (pixels, pixels);
+    pixels = _mm_unpacklo_epi32 (pixels, pixels);
+    pixels = _mm_cmpeq_epi8 (_mm_and_si128 (pixels, masks), masks);
+    _mm_storeu_si128 ((__m128i *) dest, _mm_and_si128 (pixels, whites));
+  }
+#endif
+  for (; count > 0; count -= 8) {
+    bits = bpp1table[*src++];
+    for (index = 0; index < 8 && index < count; index++)
+      *dest++ = bits[index] ? white : 0;
+  }
+}
+
+
+/**********************************************************************
+ * pack_bits
+ *
+ * Pack count bytes into a 1 bpp line from pixel bit of dest onwards,
+ * taking the top or bottom bit of each byte. Pixels of dest outside
+ * the range are kept.
+ **********************************************************************/
+
+static void pack_bits(                  //bytes to 1 bpp
+                      const uinT8 *src, //byte per pixel
+                      uinT8 *dest,      //packed line
+                      inT32 bit,        //first pixel
+                      inT32 count,      //no of pixels
+                      BOOL8 top_bit     //use top bit of bytes
+                     ) {
+  uinT8 byte;                    //packed pixels
+  uinT8 mask;                    //bit of pixel
+  inT8 shift;                    //to bottom bit
+
+  shift = top_bit ? 7 : 0;
+  dest += bit / 8;
+  bit %= 8;
+  for (; bit != 0 && count > 0; count--) {
+    mask = 0x80 >> bit;
+    if ((*src++ >> shift) & 1)
+      *dest |= mask;
+    else
+      *dest &= ~mask;
+    if (++bit == 8) {
+      bit = 0;                   //now on a byte
+      dest++;
+    }
+  }
+#ifdef IMG_SSE2
+  __m128i pixels;                //16 bytes to pack
+  int topbits;                   //one per byte
+  for (; count >= 16; count -= 16, src += 16, dest += 2) {
+    pixels = _mm_loadu_si128 ((const __m128i *) src);
+    if (!top_bit)
+      pixels = _mm_slli_epi16 (pixels, 7);
+    topbits = _mm_movemask_epi8 (pixels);
+    dest[0] = reversed_bytes[topbits & 0xff];
+    dest[1] = reversed_bytes[topbits >> 8];
+  }
+#endif
+  for (; count >= 8; count -= 8) {
+    for (byte = 0, bit = 0; bit < 8; bit++)
+      byte = (byte << 1) | ((*src++ >> shift) & 1);
+    *dest++ = byte;
+  }
+  for (bit = 0; bit < count; bit++) {
+    mask = 0x80 >> bit;
+    if ((*src++ >> shift) & 1)
+      *dest |= mask;
+    else
+      *dest &= ~mask;
+  }
+}
+
+
+#ifdef IMG_SSSE3
+/**********************************************************************
+ * take_green_ssse3
+ *
+ * SSSE3 kernel of take_green. Does whole groups of 16 pixels and
+ * returns the number done.
+ **********************************************************************/
+
+SIMD_TARGET("ssse3")
+static inT32 take_green_ssse3(                  //24 bpp to 8
+                              const uinT8 *src, //RGB pixels
+                              uinT8 *dest,      //byte per pixel
+                              inT32 count       //no of pixels
+                             ) {
+  __m128i from0 = _mm_setr_epi8 (1, 4, 7, 10, 13, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1);
+  __m128i from1 = _mm_setr_epi8 (-1, -1, -1, -1, -1, 0, 3, 6,
+    9, 12, 15, -1, -1, -1, -1, -1);
+  __m128i from2 = _mm_setr_epi8 (-1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, 2, 5, 8, 11, 14);
+  __m128i greens;                //16 green bytes
+  inT32 done;                    //pixels done
+
+  for (done = 0; done + 16 <= count; done += 16, src += 48, dest += 16) {
+    greens = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) src),
+      from0);
+    greens = _mm_or_si128 (greens,
+      _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (src + 16)),
+      from1));
+    greens = _mm_or_si128 (greens,
+      _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (src + 32)),
+      from2));
+    _mm_storeu_si128 ((__m128i *) dest, greens);
+  }
+  return done;
+}
+
+
+/**********************************************************************
+ * spread_grey_ssse3
+ *
+ * SSSE3 kernel of spread_grey. Does whole groups of 16 pixels and
+ * returns the number done.
+ **********************************************************************/
+
+SIMD_TARGET("ssse3")
+static inT32 spread_grey_ssse3(                  //8 bpp to 24
+                               const uinT8 *src, //byte per pixel
+                               uinT8 *dest,      //RGB pixels
+                               inT32 count       //no of pixels
+                              ) {
+  __m128i to0 = _mm_setr_epi8 (0, 0, 0, 1, 1, 1, 2, 2,
+    2, 3, 3, 3, 4, 4, 4, 5);
+  __m128i to1 = _mm_setr_epi8 (5, 5, 6, 6, 6, 7, 7, 7,
+    8, 8, 8, 9, 9, 9, 10, 10);
+  __m128i to2 = _mm_setr_epi8 (10, 11, 11, 11, 12, 12, 12, 13,
+    13, 13, 14, 14, 14, 15, 15, 15);
+  __m128i greys;                 //16 grey bytes
+  inT32 done;                    //pixels done
+
+  for (done = 0; done + 16 <= count; done += 16, src += 16, dest += 48) {
+    greys = _mm_loadu_si128 ((const __m128i *) src);
+    _mm_storeu_si128 ((__m128i *) dest, _mm_shuffle_epi8 (greys, to0));
+    _mm_storeu_si128 ((__m128i *) (dest + 16),
+      _mm_shuffle_epi8 (greys, to1));
+    _mm_storeu_si128 ((__m128i *) (dest + 32),
+      _mm_shuffle_epi8 (greys, to2));
+  }
+  return done;
+}
+#endif
+
+
+/**********************************************************************
+ * take_green
+ *
+ * Take the green byte of count 24 bpp pixels, as put_line does.
+ **********************************************************************/
+
+static void take_green(                  //24 bpp to 8
+                       const uinT8 *src, //RGB pixels
+                       uinT8 *dest,      //byte per pixel
+                       inT32 count       //no of pixels
+                      ) {
+#ifdef IMG_SSSE3
+  inT32 done;                    //pixels done by kernel
+
+  if (have_ssse3) {
+    done = take_green_ssse3 (src, dest, count);
+    src += done * 3;
+    dest += done;
+    count -= done;
+  }
+#endif
+  for (src++; count > 0; count--, src += 3)
+    *dest++ = *src;
+}
+
+
+/**********************************************************************
+ * spread_grey
+ *
+ * Copy each of count bytes to all 3 bytes of a 24 bpp pixel.
+ **********************************************************************/
+
+static void spread_grey(                  //8 bpp to 24
+                        const uinT8 *src, //byte per pixel
+                        uinT8 *dest,      //RGB pixels
+                        inT32 count       //no of pixels
+                       ) {
+#ifdef IMG_SSSE3
+  inT32 done;                    //pixels done by kernel
+
+  if (have_ssse3) {
+    done = spread_grey_ssse3 (src, dest, count);
+    src += done;
+    dest += done * 3;
+    count -= done;
+  }
+#endif
+  for (; count > 0; count--) {
+    *dest++ = *src;
+    *dest++ = *src;
+    *dest++ = *src++;
+  }
+}
+
+
+/**********************************************************************
+ * convert_line
+ *
+ * Convert xext pixels of a line between 1, 8 and 24 bpp straight from
+ * the source buffer to the destination buffer, giving the same pixels
+ * as the get_line/put_line path of copy_sub_image. Returns FALSE, doing
+ * nothing, for any other pair of bpps.
+ **********************************************************************/
+
+static BOOL8 convert_line(                     //convert bpp directly
+                          const uinT8 *srcline,//start of source line
+                          inT8 srcbpp,         //source bpp
+                          inT32 xstart,        //first source pixel
+                          uinT8 *destline,     //start of dest line
+                          inT8 destbpp,        //dest bpp
+                          inT32 xdest,         //first dest pixel
+                          inT32 xext,          //no of pixels
+                          BOOL8 adjust_grey    //shift to new bpp
+                         ) {
+  uinT8 chunk[CONVERT_CHUNK];    //for 2 stage converts
+  inT32 done;                    //pixels converted
+  inT32 count;                   //pixels in chunk
+
+  if (!convert_tables_done)
+    make_convert_tables();
+  if (srcbpp == 1 && destbpp == 8)
+    expand_bits (srcline, xstart, destline + xdest, xext,
+      adjust_grey ? 0xff : 1);
+  else if (srcbpp == 8 && destbpp == 1)
+    pack_bits (srcline + xstart, destline, xdest, xext, adjust_grey);
+  else if (srcbpp == 24 && destbpp == 8)
+    take_green (srcline + xstart * 3, destline + xdest, xext);
+  else if (srcbpp == 8 && destbpp == 24)
+    spread_grey (srcline + xstart, destline + xdest * 3, xext);
+  else if (srcbpp == 1 && destbpp == 24) {
+    for (done = 0; done < xext; done += count) {
+      count = xext - done < CONVERT_CHUNK ? xext - done : CONVERT_CHUNK;
+      expand_bits (srcline, xstart + done, chunk, count,
+        adjust_grey ? 0xff : 1);
+      spread_grey (chunk, destline + (xdest + done) * 3, count);
+    }
+  }
+  else if (srcbpp == 24 && destbpp == 1) {
+    for (done = 0; done < xext; done += count) {
+      count = xext - done < CONVERT_CHUNK ? xext - done : CONVERT_CHUNK;
+      take_green (srcline + (xstart + done) * 3, chunk, count);
+      pack_bits (chunk, destline, xdest + done, count, adjust_grey);
+    }
+  }
+  else
+    return FALSE;
+  return TRUE;
+}
+
+
 /**********************************************************************
  * copy_sub_image
  *
@@ -287,6 +695,7 @@ DLLSYM void copy_sub_image(                   //copy rectangle
   inT32 bytesize;                //no of bytes to copy
   inT32 srcppb;                  //pixels per byte
   BOOL8 aligned;
+  BOOL8 convert;                 //try convert_line
 
   if (xstart < 0 || ystart < 0 || xdest < 0 || ydest < 0)
     return;
@@ -321,6 +730,7 @@ DLLSYM void copy_sub_image(                   //copy rectangle
       && xdest % srcppb == 0
       && (xext % srcppb == 0 || xdest + xext == dest->xsize);
   }
+  convert = image_fast_convert && source->bpp != dest->bpp;
   for (y = 0; y < yext; y++) {
     if (ystart >= ydest)
       yoffset = y;               //top down
@@ -338,6 +748,14 @@ DLLSYM void copy_sub_image(                   //copy rectangle
                                  //do cheap move
         memmove (dest->image + (dest->ymax - 1 - ydest - yoffset) * dest->xdim + xdest / srcppb, source->image + (source->ymax - 1 - ystart - yoffset) * source->xdim + xstart / srcppb, (unsigned) bytesize);
     }
+    else if (convert
+      && convert_line (source->image
+      + (source->ymax - 1 - ystart - yoffset) * source->xdim,
+      source->bpp, xstart,
+      dest->image + (dest->ymax - 1 - ydest - yoffset) * dest->xdim,
+      dest->bpp, xdest, xext, adjust_grey)) {
+                                 //done straight on the buffers
+    }
     else {
       if (shift == 0) {
         source->fast_get_line (xstart, ystart + yoffset, xext,
@@ -1032,7 +1450,7 @@ void IMAGE::get_line(                     //get image line
   }
   if (width > 0) {
     if (bpp > 4) {
-      src += x;                  //offset
+      src += x * bytespp;        //offset
                                  //easy way
       memmove (dest, src, (unsigned) width);
     }
@@ -1256,7 +1674,6 @@ void IMAGE::put_line(                     //put image line
     memmove (dest, src - 1, (unsigned) width);
   }
   else if (bpp == 24) {
-    src--;
     dest += x * bytespp;
     while (width > 0) {
       pixel = *src++;
@@ -1411,8 +1828,7 @@ void IMAGE::put_column(                     //put image column
     }
   }
   else if (bpp == 24) {
-    src--;
-    dest += x * bytesperpix;
+    dest += x * bytespp;
     for (; height > 0; --height) {
       pixel = *src++;
       *dest = pixel;
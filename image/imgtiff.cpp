@@ -20,9 +20,16 @@
 #include          "mfcpch.h"     //precompiled headers
 #ifdef __MSW32__
 #include          <io.h>
+#include          <process.h>
 #else
 #include          <unistd.h>
 #endif
+#include          <fcntl.h>
+#include          <sys/types.h>
+#include          <sys/stat.h>
+#include          <stdio.h>
+#include          <stdlib.h>
+#include          <string.h>
 
 /*
 ** Include automatically generated configuration file if running autoconf
@@ -40,7 +47,9 @@
 #include          "bitstrm.h"
 #include          "tprintf.h"
 #include          "serialis.h"
+#include          "memry.h"
 #include          "imgtiff.h"
+#include          "varable.h"
 
 #define INTEL       0x4949
 #define MOTO        0x4d4d
@@ -81,6 +90,16 @@ typedef struct
   inT32 value;
 } TIFFENTRY;                     //tiff tag entry
 
+typedef struct
+{
+  uinT32 magic;                  //TIF_INDEX_MAGIC
+  uinT32 file_size;              //version of tif file
+  uinT32 file_time;              //mtime seconds
+  uinT32 file_time_ns;           //and nanoseconds if known
+  uinT32 file_inode;             //changed by rename over it
+  uinT32 pages;                  //no of offsets after header
+} TIF_INDEX_HEADER;              //start of page index file
+
 typedef struct myrational
 {
   inT32 top;
@@ -173,52 +192,239 @@ static uinT8 long_black_lengths[LONG_CODE_SIZE] = {
   12, 12, 12, 12, 12, 12, 12, 12
 };
 
+#define PACKBITS      32773      //tif compression codes
+#define CCITT_G3      3
+#define CCITT_G4      4
+#define G4_LOOKUP_BITS    13     //longest run code
+#define TIF_INDEX_EXT     ".pages"  //page index file
+#define TIF_INDEX_MAGIC   0x32646974  //"tid2"
+
+typedef struct
+{
+  inT16 run;                     //run length or -1
+  uinT8 length;                  //bits in code
+} RUNCODE;                       //G4 run code lookup entry
+
+//msb first run codes, indexed by the next G4_LOOKUP_BITS bits
+static RUNCODE white_runs[1 << G4_LOOKUP_BITS];
+static RUNCODE black_runs[1 << G4_LOOKUP_BITS];
+static uinT8 reversed_bits[256]; //for lsb first fill order
+
+BOOL_VAR (image_tif_page_index, FALSE,
+"Write a .pages index beside multi-page tif files");
+
 /**********************************************************************
- * open_tif_image
+ * add_run_code
  *
- * Read the header of a tif format image and prepare to read the rest.
+ * Enter a run code, given lsb first as in the tables above, into a
+ * msb first lookup table.
  **********************************************************************/
 
-inT8 open_tif_image(               //read header
-                    int fd,        //file to read
-                    inT32 *xsize,  //size of image
-                    inT32 *ysize,
-                    inT8 *bpp,     //bits per pixel
-                    inT8 *photo,   //interpretation
-                    inT32 *res     //resolution
-                   ) {
-  inT16 filetype;
+static void add_run_code(                  //enter code
+                         RUNCODE *table,   //table to fill
+                         uinT16 code,      //lsb first code
+                         uinT8 length,     //bits in code
+                         inT16 run         //run length of code
+                        ) {
+  inT32 msbcode;                 //code msb first
+  inT32 bit;                     //bit of code
+  inT32 index;                   //table index
+
+  msbcode = 0;
+  for (bit = 0; bit < length; bit++)
+    msbcode = (msbcode << 1) | ((code >> bit) & 1);
+  msbcode <<= G4_LOOKUP_BITS - length;
+  for (index = 0; index < 1 << (G4_LOOKUP_BITS - length); index++) {
+    table[msbcode + index].run = run;
+    table[msbcode + index].length = length;
+  }
+}
+
+
+/**********************************************************************
+ * build_run_tables
+ *
+ * Make the G4 lookup tables from the run codes. Called once at startup.
+ **********************************************************************/
+
+static BOOL8 build_run_tables() {
+  inT32 index;                   //table index
+  inT32 bit;                     //bit of byte
+
+  for (index = 0; index < 1 << G4_LOOKUP_BITS; index++) {
+    white_runs[index].run = -1;
+    black_runs[index].run = -1;
+  }
+  for (index = 0; index < SHORT_CODE_SIZE; index++) {
+    add_run_code (white_runs, short_white_codes[index],
+      short_white_lengths[index], index);
+    add_run_code (black_runs, short_black_codes[index],
+      short_black_lengths[index], index);
+  }
+  for (index = 0; index < LONG_CODE_SIZE; index++) {
+    add_run_code (white_runs, long_white_codes[index],
+      long_white_lengths[index], (index + 1) * SHORT_CODE_SIZE);
+    add_run_code (black_runs, long_black_codes[index],
+      long_black_lengths[index], (index + 1) * SHORT_CODE_SIZE);
+  }
+  for (index = 0; index < 256; index++) {
+    reversed_bits[index] = 0;
+    for (bit = 0; bit < 8; bit++)
+      if (index & (1 << bit))
+        reversed_bits[index] |= 0x80 >> bit;
+  }
+  return TRUE;
+}
+
+static BOOL8 run_tables_built = build_run_tables ();
+
+/**********************************************************************
+ * file_value
+ *
+ * Get a 16 or 32 bit value stored in the byte order of the file.
+ **********************************************************************/
+
+static uinT32 file_value(                   //get value
+                         const uinT8 *bytes,//first byte
+                         inT32 size,        //2 or 4 bytes
+                         inT16 filetype     //INTEL or MOTO
+                        ) {
+  uinT32 value;                  //result
+  inT32 index;                   //byte index
+
+  value = 0;
+  for (index = 0; index < size; index++) {
+    if (filetype == INTEL)
+      value |= (uinT32) bytes[index] << (index * 8);
+    else
+      value = (value << 8) | bytes[index];
+  }
+  return value;
+}
+
+
+/**********************************************************************
+ * set_black_bits
+ *
+ * Set the bits of a packed line from x=from to x=to-1.
+ **********************************************************************/
+
+static void set_black_bits(              //fill run
+                           uinT8 *line,  //line to fill
+                           inT32 from,   //first pixel
+                           inT32 to      //last pixel+1
+                          ) {
+  inT32 first;                   //first byte
+  inT32 last;                    //last byte
+  uinT8 lead;                    //mask of first byte
+  uinT8 trail;                   //mask of last byte
+
+  if (from >= to)
+    return;
+  first = from >> 3;
+  last = (to - 1) >> 3;
+  lead = 0xff >> (from & 7);
+  trail = (uinT8) (0xff << (7 - ((to - 1) & 7)));
+  if (first == last)
+    line[first] |= lead & trail;
+  else {
+    line[first] |= lead;
+    memset (line + first + 1, 0xff, last - first - 1);
+    line[last] |= trail;
+  }
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::TIF_STREAM
+ *
+ * Constructor for an empty stream.
+ **********************************************************************/
+
+TIF_STREAM::TIF_STREAM() {
+  fd = -1;
+  directory = 0;
+  xsize = ysize = -1;
+  bpp = -1;
+  photo = -1;
+  res = -1;
+  compression = 1;
+  fillorder = 1;
+  rows_per_strip = 0;
+  strip_count = 0;
+  strip_offsets = NULL;
+  strip_sizes = NULL;
+  strip = -1;
+  ref_ends = NULL;
+  run_ends = NULL;
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::~TIF_STREAM
+ *
+ * Free the strip tables and run ends.
+ **********************************************************************/
+
+TIF_STREAM::~TIF_STREAM() {
+  if (strip_offsets != NULL)
+    free_mem(strip_offsets);
+  if (strip_sizes != NULL)
+    free_mem(strip_sizes);
+  if (ref_ends != NULL)
+    free_mem(ref_ends);
+  if (run_ends != NULL)
+    free_mem(run_ends);
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::read_header
+ *
+ * Read the tag table at the given offset, or of the first image in the
+ * file, including the position and size of every strip.
+ * Returns -1 on failure.
+ **********************************************************************/
+
+inT8 TIF_STREAM::read_header(                  //read tag table
+                             int file,         //file to read
+                             uinT32 tag_table  //offset or 0 for first
+                            ) {
   inT32 start;                   //start of tiff directory
   inT16 entries;                 //no of tiff entries
-  inT32 imagestart;              //location of image in file
+  inT16 entry;                   //current entry
   inT32 resoffset;               //location of res
   TIFFENTRY tiffentry;           //tag table entry
-  BOOL8 compressed;              //compression control
+  uinT32 rawvalue;               //value field as in file
   MYRATIONAL resinfo;            //resolution
-  BOOL8 strips = false;          //if in strips
+  BOOL8 sizes_read;              //had strip sizes
+  inT32 index;                   //strip index
 
-  *xsize = -1;                   //illegal values
-  *ysize = -1;
-  *bpp = -1;
-  *res = -1;
+  fd = file;
   resoffset = -1;
+  sizes_read = FALSE;
+  lseek (fd, 0L, 0);
   if (read (fd, (char *) &filetype, sizeof filetype) != sizeof filetype
   || (filetype != INTEL && filetype != MOTO)) {
     BADIMAGEFORMAT.error ("read_tif_image", TESSLOG, "Filetype");
     return -1;
   }
-  lseek (fd, 4L, 0);
-  if (read (fd, (char *) &start, sizeof start) != sizeof start) {
-    READFAILED.error ("read_tif_image", TESSLOG, "Start of tag table");
-    return -1;
+  if (tag_table != 0)
+    start = tag_table;
+  else {
+    lseek (fd, 4L, 0);
+    if (read (fd, (char *) &start, sizeof start) != sizeof start) {
+      READFAILED.error ("read_tif_image", TESSLOG, "Start of tag table");
+      return -1;
+    }
+    if (filetype != __NATIVE__)
+      start = reverse32 (start);
   }
-
-  if (filetype != __NATIVE__)
-    start = reverse32 (start);
   if (start <= 0) {
     BADIMAGEFORMAT.error ("read_tif_image", TESSLOG, "Start of tag table");
     return -1;
   }
+  directory = start;
   lseek (fd, start, 0);
   if (read (fd, (char *) &entries, sizeof (inT16)) != sizeof (inT16)) {
     BADIMAGEFORMAT.error ("read_tif_image", TESSLOG, "Size of tag table");
@@ -226,15 +432,15 @@ inT8 open_tif_image(               //read header
   }
   if (filetype != __NATIVE__)
     entries = reverse16 (entries);
-  //      printf("No of tiff directory entries=%d\n",entries);
-  imagestart = 0;
-  compressed = FALSE;
-  for (; entries-- > 0;) {
+  for (entry = 0; entry < entries; entry++) {
+                                 //arrays move the file
+    lseek (fd, start + sizeof (inT16) + entry * sizeof (TIFFENTRY), 0);
     if (read (fd, (char *) &tiffentry, sizeof tiffentry) !=
     sizeof tiffentry) {
       BADIMAGEFORMAT.error ("read_tif_image", TESSLOG, "Tag table entry");
       return -1;
     }
+    rawvalue = tiffentry.value;
     if (filetype != __NATIVE__) {
       tiffentry.type = reverse16 (tiffentry.type);
       tiffentry.tag = reverse16 (tiffentry.tag);
@@ -261,30 +467,51 @@ inT8 open_tif_image(               //read header
       tiffentry.value &= 0x0000ffff;
     }
 
-    //              printf("Tag=%x, Type=%x, Length=%x, value=%x\n",
-    //                      tiffentry.tag,tiffentry.type,tiffentry.length,tiffentry.value);
     switch (tiffentry.tag) {
       case 0x101:
-        *ysize = tiffentry.value;
+        ysize = tiffentry.value;
         break;
       case 0x100:
-        *xsize = tiffentry.value;
+        xsize = tiffentry.value;
         break;
       case 0x102:
         if (tiffentry.length == 1)
-          *bpp = (inT8) tiffentry.value;
+          bpp = (inT8) tiffentry.value;
         else
-          *bpp = 24;
+          bpp = 24;
         break;
       case 0x111:
-        imagestart = tiffentry.value;
-        strips = tiffentry.length > 1;
+        if (strip_offsets != NULL || tiffentry.length == 0) {
+          BADIMAGEFORMAT.error ("read_tif_image", TESSLOG, "Strip offset");
+          return -1;
+        }
+        strip_count = tiffentry.length;
+        strip_offsets = (uinT32 *) alloc_mem (strip_count * sizeof (uinT32));
+        strip_sizes = (uinT32 *) alloc_mem (strip_count * sizeof (uinT32));
+        if (read_values (tiffentry.type, tiffentry.length, rawvalue,
+          strip_offsets) < 0)
+          return -1;
         break;
-      case 0x103:
-        if (tiffentry.value == 3) {
-          compressed = TRUE;
+      case 0x117:
+        if (strip_sizes == NULL || tiffentry.length != (uinT32) strip_count) {
+          BADIMAGEFORMAT.error ("read_tif_image", TESSLOG, "Strip size");
+          return -1;
         }
-        else if (tiffentry.value != 1) {
+        if (read_values (tiffentry.type, tiffentry.length, rawvalue,
+          strip_sizes) < 0)
+          return -1;
+        sizes_read = TRUE;
+        break;
+      case 0x116:
+        rows_per_strip = tiffentry.value;
+        break;
+      case 0x10a:
+        fillorder = tiffentry.value;
+        break;
+      case 0x103:
+        compression = (uinT16) tiffentry.value;
+        if (compression != 1 && compression != CCITT_G3
+        && compression != CCITT_G4 && compression != PACKBITS) {
           BADIMAGEFORMAT.error ("read_tif_image", TESSLOG, "Compression");
           return -1;
         }
@@ -295,16 +522,25 @@ inT8 open_tif_image(               //read header
         resoffset = tiffentry.value;
         break;
       case 0x106:
-        *photo = (inT8) tiffentry.value;
+        photo = (inT8) tiffentry.value;
         break;
     }                            //endswitch
   }
-  if (*xsize <= 0 || *ysize <= 0 || *bpp > 24 || imagestart <= 0) {
+  if (xsize <= 0 || ysize <= 0 || bpp > 24 || strip_count == 0
+  || strip_offsets[0] == 0) {
     BADIMAGEFORMAT.error ("read_tif_image", TESSLOG, "Vital tag");
     return -1;
   }
-  tprintf ("Image has %d bit%c per pixel and size (%d,%d)\n",
-    *bpp, *bpp == 1 ? ' ' : 's', *xsize, *ysize);
+  if (rows_per_strip <= 0 || rows_per_strip > ysize)
+    rows_per_strip = ysize;
+  if (!sizes_read) {
+    for (index = 0; index < strip_count; index++) {
+      if (compression == 1)
+        strip_sizes[index] = rows_per_strip * COMPUTE_IMAGE_XDIM (xsize, bpp);
+      else
+        strip_sizes[index] = ~0;  //read to end of file
+    }
+  }
   if (resoffset >= 0) {
     lseek (fd, resoffset, 0);
     if (read (fd, (char *) &resinfo, sizeof (resinfo)) != sizeof (resinfo)) {
@@ -315,29 +551,797 @@ inT8 open_tif_image(               //read header
       resinfo.top = reverse32 (resinfo.top);
       resinfo.bottom = reverse32 (resinfo.bottom);
     }
-    *res = resinfo.top / resinfo.bottom;
-    tprintf ("Resolution=%d\n", *res);
+    res = resinfo.top / resinfo.bottom;
+  }
+  return 0;
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::read_values
+ *
+ * Read the short or long values of an array tag, which are in the value
+ * field itself if they fit, else at the offset it holds.
+ **********************************************************************/
+
+inT8 TIF_STREAM::read_values(                 //read tag array
+                             uinT16 type,     //tag type
+                             uinT32 length,   //no of values
+                             uinT32 value,    //value field as in file
+                             uinT32 *values   //output array
+                            ) {
+  inT32 size;                    //bytes per value
+  uinT8 *bytes;                  //values as in file
+  uinT32 index;                  //value index
+
+  if (type != 3 && type != 4) {
+    BADIMAGEFORMAT.error ("read_tif_image", TESSLOG, "Strip tag type");
+    return -1;
+  }
+  size = type == 3 ? 2 : 4;
+  if (size * length <= sizeof (value)) {
+    bytes = (uinT8 *) &value;
+    for (index = 0; index < length; index++)
+      values[index] = file_value (bytes + index * size, size, filetype);
+    return 0;
+  }
+  bytes = (uinT8 *) alloc_mem (size * length);
+  lseek (fd, file_value ((uinT8 *) &value, 4, filetype), 0);
+  if (read (fd, (char *) bytes, size * length) != (inT32) (size * length)) {
+    READFAILED.error ("read_tif_image", TESSLOG, "Strip table");
+    free_mem(bytes);
+    return -1;
+  }
+  for (index = 0; index < length; index++)
+    values[index] = file_value (bytes + index * size, size, filetype);
+  free_mem(bytes);
+  return 0;
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::contiguous
+ *
+ * True if the image is uncompressed and its strips follow each other
+ * in the file, so it can be read as one block.
+ **********************************************************************/
+
+BOOL8 TIF_STREAM::contiguous() {
+  inT32 index;                   //strip index
+  inT32 strip_bytes;             //bytes in a full strip
+
+  if (compression != 1)
+    return FALSE;
+  strip_bytes = rows_per_strip * COMPUTE_IMAGE_XDIM (xsize, bpp);
+  for (index = 1; index < strip_count; index++)
+    if (strip_offsets[index] != strip_offsets[index - 1] + strip_bytes)
+      return FALSE;
+  return TRUE;
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::start_strip
+ *
+ * Move on to the next strip and reset the decoder.
+ **********************************************************************/
+
+inT8 TIF_STREAM::start_strip() {
+  strip++;
+  if (strip >= strip_count) {
+    BADIMAGEFORMAT.error ("read_tif_image", TESSLOG, "Too few strips");
+    return -1;
+  }
+  lseek (fd, strip_offsets[strip], 0);
+  strip_left = strip_sizes[strip];
+  strip_row = 0;
+  bufindex = bufsize = 0;
+  bitword = 0;
+  bitcount = 0;
+  ended = FALSE;
+  if (compression == CCITT_G4) {
+    if (ref_ends == NULL) {
+      ref_ends = (inT32 *) alloc_mem ((xsize + 6) * sizeof (inT32));
+      run_ends = (inT32 *) alloc_mem ((xsize + 6) * sizeof (inT32));
+    }
+                                 //all white above strip
+    ref_ends[0] = ref_ends[1] = ref_ends[2] = xsize;
+  }
+  return 0;
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::next_byte
+ *
+ * Get the next byte of the current strip, or -1 at the end of it.
+ **********************************************************************/
+
+inT32 TIF_STREAM::next_byte() {
+  if (bufindex >= bufsize) {
+    if (strip_left == 0)
+      return -1;
+    bufsize = read (fd, (char *) buffer,
+      strip_left < BITBUFSIZE ? strip_left : BITBUFSIZE);
+    bufindex = 0;
+    if (bufsize <= 0) {
+      bufsize = 0;               //end of file
+      strip_left = 0;
+      return -1;
+    }
+    strip_left -= bufsize;
+  }
+  return buffer[bufindex++];
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::read_bytes
+ *
+ * Copy bytes of the current strip. Returns the number copied.
+ **********************************************************************/
+
+inT32 TIF_STREAM::read_bytes(              //copy bytes
+                             uinT8 *dest,  //where to put them
+                             inT32 count   //no wanted
+                            ) {
+  inT32 done;                    //bytes copied
+  inT32 chunk;                   //bytes from buffer
+  inT32 byte;                    //refill byte
+
+  for (done = 0; done < count; done += chunk) {
+    if (bufindex >= bufsize) {
+      byte = next_byte ();       //refill buffer
+      if (byte < 0)
+        break;
+      dest[done] = (uinT8) byte;
+      chunk = 1;
+      continue;
+    }
+    chunk = bufsize - bufindex;
+    if (chunk > count - done)
+      chunk = count - done;
+    memcpy (dest + done, buffer + bufindex, chunk);
+    bufindex += chunk;
+  }
+  return done;
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::peek_bits
+ *
+ * Look at the next count (<=24) bits of a G4 strip. The end of the
+ * strip reads as zeros, which are not a valid code.
+ **********************************************************************/
+
+uinT32 TIF_STREAM::peek_bits(              //look at bits
+                             inT32 count   //no of bits
+                            ) {
+  inT32 byte;                    //next byte
+
+  while (bitcount < count) {
+    byte = next_byte ();
+    if (byte < 0)
+      byte = 0;
+    else if (fillorder == 2)
+      byte = reversed_bits[byte];
+    bitword |= (uinT32) byte << (24 - bitcount);
+    bitcount += 8;
   }
-  lseek (fd, (long) imagestart, 0);
-  if (strips) {
-    if (read (fd, (char *) &imagestart, sizeof (imagestart)) !=
-    sizeof (imagestart)) {
-      READFAILED.error ("read_tif_image", TESSLOG, "Strip offset");
+  return bitword >> (32 - count);
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::read_run
+ *
+ * Read a run length, with any makeup codes, of the given colour.
+ * Returns -1 on a bad code.
+ **********************************************************************/
+
+inT32 TIF_STREAM::read_run(              //read run length
+                           BOOL8 black   //colour of run
+                          ) {
+  inT32 run;                     //total length
+  RUNCODE code;                  //current code
+
+  run = 0;
+  do {
+    code = (black ? black_runs : white_runs)[peek_bits (G4_LOOKUP_BITS)];
+    if (code.run < 0)
+      return -1;
+    skip_bits (code.length);
+    run += code.run;
+  }
+  while (code.run >= SHORT_CODE_SIZE);
+  return run;
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::read_packbits_line
+ *
+ * Decode one PackBits line. Returns -1 if the strip runs out.
+ **********************************************************************/
+
+inT8 TIF_STREAM::read_packbits_line(             //decode line
+                                    uinT8 *line  //line to fill
+                                   ) {
+  inT32 bytes;                   //bytes in line
+  inT32 done;                    //bytes decoded
+  inT32 code;                    //packbits code
+  inT32 count;                   //bytes in run
+  inT32 byte;                    //repeated byte
+  uinT8 spare[128];              //bytes past end of line
+
+  bytes = COMPUTE_IMAGE_XDIM (xsize, bpp);
+  for (done = 0; done < bytes;) {
+    code = next_byte ();
+    if (code < 0)
       return -1;
+    if (code < 128) {
+      count = code + 1;          //literal bytes
+      if (count > bytes - done) {
+        read_bytes (spare, count - (bytes - done));
+        count = bytes - done;
+      }
+      if (read_bytes (line + done, count) != count)
+        return -1;
+      done += count;
+    }
+    else if (code > 128) {
+      count = 257 - code;        //repeated byte
+      byte = next_byte ();
+      if (byte < 0)
+        return -1;
+      if (count > bytes - done)
+        count = bytes - done;
+      memset (line + done, byte, count);
+      done += count;
+    }
+  }
+  return 0;
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::read_g4_line
+ *
+ * Decode one CCITT G4 line against the run ends of the line above.
+ * run_ends holds the x of each colour change, the first being white to
+ * black, and is ended by xsize three times so the search for b1 and b2
+ * never runs off the end. A line has at most xsize+1 changes. Black is
+ * written as 1 bits, as in an uncompressed min-is-white line.
+ * Returns -1 on a bad code.
+ **********************************************************************/
+
+inT8 TIF_STREAM::read_g4_line(             //decode line
+                              uinT8 *line  //line to fill
+                             ) {
+  inT32 a0;                      //current position
+  inT32 a1;                      //next change
+  inT32 a2;                      //change after that
+  inT32 b1;                      //changes on line above
+  inT32 b2;
+  inT32 refindex;                //index of b1
+  inT32 count;                   //changes on this line
+  inT32 run;                     //horizontal run
+  uinT32 mode;                   //mode code
+  BOOL8 black;                   //colour at a0
+  inT32 *tmp;                    //for swapping lines
+  inT8 result;                   //return value
+
+  a0 = -1;                       //before start of line
+  black = FALSE;
+  count = 0;
+  refindex = 0;
+  result = 0;
+  while (a0 < xsize && count <= xsize) {
+    while (refindex > 0 && ref_ends[refindex - 1] > a0)
+      refindex--;
+    while (ref_ends[refindex] <= a0)
+      refindex++;
+    if ((refindex & 1) != black)
+      refindex++;                //b1 must change to !black
+    b1 = ref_ends[refindex];
+    b2 = ref_ends[refindex + 1];
+    mode = peek_bits (7);
+    if (mode & 0x40) {           //V0
+      skip_bits (1);
+      a1 = b1;
+    }
+    else if (mode & 0x20) {      //VR1, VL1
+      skip_bits (3);
+      a1 = mode & 0x10 ? b1 + 1 : b1 - 1;
+    }
+    else if (mode & 0x10) {      //horizontal
+      skip_bits (3);
+      if (a0 < 0)
+        a0 = 0;
+      run = read_run (black);
+      if (run < 0) {
+        result = -1;
+        break;
+      }
+      a1 = a0 + run;
+      run = read_run (!black);
+      if (run < 0) {
+        result = -1;
+        break;
+      }
+      a2 = a1 + run;
+      run_ends[count++] = a1 < xsize ? a1 : xsize;
+      run_ends[count++] = a2 < xsize ? a2 : xsize;
+      a0 = a2;
+      continue;
+    }
+    else if (mode & 0x08) {      //pass
+      skip_bits (4);
+      a0 = b2;
+      continue;
+    }
+    else if (mode & 0x04) {      //VR2, VL2
+      skip_bits (6);
+      a1 = mode & 0x02 ? b1 + 2 : b1 - 2;
     }
+    else if (mode & 0x02) {      //VR3, VL3
+      skip_bits (7);
+      a1 = mode & 0x01 ? b1 + 3 : b1 - 3;
+    }
+    else {
+                                 //EOFB or unsupported
+      if (a0 >= 0 || peek_bits (12) != 1)
+        result = -1;
+      ended = TRUE;
+      break;
+    }
+    if (a1 < a0 || a1 < 0) {
+      result = -1;               //change went backwards
+      break;
+    }
+    run_ends[count++] = a1 < xsize ? a1 : xsize;
+    a0 = a1;
+    black = !black;
+  }
+  if (count > xsize + 1)
+    result = -1;                 //too many changes
+  if (result < 0) {
+    ended = TRUE;                //rest of strip is white
+    count &= ~1;
+  }
+  if (ended && a0 < 0)
+    count = 0;
+  run_ends[count] = run_ends[count + 1] = run_ends[count + 2] = xsize;
+  memset (line, 0, COMPUTE_IMAGE_XDIM (xsize, bpp));
+  for (refindex = 0; refindex < count; refindex += 2)
+    set_black_bits (line, run_ends[refindex], run_ends[refindex + 1]);
+  tmp = ref_ends;                //this is now the line above
+  ref_ends = run_ends;
+  run_ends = tmp;
+  return result;
+}
+
+
+/**********************************************************************
+ * TIF_STREAM::read_lines
+ *
+ * Decode the next lines of the image, top first, moving through the
+ * strips as needed. A G4 strip that ends early or goes bad is reported
+ * and finished as white. Returns -1 if the file cannot be read.
+ **********************************************************************/
+
+inT8 TIF_STREAM::read_lines(                      //decode lines
+                            uinT8 *pixels,        //first line to fill
+                            inT32 bytes_per_line, //step between lines
+                            inT32 lines           //no to decode
+                           ) {
+  inT32 bytes;                   //bytes in line
+
+  bytes = COMPUTE_IMAGE_XDIM (xsize, bpp);
+  for (; lines > 0; lines--, pixels += bytes_per_line) {
+    if (strip < 0 || strip_row >= rows_per_strip) {
+      if (start_strip () < 0)
+        return -1;
+    }
+    strip_row++;
+    if (compression == CCITT_G4) {
+      if (ended)
+        memset (pixels, 0, bytes);
+      else if (read_g4_line (pixels) < 0)
+        tprintf ("Bad G4 code in strip %d, line %d\n", strip, strip_row);
+    }
+    else if (compression == PACKBITS) {
+      if (read_packbits_line (pixels) < 0) {
+        READFAILED.error ("read_tif_image", TESSLOG, "PackBits strip");
+        return -1;
+      }
+    }
+    else if (read_bytes (pixels, bytes) != bytes) {
+      READFAILED.error ("read_tif_image", TESSLOG, "Strip");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+/**********************************************************************
+ * open_tif_image
+ *
+ * Read the header of a tif format image and prepare to read the rest.
+ **********************************************************************/
+
+inT8 open_tif_image(               //read header
+                    int fd,        //file to read
+                    inT32 *xsize,  //size of image
+                    inT32 *ysize,
+                    inT8 *bpp,     //bits per pixel
+                    inT8 *photo,   //interpretation
+                    inT32 *res     //resolution
+                   ) {
+  return open_tif_directory (fd, 0, xsize, ysize, bpp, photo, res);
+}
+
+
+/**********************************************************************
+ * open_tif_directory
+ *
+ * Read the header of the image with its tag table at the given offset,
+ * or of the first image if it is 0, and prepare to read the rest.
+ * Returns 0 if the image can be read as one uncompressed block from the
+ * current file position, -2 if read_tif_image must decode it, in which
+ * case the file is left at the tag table.
+ **********************************************************************/
+
+inT8 open_tif_directory(                  //read header
+                        int fd,           //file to read
+                        uinT32 directory, //offset or 0 for first
+                        inT32 *xsize,     //size of image
+                        inT32 *ysize,
+                        inT8 *bpp,        //bits per pixel
+                        inT8 *photo,      //interpretation
+                        inT32 *res        //resolution
+                       ) {
+  TIF_STREAM header;             //tag table
+
+  *xsize = -1;                   //illegal values
+  *ysize = -1;
+  *bpp = -1;
+  *res = -1;
+  if (header.read_header (fd, directory) < 0)
+    return -1;
+  *xsize = header.get_xsize ();
+  *ysize = header.get_ysize ();
+  *bpp = header.get_bpp ();
+  *res = header.get_res ();
+  if (header.get_photo () >= 0)
+    *photo = header.get_photo ();
+  tprintf ("Image has %d bit%c per pixel and size (%d,%d)\n",
+    *bpp, *bpp == 1 ? ' ' : 's', *xsize, *ysize);
+  if (*res >= 0)
+    tprintf ("Resolution=%d\n", *res);
+  if (!header.contiguous ()) {
+    lseek (fd, (long) header.get_directory (), 0);
+    return -2;                   //needs decoding
+  }
+  lseek (fd, (long) header.get_image_start (), 0);
+  return 0;
+}
+
+
+/**********************************************************************
+ * read_tif_directories
+ *
+ * Follow the chain of tag tables through a tif file and return the
+ * offset of each one, ie of each page, in an array from alloc_mem.
+ * Returns NULL if the file cannot be read.
+ **********************************************************************/
+
+static uinT32 *read_tif_directories(                  //find pages
+                                    const char *name, //name of file
+                                    inT32 *count      //no of pages
+                                   ) {
+  int fd;                        //tif file
+  struct stat info;              //size of file
+  inT16 filetype;                //INTEL or MOTO
+  uinT32 offset;                 //current tag table
+  uinT16 entries;                //entries in table
+  uinT32 *offsets;               //result
+  uinT32 *bigger;                //grown result
+  inT32 size;                    //space in offsets
+
+  *count = 0;
+  #ifdef __UNIX__
+  if ((fd = open (name, O_RDONLY)) < 0)
+  #endif
+  #if defined (__MSW32__) || defined (__MAC__)
+    if ((fd = open (name, O_RDONLY | O_BINARY)) < 0)
+  #endif
+  {
+    CANTOPENFILE.error ("read_tif_directories", TESSLOG, name);
+    return NULL;
+  }
+  if (fstat (fd, &info) < 0
+    || read (fd, (char *) &filetype, sizeof filetype) != sizeof filetype
+    || (filetype != INTEL && filetype != MOTO)
+    || lseek (fd, 4L, 0) < 0
+  || read (fd, (char *) &offset, sizeof offset) != sizeof offset) {
+    BADIMAGEFORMAT.error ("read_tif_directories", TESSLOG, name);
+    close(fd);
+    return NULL;
+  }
+  size = 16;
+  offsets = (uinT32 *) alloc_mem (size * sizeof (uinT32));
+  for (;;) {
     if (filetype != __NATIVE__)
-      imagestart = reverse32 (imagestart);
-                                 //indirection
-    lseek (fd, (long) imagestart, 0);
+      offset = reverse32 (offset);
+                                 //a loop would go past this
+    if (offset == 0 || offset >= (uinT32) info.st_size
+      || *count * (sizeof (TIFFENTRY) + sizeof (entries))
+      >= (uinT32) info.st_size)
+      break;
+    if (*count == size) {
+      bigger = (uinT32 *) alloc_mem (size * 2 * sizeof (uinT32));
+      memcpy (bigger, offsets, size * sizeof (uinT32));
+      free_mem(offsets);
+      offsets = bigger;
+      size *= 2;
+    }
+    offsets[(*count)++] = offset;
+    lseek (fd, offset, 0);
+    if (read (fd, (char *) &entries, sizeof entries) != sizeof entries)
+      break;
+    if (filetype != __NATIVE__)
+      entries = reverse16 (entries);
+    lseek (fd, offset + sizeof entries + entries * sizeof (TIFFENTRY), 0);
+    if (read (fd, (char *) &offset, sizeof offset) != sizeof offset)
+      break;
+  }
+  close(fd);
+  return offsets;
+}
+
+
+/**********************************************************************
+ * tif_index_version
+ *
+ * Fill in the fields of an index header that say which version of the
+ * tif file it was made from. A file rewritten within the same second
+ * with the same size still differs in the nanoseconds of its mtime,
+ * where the system keeps them, or in its inode if it was replaced.
+ **********************************************************************/
+
+static void tif_index_version(                          //stamp header
+                              const struct stat *info,  //of tif file
+                              TIF_INDEX_HEADER *header  //header to fill
+                             ) {
+  header->file_size = info->st_size;
+  header->file_time = info->st_mtime;
+  #if defined (__APPLE__)
+  header->file_time_ns = info->st_mtimespec.tv_nsec;
+  #elif defined (__UNIX__) && defined (_POSIX_C_SOURCE) \
+    && _POSIX_C_SOURCE >= 200809L
+  header->file_time_ns = info->st_mtim.tv_nsec;
+  #else
+  header->file_time_ns = 0;
+  #endif
+  header->file_inode = info->st_ino;
+}
+
+
+/**********************************************************************
+ * make_tif_index_temp
+ *
+ * Create and open for writing a new file to build an index in, with a
+ * name that no other process or thread is using, and put the name in
+ * temp_name, which must have room for the index name and 16 more.
+ * Returns the open file, or -1 if it cannot be made.
+ **********************************************************************/
+
+static int make_tif_index_temp(                         //new temp file
+                               const char *index_name,  //name of index
+                               const struct stat *info, //of tif file
+                               char *temp_name          //name made
+                              ) {
+  int fd;                        //temp file
+
+  #ifdef __UNIX__
+  sprintf (temp_name, "%s.XXXXXX", index_name);
+  fd = mkstemp (temp_name);
+  if (fd >= 0)
+    fchmod (fd, info->st_mode & 0666);
+  #endif
+  #if defined (__MSW32__) || defined (__MAC__)
+  static inT32 serial = 0;       //temp files made
+  inT32 tries;                   //names tried
+
+                                 //excl catches a shared serial
+  fd = -1;
+  for (tries = 0; fd < 0 && tries < 16; tries++) {
+    sprintf (temp_name, "%s.%d.%d", index_name, (int) getpid (),
+      (int) (serial++ & 0xffff));
+    fd = open (temp_name, O_WRONLY | O_CREAT | O_EXCL | O_BINARY,
+      info->st_mode & 0666);
   }
-  return compressed ? -2 : 0;
+  #endif
+  return fd;
+}
+
+
+/**********************************************************************
+ * open_tif_index
+ *
+ * Open the page index of a tif file, which is kept beside it with
+ * TIF_INDEX_EXT added to its name. The index holds a TIF_INDEX_HEADER
+ * and the offset of the tag table of every page, so any page can be
+ * found with one read, however many pages there are. An index made for
+ * a different version of the file is ignored.
+ * Writing an index leaves a file beside the input, so it is only made,
+ * or remade, if image_tif_page_index is on. The new index is built in a
+ * temporary file of its own and renamed into place, so processes and
+ * threads making it at the same time do not see each other's partial
+ * files. Single page files get no index, as their page needs no search.
+ * Returns the open index, or -1 if there is none.
+ **********************************************************************/
+
+static int open_tif_index(                          //get index
+                          const char *name,         //name of tif file
+                          TIF_INDEX_HEADER *header  //header of index
+                         ) {
+  struct stat info;              //version of tif file
+  TIF_INDEX_HEADER version;      //header it should have
+  char *index_name;              //name of index
+  char *temp_name;               //index being made
+  int fd;                        //index file
+  uinT32 *offsets;               //tag tables
+  inT32 count;                   //no of pages
+  BOOL8 written;                 //made new index
+
+  if (stat (name, &info) < 0)
+    return -1;
+  index_name = (char *) alloc_mem (strlen (name) + strlen (TIF_INDEX_EXT) + 1);
+  strcpy(index_name, name);
+  strcat(index_name, TIF_INDEX_EXT);
+  #ifdef __UNIX__
+  fd = open (index_name, O_RDONLY);
+  #endif
+  #if defined (__MSW32__) || defined (__MAC__)
+  fd = open (index_name, O_RDONLY | O_BINARY);
+  #endif
+  tif_index_version(&info, &version);
+  if (fd >= 0) {
+    if (read (fd, (char *) header, sizeof (*header)) == sizeof (*header)
+      && header->magic == TIF_INDEX_MAGIC
+      && header->file_size == version.file_size
+      && header->file_time == version.file_time
+      && header->file_time_ns == version.file_time_ns
+    && header->file_inode == version.file_inode) {
+      free_mem(index_name);
+      return fd;                 //up to date
+    }
+    close(fd);
+  }
+  if (!image_tif_page_index) {
+    free_mem(index_name);
+    return -1;                   //not allowed to write one
+  }
+  offsets = read_tif_directories (name, &count);
+  if (offsets == NULL || count < 2) {
+    if (offsets != NULL)
+      free_mem(offsets);
+    free_mem(index_name);
+    return -1;                   //nothing worth keeping
+  }
+  *header = version;
+  header->magic = TIF_INDEX_MAGIC;
+  header->pages = count;
+  temp_name = (char *) alloc_mem (strlen (index_name) + 16);
+  written = FALSE;
+  fd = make_tif_index_temp (index_name, &info, temp_name);
+  if (fd >= 0) {
+    written = write (fd, (char *) header, sizeof (*header))
+      == sizeof (*header)
+      && write (fd, (char *) offsets, count * sizeof (uinT32))
+      == (inT32) (count * sizeof (uinT32));
+    close(fd);
+    if (written)
+      written = rename (temp_name, index_name) == 0;
+    if (!written)
+      unlink(temp_name);
+  }
+  free_mem(offsets);
+  free_mem(temp_name);
+  fd = -1;
+  if (written) {
+    #ifdef __UNIX__
+    fd = open (index_name, O_RDONLY);
+    #endif
+    #if defined (__MSW32__) || defined (__MAC__)
+    fd = open (index_name, O_RDONLY | O_BINARY);
+    #endif
+    if (fd >= 0)
+      lseek (fd, sizeof (*header), 0);
+  }
+  free_mem(index_name);
+  return fd;
+}
+
+
+/**********************************************************************
+ * tif_page_count
+ *
+ * Return the number of pages in a tif file, or -1 if it cannot be read.
+ **********************************************************************/
+
+inT32 tif_page_count(                  //pages in file
+                     const char *name  //name of tif file
+                    ) {
+  TIF_INDEX_HEADER header;       //index header
+  int fd;                        //index file
+  uinT32 *offsets;               //tag tables
+  inT32 count;                   //no of pages
+
+  fd = open_tif_index (name, &header);
+  if (fd >= 0) {
+    close(fd);
+    return header.pages;
+  }
+  offsets = read_tif_directories (name, &count);
+  if (offsets == NULL)
+    return -1;
+  free_mem(offsets);
+  return count;
+}
+
+
+/**********************************************************************
+ * tif_page_directory
+ *
+ * Return the offset of the tag table of the given page of a tif file,
+ * for open_tif_directory, or 0 if there is no such page.
+ **********************************************************************/
+
+uinT32 tif_page_directory(                  //find page
+                          const char *name, //name of tif file
+                          inT32 page        //page number from 0
+                         ) {
+  TIF_INDEX_HEADER header;       //index header
+  int fd;                        //index file
+  uinT32 *offsets;               //tag tables
+  inT32 count;                   //no of pages
+  uinT32 directory;              //result
+
+  if (page < 0)
+    return 0;
+  directory = 0;
+  fd = open_tif_index (name, &header);
+  if (fd >= 0) {
+    if ((uinT32) page >= header.pages
+      || lseek (fd, sizeof (header) + page * sizeof (uinT32), 0) < 0
+      || read (fd, (char *) &directory, sizeof (directory))
+      != sizeof (directory))
+      directory = 0;
+    close(fd);
+    return directory;
+  }
+                                 //no index, so search
+  offsets = read_tif_directories (name, &count);
+  if (offsets == NULL)
+    return 0;
+  if (page < count)
+    directory = offsets[page];
+  free_mem(offsets);
+  return directory;
 }
 
 
 /**********************************************************************
  * read_tif_image
  *
- * Read a whole tif image into memory.
+ * Read a whole tif image into memory, given the file at its tag table.
+ * G3 images are decoded here from the first strip, everything else by a
+ * TIF_STREAM.
  **********************************************************************/
 
 inT8 read_tif_image(                //read whole image
@@ -346,7 +1350,7 @@ inT8 read_tif_image(                //read whole image
                     inT32 xsize,    //size of image
                     inT32 ysize,
                     inT8 bpp,       //bits per pixel
-                    inT32           //bytes per line
+                    inT32 bytes_per_line
                    ) {
   inT32 xindex;                  //indices in image
   inT32 yindex;
@@ -359,7 +1363,13 @@ inT8 read_tif_image(                //read whole image
   IMAGE image;                   //dummy image
   R_BITSTREAM bits;              //read bitstream
   uinT8 colour;                  //current colour
+  TIF_STREAM stream;             //strip decoder
 
+  if (stream.read_header (fd, lseek (fd, 0L, SEEK_CUR)) < 0)
+    return -1;
+  if (stream.get_compression () != CCITT_G3)
+    return stream.read_lines (pixels, bytes_per_line, ysize);
+  lseek (fd, (long) stream.get_image_start (), 0);
   image.capture (pixels, xsize, ysize, bpp);
   codeword = bits.open (fd);     //open bitstream
   read_eol(&bits, codeword);  //find end of line
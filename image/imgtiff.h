@@ -23,6 +23,107 @@
 #include          "host.h"
 #include          "bitstrm.h"
 
+/**********************************************************************
+ * TIF_STREAM
+ *
+ * Decodes the strips of a tif image a line at a time, so only a small
+ * buffer of the file and two lines of run ends are in memory at once,
+ * however big the page. Handles uncompressed, PackBits and CCITT G4
+ * strips. Lines come out top first in the layout of an uncompressed
+ * tif, so the result is the same as if the file had not been compressed.
+ **********************************************************************/
+
+class DLLSYM TIF_STREAM
+{
+  public:
+    TIF_STREAM();                //empty stream
+    ~TIF_STREAM();
+
+    inT8 read_header(                       //read tag table
+                     int fd,                //file to read
+                     uinT32 directory = 0); //offset or 0 for first
+    inT8 read_lines(                      //decode some lines
+                    uinT8 *pixels,        //first line to fill
+                    inT32 bytes_per_line, //step between lines
+                    inT32 lines);         //no of lines to decode
+
+    inT32 get_xsize() {          //size of image
+      return xsize;
+    }
+    inT32 get_ysize() {
+      return ysize;
+    }
+    inT8 get_bpp() {             //bits per pixel
+      return bpp;
+    }
+    inT8 get_photo() {           //interpretation
+      return photo;
+    }
+    inT32 get_res() {            //resolution or -1
+      return res;
+    }
+    inT32 get_compression() {    //tif compression code
+      return compression;
+    }
+    uinT32 get_image_start() {   //offset of first strip
+      return strip_offsets[0];
+    }
+    uinT32 get_directory() {     //offset of tag table
+      return directory;
+    }
+    BOOL8 contiguous();          //true if strips follow on
+
+  private:
+    int fd;                      //file being read
+    uinT32 directory;            //offset of tag table
+    inT16 filetype;              //INTEL or MOTO
+    inT32 xsize, ysize;          //size of image
+    inT8 bpp;                    //bits per pixel
+    inT8 photo;                  //interpretation
+    inT32 res;                   //resolution
+    inT32 compression;           //tif compression code
+    inT32 fillorder;             //2 if bits are lsb first
+    inT32 rows_per_strip;        //lines in each strip
+    inT32 strip_count;           //no of strips
+    uinT32 *strip_offsets;       //file offset of each strip
+    uinT32 *strip_sizes;         //bytes in each strip
+    inT32 strip;                 //current strip
+    inT32 strip_row;             //lines done in strip
+    uinT32 strip_left;           //bytes of strip not read
+    inT32 bufindex;              //next byte of buffer
+    inT32 bufsize;               //bytes in buffer
+    uinT32 bitword;              //G4 bits, msb first
+    inT32 bitcount;              //valid bits in bitword
+    BOOL8 ended;                 //hit end of G4 data
+    inT32 *ref_ends;             //run ends of previous line
+    inT32 *run_ends;             //run ends of current line
+    uinT8 buffer[BITBUFSIZE];    //part of current strip
+
+    inT8 read_values(                 //read tag array
+                     uinT16 type,     //tag type
+                     uinT32 length,   //no of values
+                     uinT32 value,    //value or offset
+                     uinT32 *values); //output array
+    inT8 start_strip();          //go to next strip
+    inT32 next_byte();           //byte of strip or -1
+    inT32 read_bytes(                 //copy bytes of strip
+                     uinT8 *dest,     //where to put them
+                     inT32 count);    //no wanted
+    uinT32 peek_bits(              //look at next bits
+                     inT32 count); //no of bits
+    void skip_bits(                //lose some bits
+                   inT32 count) {  //no of bits
+      bitword <<= count;
+      bitcount -= count;
+    }
+    inT32 read_run(                  //read G4 run length
+                   BOOL8 black);     //colour of run
+    inT8 read_packbits_line(               //decode line
+                            uinT8 *line);  //line to fill
+    inT8 read_g4_line(               //decode line
+                      uinT8 *line);  //line to fill
+};
+
 inT8 open_tif_image(               //read header
                     int fd,        //file to read
                     inT32 *xsize,  //size of image
@@ -31,13 +132,29 @@ inT8 open_tif_image(               //read header
                     inT8 *photo,   //interpretation
                     inT32 *res     //resolution
                    );
+inT8 open_tif_directory(                  //read header
+                        int fd,           //file to read
+                        uinT32 directory, //offset or 0 for first
+                        inT32 *xsize,     //size of image
+                        inT32 *ysize,
+                        inT8 *bpp,        //bits per pixel
+                        inT8 *photo,      //interpretation
+                        inT32 *res        //resolution
+                       );
+inT32 tif_page_count(                  //pages in file
+                     const char *name  //name of tif file
+                    );
+uinT32 tif_page_directory(                  //find page
+                          const char *name, //name of tif file
+                          inT32 page        //page number from 0
+                         );
 inT8 read_tif_image(                //read whole image
                     int fd,         //file to read
                     uinT8 *pixels,  //pixels of image
                     inT32 xsize,    //size of image
                     inT32 ysize,
                     inT8 bpp,       //bits per pixel
-                    inT32           //bytes per line
+                    inT32 bytes_per_line
                    );
 inT32 read_eol(                    //read end of line
                R_BITSTREAM *bits,  //bitstream to read
@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////
+// File:        imgconvtest.cpp
+// Description: Check the direct bpp conversions of copy_sub_image.
+// Created:     Sat Oct 17 2026
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////
+
+// copy_sub_image converts between 1, 8 and 24 bpp with convert_line,
+// unless image_fast_convert is off, when it takes the original per-pixel
+// path through get_line and put_line. This program copies the same
+// rectangles both ways for every pair of those depths, with every small
+// odd and even source and destination offset and width, with and without
+// adjust_grey, and then random ones, and fails if any destination differs.
+// Run by make check.
+
+#include "mfcpch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "img.h"
+#include "imgs.h"
+#include "varable.h"
+
+extern BOOL_VARIABLE image_fast_convert;
+
+const int kNumDepths = 3;
+const int kDepths[kNumDepths] = {1, 8, 24};
+// Offsets and widths below these are all tried, which covers every bit
+// position of a 1 bpp byte and the tails of the 16 pixel SIMD groups.
+const int kMaxOffset = 10;
+const int kMaxWidth = 70;
+const int kNumRandomCases = 2000;
+const int kHeight = 4;
+// Stop reporting after this many failures.
+const int kMaxReports = 10;
+
+static int failures = 0;
+static int cases = 0;
+
+// Fill every byte of the image with noise.
+static void FillRandom(IMAGE* image) {
+  int bytes = COMPUTE_IMAGE_XDIM(image->get_xsize(), image->get_bpp());
+  for (int y = 0; y < image->get_ysize(); ++y) {
+    uinT8* line = image->get_raw_line(y);
+    for (int i = 0; i < bytes; ++i)
+      line[i] = rand() & 0xff;
+  }
+}
+
+// Return true if the images have the same bytes.
+static bool SameImage(IMAGE* a, IMAGE* b) {
+  int bytes = COMPUTE_IMAGE_XDIM(a->get_xsize(), a->get_bpp());
+  for (int y = 0; y < a->get_ysize(); ++y) {
+    if (memcmp(a->get_raw_line(y), b->get_raw_line(y), bytes) != 0)
+      return false;
+  }
+  return true;
+}
+
+// Copy width pixels of rows 1..kHeight-2 of a random source of src_bpp
+// from xstart to xdest of a random destination of dest_bpp, both ways,
+// and compare the results.
+static void TestCopy(int src_bpp, int dest_bpp, int src_width,
+                     int dest_width, int xstart, int xdest, int width,
+                     BOOL8 adjust_grey) {
+  IMAGE source, fast_dest, slow_dest;
+  source.create(src_width, kHeight, src_bpp);
+  fast_dest.create(dest_width, kHeight, dest_bpp);
+  slow_dest.create(dest_width, kHeight, dest_bpp);
+  FillRandom(&source);
+  FillRandom(&fast_dest);
+  copy_sub_image(&fast_dest, 0, 0, 0, 0, &slow_dest, 0, 0, FALSE);
+
+  image_fast_convert.set_value(FALSE);
+  copy_sub_image(&source, xstart, 1, width, kHeight - 2,
+                 &slow_dest, xdest, 1, adjust_grey);
+  image_fast_convert.set_value(TRUE);
+  copy_sub_image(&source, xstart, 1, width, kHeight - 2,
+                 &fast_dest, xdest, 1, adjust_grey);
+  ++cases;
+  if (!SameImage(&fast_dest, &slow_dest)) {
+    if (++failures <= kMaxReports)
+      printf("FAIL: %d->%d bpp, src width %d, dest width %d,"
+             " xstart %d, xdest %d, width %d, adjust_grey %d\n",
+             src_bpp, dest_bpp, src_width, dest_width,
+             xstart, xdest, width, adjust_grey);
+  }
+}
+
+int main(int argc, char** argv) {
+  srand(1);
+  for (int s = 0; s < kNumDepths; ++s) {
+    for (int d = 0; d < kNumDepths; ++d) {
+      if (s == d)
+        continue;
+      for (int adjust = 0; adjust < 2; ++adjust) {
+        for (int width = 1; width <= kMaxWidth; ++width) {
+          for (int offset = 0; offset < kMaxOffset; ++offset) {
+            // Odd source and destination offsets together and apart.
+            int src_width = offset + width + 3;
+            int dest_width = kMaxOffset + width;
+            TestCopy(kDepths[s], kDepths[d], src_width, dest_width,
+                     offset, 0, width, adjust);
+            TestCopy(kDepths[s], kDepths[d], src_width, dest_width,
+                     0, offset, width, adjust);
+            TestCopy(kDepths[s], kDepths[d], src_width, dest_width,
+                     offset, kMaxOffset - 1 - offset, width, adjust);
+          }
+        }
+      }
+      for (int i = 0; i < kNumRandomCases; ++i) {
+        int src_width = 1 + rand() % 300;
+        int dest_width = 1 + rand() % 300;
+        // A width of 0 copies to the end of the line, and widths that
+        // run off either image are clipped by copy_sub_image.
+        TestCopy(kDepths[s], kDepths[d], src_width, dest_width,
+                 rand() % src_width, rand() % dest_width,
+                 rand() % (src_width + 1), rand() & 1);
+      }
+    }
+  }
+  if (failures > 0) {
+    printf("%s: %d of %d copies differ\n", argv[0], failures, cases);
+    return 1;
+  }
+  printf("%s: all %d copies match\n", argv[0], cases);
+  return 0;
+}
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////
+// File:        prunerbench.cpp
+// Description: Time the class pruner kernels.
+// Created:     Sat Oct 17 2026
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////
+
+// Loads the class pruners of a language and times CPUpdateClassCounts
+// on a blob of random features with each value of ClassPrunerKernel,
+// checking that every kernel gives the counts of the scalar one. A kernel
+// the compiler or the CPU lacks falls back to the next narrower one, so
+// its time is that of the kernel actually used.
+// Built by make check, but not run by it: run it by hand on a quiet
+// machine, as
+//   prunerbench [tessdata_dir [language]]
+// Returns non-zero if any counts differ.
+
+#include "mfcpch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "intmatcher.h"
+#include "intproto.h"
+#include "callcpp.h"
+#include "globals.h"
+
+extern int ClassPrunerKernel;
+
+// Features per blob, about the number in a typical character.
+const int kNumFeatures = 60;
+const int kNumBlobs = 20000;
+const int kNumKernels = 3;
+const char* const kKernelNames[kNumKernels + 1] = {
+  "best", "scalar", "sse2", "avx2"
+};
+
+int main(int argc, char** argv) {
+  STRING prefix = argc > 1 ? argv[1] : "../tessdata";
+  prefix += "/";
+  prefix += argc > 2 ? argv[2] : "eng";
+  STRING unicharset_file = prefix + ".unicharset";
+  STRING inttemp_file = prefix + ".inttemp";
+  if (!unicharset.load_from_file(unicharset_file.string())) {
+    printf("Unable to load unicharset file %s\n", unicharset_file.string());
+    return 1;
+  }
+  INT_TEMPLATES templates = MapIntTemplates(inttemp_file.string());
+  if (templates == NULL) {
+    FILE* fp = fopen(inttemp_file.string(), "rb");
+    if (fp == NULL) {
+      printf("Unable to open inttemp file %s\n", inttemp_file.string());
+      return 1;
+    }
+    templates = ReadIntTemplates(fp, TRUE);
+    fclose(fp);
+  }
+  setup_cp_maps();
+  InitIntegerMatcher();
+  INT_MATCHER_STATE state = NewIntMatcherState();
+
+  static INT_FEATURE_STRUCT features[MAX_NUM_INT_FEATURES];
+  srand(1);
+  for (int f = 0; f < kNumFeatures; ++f) {
+    features[f].X = rand() & 0xff;
+    features[f].Y = rand() & 0xff;
+    features[f].Theta = rand() & 0xff;
+  }
+  printf("%d classes, %d class pruners, %d features per blob\n",
+         NumClassesIn(templates), NumClassPrunersIn(templates),
+         kNumFeatures);
+
+  static int scalar_counts[MAX_NUM_CLASSES];
+  static int counts[MAX_NUM_CLASSES];
+  int failures = 0;
+  for (int kernel = 1; kernel <= kNumKernels; ++kernel) {
+    ClassPrunerKernel = kernel;
+    clock_t start = clock();
+    for (int blob = 0; blob < kNumBlobs; ++blob) {
+      memset(counts, 0, sizeof(counts));
+      CPUpdateClassCounts(state, templates, kNumFeatures, features, counts);
+    }
+    double seconds = static_cast<double>(clock() - start) / CLOCKS_PER_SEC;
+    if (kernel == 1)
+      memcpy(scalar_counts, counts, sizeof(counts));
+    bool same = memcmp(counts, scalar_counts, sizeof(counts)) == 0;
+    if (!same)
+      ++failures;
+    printf("%-6s %6.2fus per blob%s\n", kKernelNames[kernel],
+           seconds / kNumBlobs * 1e6, same ? "" : " COUNTS DIFFER");
+  }
+  ClassPrunerKernel = 0;
+  FreeIntMatcherState(state);
+  free_int_templates(templates);
+  return failures > 0 ? 1 : 0;
+}
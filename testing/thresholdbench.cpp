@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////
+// File:        thresholdbench.cpp
+// Description: Time HistogramRect and ThresholdRect on whole pages.
+// Created:     Sat Oct 17 2026
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////
+
+// Times the histogram and thresholding of TessBaseAPI against copies of
+// the original per-pixel versions, on synthetic letter size grey and RGB
+// pages at 300 and 600 dpi, and checks that both give the same result.
+// The thresholding of grey pages uses SSE2 where the library was built
+// for it; the histogram is scalar C++ on every build.
+// Built by make check, but not run by it: run it by hand on a quiet
+// machine. Returns non-zero if any result differs.
+
+#include "mfcpch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "baseapi.h"
+#include "img.h"
+#include "imgs.h"
+
+// Letter size pages at 300 and 600 dpi.
+const int kNumPageSizes = 2;
+const int kPageSizes[kNumPageSizes][3] = {
+  {2550, 3300, 300}, {5100, 6600, 600}
+};
+// Times each kernel is run; the best time is reported.
+const int kRepeats = 3;
+
+// Gives access to the protected thresholding functions.
+class ThresholdBench : public TessBaseAPI {
+ public:
+  static void Histogram(const unsigned char* imagedata, int bytes_per_pixel,
+                        int bytes_per_line, int left, int top,
+                        int right, int bottom, int* histogram) {
+    HistogramRect(imagedata, bytes_per_pixel, bytes_per_line,
+                  left, top, right, bottom, histogram);
+  }
+  static void Threshold(const unsigned char* imagedata, int bytes_per_pixel,
+                        int bytes_per_line, int left, int top,
+                        int width, int height,
+                        const int* thresholds, const int* hi_values,
+                        IMAGE* image) {
+    ThresholdRect(imagedata, bytes_per_pixel, bytes_per_line,
+                  left, top, width, height, thresholds, hi_values, image);
+  }
+};
+
+// The original HistogramRect.
+static void OldHistogram(const unsigned char* imagedata, int bytes_per_pixel,
+                         int bytes_per_line, int left, int top,
+                         int right, int bottom, int* histogram) {
+  int width = right - left;
+  memset(histogram, 0, sizeof(*histogram) * 256);
+  const unsigned char* pixels = imagedata + top * bytes_per_line +
+                                left * bytes_per_pixel;
+  for (int y = top; y < bottom; ++y) {
+    for (int x = 0; x < width; ++x)
+      ++histogram[pixels[x * bytes_per_pixel]];
+    pixels += bytes_per_line;
+  }
+}
+
+// The original ThresholdRect.
+static void OldThreshold(const unsigned char* imagedata, int bytes_per_pixel,
+                         int bytes_per_line, int left, int top,
+                         int width, int height,
+                         const int* thresholds, const int* hi_values,
+                         IMAGE* image) {
+  IMAGELINE line;
+  image->create(width, height, 1);
+  line.init(width);
+  const unsigned char* data = imagedata + top * bytes_per_line +
+                              left * bytes_per_pixel;
+  for (int y = height - 1 ; y >= 0; --y) {
+    const unsigned char* pix = data;
+    for (int x = 0; x < width; ++x, pix += bytes_per_pixel) {
+      line.pixels[x] = 1;
+      for (int ch = 0; ch < bytes_per_pixel; ++ch) {
+        if (hi_values[ch] >= 0 &&
+            (pix[ch] > thresholds[ch]) == (hi_values[ch] == 0)) {
+          line.pixels[x] = 0;
+          break;
+        }
+      }
+    }
+    image->put_line(0, y, width, &line, 0);
+    data += bytes_per_line;
+  }
+}
+
+static double Now() {
+  return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+}
+
+// Make a page of alternating blocks of noise and near white.
+static unsigned char* MakePage(int width, int height, int bytes_per_pixel) {
+  int bytes_per_line = width * bytes_per_pixel;
+  unsigned char* data = new unsigned char[bytes_per_line * height];
+  srand(1);
+  for (int y = 0; y < height; ++y) {
+    unsigned char* line = data + y * bytes_per_line;
+    for (int x = 0; x < bytes_per_line; ++x)
+      line[x] = ((x / 40 + y / 60) & 1) ? 200 + rand() % 50 : rand() % 256;
+  }
+  return data;
+}
+
+static bool SameImage(IMAGE* a, IMAGE* b) {
+  int bytes = COMPUTE_IMAGE_XDIM(a->get_xsize(), a->get_bpp());
+  for (int y = 0; y < a->get_ysize(); ++y) {
+    if (memcmp(a->get_raw_line(y), b->get_raw_line(y), bytes) != 0)
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int failures = 0;
+  int thresholds[3] = {128, 100, 150};
+  int hi_values[3] = {1, 1, 0};
+  printf("%-12s %10s %10s %10s %10s\n", "page",
+         "hist old", "hist new", "thr old", "thr new");
+  for (int size = 0; size < kNumPageSizes; ++size) {
+    int width = kPageSizes[size][0];
+    int height = kPageSizes[size][1];
+    for (int bytes_per_pixel = 1; bytes_per_pixel <= 3;
+         bytes_per_pixel += 2) {
+      unsigned char* data = MakePage(width, height, bytes_per_pixel);
+      int bytes_per_line = width * bytes_per_pixel;
+      int old_histogram[256], new_histogram[256];
+      IMAGE old_image, new_image;
+      double best[4] = {1e9, 1e9, 1e9, 1e9};
+      for (int r = 0; r < kRepeats; ++r) {
+        double times[5];
+        times[0] = Now();
+        for (int ch = 0; ch < bytes_per_pixel; ++ch)
+          OldHistogram(data + ch, bytes_per_pixel, bytes_per_line,
+                       0, 0, width, height, old_histogram);
+        times[1] = Now();
+        for (int ch = 0; ch < bytes_per_pixel; ++ch)
+          ThresholdBench::Histogram(data + ch, bytes_per_pixel,
+                                    bytes_per_line, 0, 0, width, height,
+                                    new_histogram);
+        times[2] = Now();
+        OldThreshold(data, bytes_per_pixel, bytes_per_line, 0, 0,
+                     width, height, thresholds, hi_values, &old_image);
+        times[3] = Now();
+        ThresholdBench::Threshold(data, bytes_per_pixel, bytes_per_line,
+                                  0, 0, width, height,
+                                  thresholds, hi_values, &new_image);
+        times[4] = Now();
+        for (int t = 0; t < 4; ++t) {
+          if (times[t + 1] - times[t] < best[t])
+            best[t] = times[t + 1] - times[t];
+        }
+      }
+      bool same_histogram = memcmp(old_histogram, new_histogram,
+                                   sizeof(old_histogram)) == 0;
+      bool same_image = SameImage(&old_image, &new_image);
+      if (!same_histogram || !same_image)
+        ++failures;
+      printf("%ddpi %-5s %8.1fms %8.1fms %8.1fms %8.1fms%s%s\n",
+             kPageSizes[size][2], bytes_per_pixel == 1 ? "grey" : "rgb",
+             best[0] * 1000, best[1] * 1000, best[2] * 1000, best[3] * 1000,
+             same_histogram ? "" : " HISTOGRAM DIFFERS",
+             same_image ? "" : " IMAGE DIFFERS");
+      delete [] data;
+    }
+  }
+  return failures > 0 ? 1 : 0;
+}
@@ -35,9 +35,6 @@ EXTERN INT_VAR (edges_maxedgelength, 16000, "Max steps in any outline");
 #ifndef GRAPHICS_DISABLED
 static ScrollView* edge_win;          //window
 #endif
-static C_OUTLINE_IT *outline_it; //iterator
-static int short_edges;          //no of short ones
-static int long_edges;           //no of long ones
 
 /**********************************************************************
  * get_outlines
@@ -58,8 +55,7 @@ DLLSYM void get_outlines(                      //edge detect
 #ifndef GRAPHICS_DISABLED
   edge_win = window;             //set statics
 #endif
-  outline_it = out_it;
-  block_edges(t_image, block, page_tr);
+  block_edges(t_image, block, page_tr, out_it);
   out_it->move_to_first ();
 #ifndef GRAPHICS_DISABLED
   if (window != NULL)
@@ -75,8 +71,10 @@ DLLSYM void get_outlines(                      //edge detect
  * Complete the edge by cleaning it up andapproximating it.
  **********************************************************************/
 
-void complete_edge(                  //clean and approximate
-                   CRACKEDGE *start  //start of loop
+void complete_edge(                         //clean and approximate
+                   CRACKEDGE *start,        //start of loop
+                   C_OUTLINE_IT *outline_it,//output iterator
+                   OUTLINE_ARENA *arena     //memory for steps
                   ) {
   ScrollView::Color colour;                 //colour to draw in
   inT16 looplength;              //steps in loop
@@ -95,7 +93,8 @@ void complete_edge(                  //clean and approximate
 
   if (colour == ScrollView::RED || colour == ScrollView::BLUE) {
     looplength = loop_bounding_box (start, botleft, topright);
-    outline = new C_OUTLINE (start, botleft, topright, looplength);
+    outline = new C_OUTLINE (start, botleft, topright, looplength,
+      arena);
                                  //add to list
     outline_it->add_after_then_move (outline);
   }
@@ -145,11 +144,9 @@ ScrollView::Color check_path_legal(                  //certify outline
   if ((chainsum != 4 && chainsum != -4)
   || edgept != start || length < MINEDGELENGTH) {
     if (edgept != start) {
-      long_edges++;
       return ScrollView::YELLOW;
     }
     else if (length < MINEDGELENGTH) {
-      short_edges++;
       return ScrollView::MAGENTA;
     }
     else {
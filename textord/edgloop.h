@@ -53,8 +53,10 @@ DLLSYM void get_outlines(                      //edge detect
                          PDBLK *block,         //block to scan
                          C_OUTLINE_IT *out_it  //output iterator
                         );
-void complete_edge(                  //clean and approximate
-                   CRACKEDGE *start  //start of loop
+void complete_edge(                         //clean and approximate
+                   CRACKEDGE *start,        //start of loop
+                   C_OUTLINE_IT *outline_it,//output iterator
+                   OUTLINE_ARENA *arena     //memory for steps
                   );
 ScrollView::Color check_path_legal(                  //certify outline
                         CRACKEDGE *start  //start of loop
@@ -21,6 +21,7 @@
 #include          "edgloop.h"
 //#include                                      "dirtab.h"
 #include          "scanedg.h"
+#include          "svutil.h"
 
 #define WHITE_PIX     1          /*thresholded colours */
 #define BLACK_PIX     0
@@ -32,8 +33,51 @@
 #define XMARGIN       2          //margin needed
 #define YMARGIN       3          //by edge detector
 
-                                 /*local freelist */
-static CRACKEDGE *free_cracks = NULL;
+#define EXTERN
+
+#define CRACK_CHUNK_SIZE 1024    //crack edges per chunk
+#define PACKED_WORD_BITS 64      //pixels per packed word
+#define MIN_STRIPE_HEIGHT 64     //least lines in a stripe
+
+EXTERN BOOL_VAR (edges_packed_scan, TRUE,
+"Scan binary images a word at a time");
+EXTERN INT_VAR (edges_scan_threads, 1,
+"Threads to scan a block for edges in stripes");
+EXTERN BOOL_VAR (edges_use_arena, TRUE,
+"Put outline steps of each edge scan in an arena");
+EXTERN BOOL_VAR (edges_arena_stats, FALSE,
+"Print allocator counts at the end of each edge scan");
+
+                                 //block of new edges
+struct CRACKEDGE_CHUNK
+{
+  CRACKEDGE_CHUNK *next;         //next allocated chunk
+  CRACKEDGE edges[CRACK_CHUNK_SIZE];
+};
+
+                                 //part of a striped block
+struct EDGE_STRIPE
+{
+  IMAGE *t_image;                //threshold image
+  PDBLK *block;                  //block in image
+  inT16 top;                     //first line to scan
+  inT16 bottom;                  //last line to scan
+  CRACKEDGE **ptrline;           //edges in progress
+  CRACKEDGE **stubs;             //edges from stripe above
+  C_OUTLINE_LIST outlines;       //outlines closed in stripe
+  C_OUTLINE_IT outline_it;       //to add to them
+  EDGE_SCAN *scan;               //crack edges of stripe
+  SVThread thread;               //thread scanning it
+  BOOL8 threaded;                //thread must be joined
+};
+
+                                 //order of an outline
+struct OUTLINE_ORDER
+{
+  inT16 y;                       //line it closed on
+  inT16 x;                       //pixel it closed at
+  C_OUTLINE *outline;            //the outline
+};
 
 /**********************************************************************
  * block_edges
@@ -44,57 +88,500 @@ static CRACKEDGE *free_cracks = NULL;
 DLLSYM void block_edges(                      //get edges in a block
                         IMAGE *t_image,       //threshold image
                         PDBLK *block,         //block in image
-                        ICOORD page_tr        //corner of page
+                        ICOORD page_tr,       //corner of page
+                        C_OUTLINE_IT *out_it  //output iterator
                        ) {
-  uinT8 margin;                  //margin colour
   inT16 x;                       //line coords
-  inT16 y;                       //current line
   ICOORD bleft;                  //bounding box
   ICOORD tright;
-  ICOORD block_bleft;            //bounding box
-  ICOORD block_tright;
-  int xindex;                    //index to pixel
-  BLOCK_LINE_IT line_it = block; //line iterator
-  IMAGELINE bwline;              //thresholded line
+  int stripecount;               //stripes to scan
                                  //lines in progress
   CRACKEDGE *ptrlinemem[MAXIMAGEWIDTH];
   CRACKEDGE **ptrline = ptrlinemem;
 
+                                 //block box
+  block->bounding_box (bleft, tright);
+  stripecount = edges_scan_threads;
+  if (stripecount > (tright.y () - bleft.y ()) / MIN_STRIPE_HEIGHT)
+    stripecount = (tright.y () - bleft.y ()) / MIN_STRIPE_HEIGHT;
+#ifndef GRAPHICS_DISABLED
+  if (edges_show_paths)
+    stripecount = 1;             //draw from this thread
+#endif
+  if (stripecount > 1) {
+    striped_block_edges(t_image, block, stripecount, out_it);
+    return;
+  }
+
   if (t_image->get_xsize()+1 > MAXIMAGEWIDTH) {
     ptrline = new CRACKEDGE*[t_image->get_xsize()+1];
   }
-
-                                 //block box
-  block->bounding_box (bleft, tright);
-  block_bleft = bleft;
-  block_tright = tright;
   for (x = tright.x () - bleft.x (); x >= 0; x--)
     ptrline[x] = NULL;           //no lines in progress
 
-  bwline.init (t_image->get_xsize());
+  EDGE_SCAN scan(out_it);        //owns the crack edges
+  scan_block_lines (t_image, block, tright.y () - 1, bleft.y () - 1,
+    ptrline, &scan);
 
+  if (ptrline != ptrlinemem) {
+    delete [] ptrline;
+  }
+}
+
+
+/**********************************************************************
+ * scan_block_lines
+ *
+ * Scan the lines of a block from top down to bottom, updating the
+ * edges in progress and sending those that close to complete_edge.
+ * Lines outside the block are white.
+ **********************************************************************/
+
+void scan_block_lines(                     //scan some lines
+                      IMAGE *t_image,      //threshold image
+                      PDBLK *block,        //block in image
+                      inT16 top,           //first line
+                      inT16 bottom,        //last line
+                      CRACKEDGE **ptrline, //edges in progress
+                      EDGE_SCAN *scan      //edge memory
+                     ) {
+  uinT8 margin;                  //margin colour
+  inT16 x;                       //line coords
+  inT16 y;                       //current line
+  ICOORD bleft;                  //bounding box
+  ICOORD tright;
+  int xindex;                    //index to pixel
+  BLOCK_LINE_IT line_it = block; //line iterator
+  IMAGELINE bwline;              //thresholded line
+  int wordcount;                 //words in packed line
+  uinT64 *packedline;            //packed thresholded line
+  uinT64 *activeline;            //bits set where ptrline used
+
+  block->bounding_box (bleft, tright);
   margin = WHITE_PIX;
 
-  for (y = tright.y () - 1; y >= bleft.y () - 1; y--) {
-    if (y >= block_bleft.y () && y < block_tright.y ()) {
-      t_image->get_line (bleft.x (), y, tright.x () - bleft.x (), &bwline,
-        0);
-      make_margins (block, &line_it, bwline.pixels, margin, bleft.x (),
-        tright.x (), y);
+  if (edges_packed_scan && t_image->get_bpp () == 1) {
+                                 //room for ptrline bits
+    wordcount = (tright.x () - bleft.x ()) / PACKED_WORD_BITS + 1;
+    packedline = new uinT64[wordcount];
+    activeline = new uinT64[wordcount];
+    for (xindex = 0; xindex < wordcount; xindex++)
+      activeline[xindex] = 0;
+    for (xindex = tright.x () - bleft.x (); xindex >= 0; xindex--) {
+      if (ptrline[xindex] != NULL)
+        activeline[xindex / PACKED_WORD_BITS] |=
+          (uinT64) 1 << (PACKED_WORD_BITS - 1 - xindex % PACKED_WORD_BITS);
     }
-    else {
-      x = tright.x () - bleft.x ();
-      for (xindex = 0; xindex < x; xindex++)
-        bwline.pixels[xindex] = margin;
+    for (y = top; y >= bottom; y--) {
+      if (y >= bleft.y () && y < tright.y ()) {
+        get_packed_line (t_image, bleft.x (), y, tright.x () - bleft.x (),
+          packedline);
+        make_packed_margins (block, &line_it, packedline, bleft.x (),
+          tright.x (), y);
+      }
+      else {
+        for (xindex = 0; xindex < wordcount; xindex++)
+          packedline[xindex] = ~(uinT64) 0;
+      }
+      packed_line_edges (bleft.x (), y, tright.x () - bleft.x (),
+        margin, packedline, ptrline, activeline, scan);
+    }
+    delete [] packedline;
+    delete [] activeline;
+  }
+  else {
+    bwline.init (t_image->get_xsize());
+    for (y = top; y >= bottom; y--) {
+      if (y >= bleft.y () && y < tright.y ()) {
+        t_image->get_line (bleft.x (), y, tright.x () - bleft.x (), &bwline,
+          0);
+        make_margins (block, &line_it, bwline.pixels, margin, bleft.x (),
+          tright.x (), y);
+      }
+      else {
+        x = tright.x () - bleft.x ();
+        for (xindex = 0; xindex < x; xindex++)
+          bwline.pixels[xindex] = margin;
+      }
+      line_edges (bleft.x (), y, tright.x () - bleft.x (),
+        margin, bwline.pixels, ptrline, scan);
     }
-    line_edges (bleft.x (), y, tright.x () - bleft.x (),
-      margin, bwline.pixels, ptrline);
   }
+}
 
-  free_crackedges(free_cracks);  //really free them
-  free_cracks = NULL;
-  if (ptrline != ptrlinemem) {
-    delete [] ptrline;
+
+/**********************************************************************
+ * striped_block_edges
+ *
+ * Extract edges from a PDBLK cut into stripecount stripes across, each
+ * scanned on its own thread. Each stripe below the first starts with a
+ * stub crack edge wherever the last line of the stripe above changes
+ * colour, standing for the edge that comes down into it, and the stripe
+ * above stops with its edges still in progress. Once all are done, the
+ * stubs are replaced by those edges, closing the outlines that cross
+ * the stripes, and all the outlines are put in the order the single
+ * scan would have made.
+ **********************************************************************/
+
+void striped_block_edges(                      //get edges in stripes
+                         IMAGE *t_image,       //threshold image
+                         PDBLK *block,         //block in image
+                         int stripecount,      //no of stripes
+                         C_OUTLINE_IT *out_it  //output iterator
+                        ) {
+  ICOORD bleft;                  //bounding box
+  ICOORD tright;
+  inT16 xext;                    //width of block
+  int stripe;                    //stripe index
+  int xindex;                    //index to pixel
+  EDGE_STRIPE *stripes;          //all the stripes
+  C_OUTLINE_LIST outlines;       //all the outlines
+  C_OUTLINE_IT outline_it = &outlines;
+  EDGE_SCAN stitch_scan(&outline_it);
+
+  block->bounding_box (bleft, tright);
+  xext = tright.x () - bleft.x ();
+  stripes = new EDGE_STRIPE[stripecount];
+  for (stripe = 0; stripe < stripecount; stripe++) {
+    EDGE_STRIPE *current = &stripes[stripe];
+    current->t_image = t_image;
+    current->block = block;
+    current->top = tright.y () - 1 -
+      (tright.y () - bleft.y ()) * stripe / stripecount;
+    current->bottom = tright.y () -
+      (tright.y () - bleft.y ()) * (stripe + 1) / stripecount;
+    if (stripe == stripecount - 1)
+      current->bottom--;         //white line to close all
+    current->ptrline = new CRACKEDGE*[xext + 1];
+    current->stubs = new CRACKEDGE*[xext + 1];
+    current->outline_it.set_to_list (&current->outlines);
+    current->scan = new EDGE_SCAN(&current->outline_it);
+    current->threaded = FALSE;
+    for (xindex = 0; xindex <= xext; xindex++)
+      current->ptrline[xindex] = NULL;
+    if (stripe > 0)
+      make_stubs (t_image, block, current->top + 1, current->ptrline,
+        current->scan);
+    for (xindex = 0; xindex <= xext; xindex++)
+      current->stubs[xindex] = current->ptrline[xindex];
+  }
+  for (stripe = 1; stripe < stripecount; stripe++) {
+    stripes[stripe].threaded =
+      SVSync::StartJoinableThread (scan_stripe, &stripes[stripe],
+      &stripes[stripe].thread);
+    if (!stripes[stripe].threaded)
+      scan_stripe (&stripes[stripe]);  //no thread, so do it here
+  }
+  scan_stripe(&stripes[0]);
+  for (stripe = 1; stripe < stripecount; stripe++) {
+    if (stripes[stripe].threaded)
+      SVSync::JoinThread (stripes[stripe].thread);
+  }
+
+  for (stripe = 0; stripe < stripecount; stripe++) {
+    if (stripe > 0) {
+      for (xindex = 0; xindex <= xext; xindex++) {
+        if (stripes[stripe - 1].ptrline[xindex] != NULL)
+          stitch_edges (stripes[stripe - 1].ptrline[xindex],
+            stripes[stripe].stubs[xindex], &stitch_scan);
+      }
+    }
+    outline_it.add_list_after (&stripes[stripe].outlines);
+  }
+  sort_outlines(&outlines);
+  outline_it.move_to_first ();
+  for (outline_it.mark_cycle_pt (); !outline_it.cycled_list ();
+    outline_it.forward ())
+    out_it->add_after_then_move (outline_it.extract ());
+
+  for (stripe = 0; stripe < stripecount; stripe++) {
+    delete stripes[stripe].scan;
+    delete [] stripes[stripe].ptrline;
+    delete [] stripes[stripe].stubs;
+  }
+  delete [] stripes;
+}
+
+
+/**********************************************************************
+ * scan_stripe
+ *
+ * Thread function to scan the lines of an EDGE_STRIPE.
+ **********************************************************************/
+
+void *scan_stripe(            //scan a stripe
+                  void *arg   //EDGE_STRIPE to scan
+                 ) {
+  EDGE_STRIPE *stripe = (EDGE_STRIPE *) arg;
+
+  scan_block_lines (stripe->t_image, stripe->block, stripe->top,
+    stripe->bottom, stripe->ptrline, stripe->scan);
+  return NULL;
+}
+
+
+/**********************************************************************
+ * make_stubs
+ *
+ * Make a lone vertical crack edge in ptrline wherever line y of the
+ * block changes colour, as line_edges would leave there.
+ **********************************************************************/
+
+void make_stubs(                      //start a stripe
+                IMAGE *t_image,       //threshold image
+                PDBLK *block,         //block in image
+                inT16 y,              //line above stripe
+                CRACKEDGE **ptrline,  //edges in progress
+                EDGE_SCAN *scan       //edge memory
+               ) {
+  ICOORD bleft;                  //bounding box
+  ICOORD tright;
+  inT16 xext;                    //width of block
+  int xindex;                    //index to pixel
+  int colour;                    //of current pixel
+  int prevcolour;                //of previous pixel
+  BLOCK_LINE_IT line_it = block; //line iterator
+  IMAGELINE bwline;              //thresholded line
+
+  block->bounding_box (bleft, tright);
+  xext = tright.x () - bleft.x ();
+  bwline.init (t_image->get_xsize());
+  t_image->get_line (bleft.x (), y, xext, &bwline, 0);
+  make_margins (block, &line_it, bwline.pixels, WHITE_PIX, bleft.x (),
+    tright.x (), y);
+  prevcolour = WHITE_PIX;        //forced plain margin
+  for (xindex = 0; xindex <= xext; xindex++) {
+    colour = xindex < xext ? bwline.pixels[xindex] : WHITE_PIX;
+    if (colour != prevcolour)
+      ptrline[xindex] = v_edge (bleft.x () + xindex, y, colour - prevcolour,
+        NULL, scan);
+    prevcolour = colour;
+  }
+}
+
+
+/**********************************************************************
+ * stitch_edges
+ *
+ * Replace a stub made by make_stubs with the edge in progress it stands
+ * for, from the bottom of the stripe above.
+ **********************************************************************/
+
+void stitch_edges(                    //join stripes
+                  CRACKEDGE *edge,    //edge from above
+                  CRACKEDGE *stub,    //stub standing for it
+                  EDGE_SCAN *scan     //for closed loops
+                 ) {
+  CRACKEDGE *joinpt;             //next to stub in stripe
+
+                                 //the one it steps to
+  joinpt = stub->stepy < 0 ? stub->next : stub->prev;
+  stub->prev->next = stub->next; //cut out stub
+  stub->next->prev = stub->prev;
+  join_edges(edge, joinpt, scan);
+}
+
+
+/**********************************************************************
+ * sort_outlines
+ *
+ * Sort outlines into the order a single scan of the block closes them,
+ * which is by the line below their bottom, top down, then by the right
+ * end of the rightmost step along their bottom.
+ **********************************************************************/
+
+void sort_outlines(                        //put in scan order
+                   C_OUTLINE_LIST *outlines  //outlines to sort
+                  ) {
+  C_OUTLINE_IT it = outlines;    //iterator
+  OUTLINE_ORDER *order;          //keys to sort
+  int count;                     //no of outlines
+  int index;                     //index to order
+  int stepindex;                 //index to steps
+  C_OUTLINE *outline;            //current outline
+  ICOORD pos;                    //position on outline
+  ICOORD step;                   //step from pos
+
+  count = outlines->length ();
+  if (count < 2)
+    return;
+  order = new OUTLINE_ORDER[count];
+  for (index = 0; index < count; index++) {
+    outline = it.extract ();
+    order[index].outline = outline;
+    order[index].y = outline->bounding_box ().bottom () - 1;
+    order[index].x = outline->bounding_box ().left ();
+    pos = outline->start_pos ();
+    for (stepindex = 0; stepindex < outline->pathlength (); stepindex++) {
+      step = outline->step (stepindex);
+      if (step.y () == 0 && pos.y () == order[index].y + 1) {
+        if (pos.x () > order[index].x)
+          order[index].x = pos.x ();
+        if (pos.x () + step.x () > order[index].x)
+          order[index].x = pos.x () + step.x ();
+      }
+      pos += step;
+    }
+    it.forward ();
+  }
+  qsort (order, count, sizeof (OUTLINE_ORDER), outline_order);
+  for (index = 0; index < count; index++)
+    it.add_to_end (order[index].outline);
+  delete [] order;
+}
+
+
+/**********************************************************************
+ * outline_order
+ *
+ * qsort compare function for OUTLINE_ORDERs.
+ **********************************************************************/
+
+int outline_order(                 //compare orders
+                  const void *v1,  //first OUTLINE_ORDER
+                  const void *v2   //second OUTLINE_ORDER
+                 ) {
+  const OUTLINE_ORDER *order1 = (const OUTLINE_ORDER *) v1;
+  const OUTLINE_ORDER *order2 = (const OUTLINE_ORDER *) v2;
+
+  if (order1->y != order2->y)
+    return order2->y - order1->y;  //top down
+  return order1->x - order2->x;
+}
+
+
+/**********************************************************************
+ * get_packed_line
+ *
+ * Get xext pixels of line y of a 1 bpp image, starting at x, packed
+ * PACKED_WORD_BITS to a word with the first pixel in the top bit.
+ * Bits past the end of the line are undefined.
+ **********************************************************************/
+
+void get_packed_line(                  //get packed line
+                     IMAGE *t_image,   //1 bpp image
+                     inT16 x,          //coord to start at
+                     inT16 y,          //line to get
+                     inT16 xext,       //no of pixels to get
+                     uinT64 *words     //packed line
+                    ) {
+  uinT8 *src;                    //source bytes
+  uinT8 *srcend;                 //end of bytes of line
+  int shift;                     //of pixels in first byte
+  int wordindex;                 //index to words
+  int byteindex;                 //index within word
+  uinT64 word;                   //word being packed
+
+  src = t_image->get_raw_line (y) + x / 8;
+  srcend = src + (x % 8 + xext + 7) / 8;
+  shift = x % 8;
+  for (wordindex = 0; wordindex * PACKED_WORD_BITS < xext; wordindex++) {
+    word = 0;
+    for (byteindex = 0; byteindex < 8; byteindex++) {
+      word <<= 8;
+      if (src < srcend)
+        word |= *src++;
+    }
+    if (shift > 0) {
+      word <<= shift;            //make first pixel top
+      if (src < srcend)
+        word |= *src >> (8 - shift);
+    }
+    words[wordindex] = word;
+  }
+}
+
+
+/**********************************************************************
+ * make_packed_margins
+ *
+ * As make_margins, but on a line from get_packed_line, with the margin
+ * always white.
+ **********************************************************************/
+
+void make_packed_margins(                         //get a line
+                         PDBLK *block,            //block in image
+                         BLOCK_LINE_IT *line_it,  //for old style
+                         uinT64 *words,           //pixels to strip
+                         inT16 left,              //block edges
+                         inT16 right,
+                         inT16 y                  //line coord
+                        ) {
+  PB_LINE_IT *lines;
+  ICOORDELT_LIST *segments;      //bits of a line
+  ICOORDELT_IT seg_it;
+  inT32 start;                   //of segment
+  inT16 xext;                    //of segment
+  int xindex;                    //index to pixel
+  int xend;                      //end of margin
+
+  if (block->poly_block () != NULL) {
+    lines = new PB_LINE_IT (block->poly_block ());
+    segments = lines->get_line (y);
+    if (!segments->empty ()) {
+      seg_it.set_to_list (segments);
+      seg_it.mark_cycle_pt ();
+      start = seg_it.data ()->x ();
+      xext = seg_it.data ()->y ();
+      for (xindex = left; xindex < right; xindex = xend) {
+        if (xindex >= start && !seg_it.cycled_list ()) {
+          xend = start + xext;   //skip the segment
+          seg_it.forward ();
+          start = seg_it.data ()->x ();
+          xext = seg_it.data ()->y ();
+        }
+        else {
+          xend = seg_it.cycled_list () || start > right ? right : start;
+          set_white_bits (words, xindex - left, xend - left);
+        }
+      }
+    }
+    else
+      set_white_bits (words, 0, right - left);
+    delete segments;
+    delete lines;
+  }
+  else {
+    start = line_it->get_line (y, xext);
+    if (start > left)
+      set_white_bits (words, 0, MIN (start, right) - left);
+    if (start + xext < right)
+      set_white_bits (words, MAX (start + xext, left) - left, right - left);
+  }
+}
+
+
+/**********************************************************************
+ * set_white_bits
+ *
+ * Set the bits from start to end-1 of a packed line.
+ **********************************************************************/
+
+void set_white_bits(                //set pixels white
+                    uinT64 *words,  //packed line
+                    int start,      //first pixel
+                    int end         //last pixel+1
+                   ) {
+  int startword;                 //word of start
+  int endword;                   //word of end
+  uinT64 startmask;              //bits from start on
+  uinT64 endmask;                //bits before end
+
+  if (start >= end)
+    return;
+  startword = start / PACKED_WORD_BITS;
+  endword = end / PACKED_WORD_BITS;
+  startmask = ~(uinT64) 0 >> (start % PACKED_WORD_BITS);
+  endmask = ~(~(uinT64) 0 >> (end % PACKED_WORD_BITS));
+  if (startword == endword) {
+    words[startword] |= startmask & endmask;
+  }
+  else {
+    words[startword++] |= startmask;
+    while (startword < endword)
+      words[startword++] = ~(uinT64) 0;
+    if (endmask != 0)
+      words[endword] |= endmask;
   }
 }
 
@@ -203,80 +690,234 @@ inT16 y,                         //coord of line
 inT16 xext,                      //width of line
 uinT8 uppercolour,               //start of prev line
 uinT8 * bwpos,                   //thresholded line
-CRACKEDGE ** prevline            //edges in progress
+CRACKEDGE ** prevline,           //edges in progress
+EDGE_SCAN * scan                 //edge memory
 ) {
   int xpos;                      //current x coord
   int xmax;                      //max x coord
-  int colour;                    //of current pixel
+  int upper;                     //colour of prev line
   int prevcolour;                //of previous pixel
   CRACKEDGE *current;            //current h edge
-  CRACKEDGE *newcurrent;         //new h edge
 
   xmax = x + xext;               //max allowable coord
+  upper = uppercolour;
   prevcolour = uppercolour;      //forced plain margin
   current = NULL;                //nothing yet
 
                                  //do each pixel
-  for (xpos = x; xpos < xmax; xpos++, prevline++) {
-    colour = *bwpos++;           //current pixel
-    if (*prevline != NULL) {
+  for (xpos = x; xpos < xmax; xpos++, prevline++)
+    pixel_edges (xpos, y, *bwpos++, prevcolour, upper, current, prevline,
+      scan);
+  line_end_edges (xpos, y, prevcolour, current, prevline, scan);
+}
+
+
+/**********************************************************************
+ * packed_line_edges
+ *
+ * As line_edges, but on a line from get_packed_line. activeline has a
+ * bit set for each entry of prevline that is not NULL, so that the
+ * runs of pixels that neither start nor end any edge can be skipped
+ * a word at a time.
+ **********************************************************************/
+
+void
+packed_line_edges (              //scan for edges
+inT16 x,                         //coord of line start
+inT16 y,                         //coord of line
+inT16 xext,                      //width of line
+uinT8 uppercolour,               //start of prev line
+uinT64 * bwwords,                //packed thresholded line
+CRACKEDGE ** prevline,           //edges in progress
+uinT64 * activeline,             //used entries of prevline
+EDGE_SCAN * scan                 //edge memory
+) {
+  int xindex;                    //index of current pixel
+  int upper;                     //colour of prev line
+  int colour;                    //of current pixel
+  int prevcolour;                //of previous pixel
+  CRACKEDGE *current;            //current h edge
+  uinT64 bit;                    //of xindex in its word
+
+  upper = uppercolour;
+  prevcolour = uppercolour;      //forced plain margin
+  current = NULL;                //nothing yet
+
+  for (xindex = 0; xindex < xext; xindex++) {
+    if (current == NULL && prevcolour == upper) {
+                                 //nothing to do till a change
+      xindex = next_packed_change (bwwords, activeline, xindex, xext,
+        prevcolour);
+      if (xindex >= xext)
+        break;
+    }
+    bit = (uinT64) 1 << (PACKED_WORD_BITS - 1 - xindex % PACKED_WORD_BITS);
+    colour = (bwwords[xindex / PACKED_WORD_BITS] & bit) != 0;
+    pixel_edges (x + xindex, y, colour, prevcolour, upper, current,
+      prevline + xindex, scan);
+    if (prevline[xindex] != NULL)
+      activeline[xindex / PACKED_WORD_BITS] |= bit;
+    else
+      activeline[xindex / PACKED_WORD_BITS] &= ~bit;
+  }
+  line_end_edges (x + xext, y, prevcolour, current, prevline + xext,
+    scan);
+}
+
+
+/**********************************************************************
+ * next_packed_change
+ *
+ * Return the index, from xindex on, of the first pixel of a packed line
+ * that differs from colour or has an edge in progress above it, or
+ * xext if there is none.
+ **********************************************************************/
+
+int next_packed_change(                   //find a change
+                       uinT64 *bwwords,     //packed line
+                       uinT64 *activeline,  //edges in progress
+                       int xindex,          //index to start at
+                       int xext,            //width of line
+                       int colour           //colour of run
+                      ) {
+  int wordindex;                 //index to words
+  uinT64 flip;                   //makes colour 0
+  uinT64 changes;                //bits not in the run
+
+  flip = colour ? ~(uinT64) 0 : 0;
+  wordindex = xindex / PACKED_WORD_BITS;
+  changes = ((bwwords[wordindex] ^ flip) | activeline[wordindex])
+    & (~(uinT64) 0 >> (xindex % PACKED_WORD_BITS));
+  while (changes == 0) {
+    if (++wordindex * PACKED_WORD_BITS >= xext)
+      return xext;
+    changes = (bwwords[wordindex] ^ flip) | activeline[wordindex];
+  }
+  xindex = wordindex * PACKED_WORD_BITS + leading_zeros (changes);
+  return xindex < xext ? xindex : xext;
+}
+
+
+/**********************************************************************
+ * leading_zeros
+ *
+ * Return the number of zero bits above the top set bit of a non-zero
+ * word.
+ **********************************************************************/
+
+int leading_zeros(              //count zero bits
+                  uinT64 word   //non-zero word
+                 ) {
+#ifdef __GNUC__
+  return __builtin_clzll (word);
+#else
+  int count;                     //zeros so far
+
+  for (count = 0; (word & ((uinT64) 1 << (PACKED_WORD_BITS - 1))) == 0;
+    count++)
+    word <<= 1;
+  return count;
+#endif
+}
+
+
+/**********************************************************************
+ * pixel_edges
+ *
+ * Update the edges in progress for one pixel of a line, given the
+ * colours of the pixel before it on the same line and of the previous
+ * line, which are updated for the next pixel.
+ **********************************************************************/
+
+void pixel_edges(                       //do one pixel
+                 int xpos,              //x coord of pixel
+                 inT16 y,               //coord of line
+                 int colour,            //of current pixel
+                 int &prevcolour,       //of previous pixel
+                 int &uppercolour,      //of prev line
+                 CRACKEDGE *&current,   //current h edge
+                 CRACKEDGE **prevline,  //edge in progress here
+                 EDGE_SCAN *scan        //edge memory
+                ) {
+  CRACKEDGE *newcurrent;         //new h edge
+
+  if (*prevline != NULL) {
                                  //changed above
                                  //change colour
-      uppercolour = FLIP_COLOUR (uppercolour);
-      if (colour == prevcolour) {
-        if (colour == uppercolour) {
+    uppercolour = FLIP_COLOUR (uppercolour);
+    if (colour == prevcolour) {
+      if (colour == uppercolour) {
                                  //finish a line
-          join_edges(current, *prevline);
-          current = NULL;        //no edge now
-        }
-        else
+        join_edges(current, *prevline, scan);
+        current = NULL;          //no edge now
+      }
+      else
                                  //new horiz edge
-          current = h_edge (xpos, y, uppercolour - colour, *prevline);
-        *prevline = NULL;        //no change this time
+        current = h_edge (xpos, y, uppercolour - colour, *prevline, scan);
+      *prevline = NULL;          //no change this time
+    }
+    else {
+      if (colour == uppercolour)
+        *prevline = v_edge (xpos, y, colour - prevcolour, *prevline, scan);
+                                 //8 vs 4 connection
+      else if (colour == WHITE_PIX) {
+        join_edges(current, *prevline, scan);
+        current = h_edge (xpos, y, uppercolour - colour, NULL, scan);
+        *prevline = v_edge (xpos, y, colour - prevcolour, current, scan);
       }
       else {
-        if (colour == uppercolour)
-          *prevline = v_edge (xpos, y, colour - prevcolour, *prevline);
-                                 //8 vs 4 connection
-        else if (colour == WHITE_PIX) {
-          join_edges(current, *prevline);
-          current = h_edge (xpos, y, uppercolour - colour, NULL);
-          *prevline = v_edge (xpos, y, colour - prevcolour, current);
-        }
-        else {
-          newcurrent = h_edge (xpos, y, uppercolour - colour, *prevline);
-          *prevline = v_edge (xpos, y, colour - prevcolour, current);
-          current = newcurrent;  //right going h edge
-        }
-        prevcolour = colour;     //remember new colour
+        newcurrent = h_edge (xpos, y, uppercolour - colour, *prevline,
+          scan);
+        *prevline = v_edge (xpos, y, colour - prevcolour, current, scan);
+        current = newcurrent;    //right going h edge
       }
+      prevcolour = colour;       //remember new colour
     }
-    else {
-      if (colour != prevcolour) {
-        *prevline = current =
-          v_edge (xpos, y, colour - prevcolour, current);
-        prevcolour = colour;
-      }
-      if (colour != uppercolour)
-        current = h_edge (xpos, y, uppercolour - colour, current);
-      else
-        current = NULL;          //no edge now
+  }
+  else {
+    if (colour != prevcolour) {
+      *prevline = current =
+        v_edge (xpos, y, colour - prevcolour, current, scan);
+      prevcolour = colour;
     }
+    if (colour != uppercolour)
+      current = h_edge (xpos, y, uppercolour - colour, current, scan);
+    else
+      current = NULL;            //no edge now
   }
+}
+
+
+/**********************************************************************
+ * line_end_edges
+ *
+ * Close off the edges in progress at the right hand end of a line.
+ **********************************************************************/
+
+void line_end_edges(                       //finish a line
+                    int xpos,              //x coord past line
+                    inT16 y,               //coord of line
+                    int prevcolour,        //of last pixel
+                    CRACKEDGE *current,    //current h edge
+                    CRACKEDGE **prevline,  //edge in progress here
+                    EDGE_SCAN *scan        //edge memory
+                   ) {
   if (current != NULL) {
                                  //out of block
     if (*prevline != NULL) {     //got one to join to?
-      join_edges(current, *prevline);
+      join_edges(current, *prevline, scan);
       *prevline = NULL;          //tidy now
     }
     else {
                                  //fake vertical
-      *prevline = v_edge (xpos, y, FLIP_COLOUR(prevcolour)-prevcolour, current);
+      *prevline = v_edge (xpos, y, FLIP_COLOUR(prevcolour)-prevcolour, current,
+        scan);
     }
   }
   else if (*prevline != NULL)
                                  //continue fake
-    *prevline = v_edge (xpos, y, FLIP_COLOUR(prevcolour)-prevcolour, *prevline);
+    *prevline = v_edge (xpos, y, FLIP_COLOUR(prevcolour)-prevcolour, *prevline,
+      scan);
 }
 
 
@@ -291,18 +932,12 @@ h_edge (                         //horizontal edge
 inT16 x,                         //xposition
 inT16 y,                         //y position
 inT8 sign,                       //sign of edge
-CRACKEDGE * join                 //edge to join to
+CRACKEDGE * join,                //edge to join to
+EDGE_SCAN * scan                 //edge memory
 ) {
   CRACKEDGE *newpt;              //return value
 
-  //      check_mem("h_edge",JUSTCHECKS);
-  if (free_cracks != NULL) {
-    newpt = free_cracks;
-    free_cracks = newpt->next;   //get one fast
-  }
-  else {
-    newpt = new CRACKEDGE;
-  }
+  newpt = scan->new_crackedge ();
   newpt->pos.set_y (y + 1);      //coords of pt
   newpt->stepy = 0;              //edge is horizontal
 
@@ -351,17 +986,12 @@ v_edge (                         //vertical edge
 inT16 x,                         //xposition
 inT16 y,                         //y position
 inT8 sign,                       //sign of edge
-CRACKEDGE * join                 //edge to join to
+CRACKEDGE * join,                //edge to join to
+EDGE_SCAN * scan                 //edge memory
 ) {
   CRACKEDGE *newpt;              //return value
 
-  if (free_cracks != NULL) {
-    newpt = free_cracks;
-    free_cracks = newpt->next;   //get one fast
-  }
-  else {
-    newpt = new CRACKEDGE;
-  }
+  newpt = scan->new_crackedge ();
   newpt->pos.set_x (x);          //coords of pt
   newpt->stepx = 0;              //edge is vertical
 
@@ -408,7 +1038,8 @@ CRACKEDGE * join                 //edge to join to
 
 void join_edges(                   //join edge fragments
                 CRACKEDGE *edge1,  //edges to join
-                CRACKEDGE *edge2   //no specific order
+                CRACKEDGE *edge2,  //no specific order
+                EDGE_SCAN *scan    //edge memory
                ) {
   CRACKEDGE *tempedge;           //for exchanging
 
@@ -427,10 +1058,9 @@ void join_edges(                   //join edge fragments
   //              edge2->next,edge2->prev);
   if (edge1->next == edge2) {
                                  //already closed
-    complete_edge(edge1);  //approximate it
-                                 //attach freelist to end
-    edge1->prev->next = free_cracks;
-    free_cracks = edge1;         //and free list
+                                 //approximate it
+    complete_edge(edge1, scan->outline_it, scan->arena);
+    scan->free_loop (edge1);     //and free list
   }
   else {
                                  //update opposite ends
@@ -442,20 +1072,114 @@ void join_edges(                   //join edge fragments
 }
 
 
+inT32 EDGE_SCAN::total_scans = 0;
+inT32 EDGE_SCAN::total_cracks = 0;
+inT32 EDGE_SCAN::total_reused = 0;
+inT32 EDGE_SCAN::total_chunks = 0;
+
 /**********************************************************************
- * free_crackedges
+ * EDGE_SCAN::EDGE_SCAN
  *
- * Really free the CRACKEDGEs by giving them back to delete.
+ * Start a scan with no crack edges, sending outlines to out_it.
+ * The steps of the outlines go in an arena of the scan if wanted.
  **********************************************************************/
 
-void free_crackedges(                  //really free them
-                     CRACKEDGE *start  //start of loop
+EDGE_SCAN::EDGE_SCAN(                      //constructor
+                     C_OUTLINE_IT *out_it  //output iterator
                     ) {
-  CRACKEDGE *current;            //current edge to free
-  CRACKEDGE *next;               //next one to free
+  outline_it = out_it;
+  arena = edges_use_arena ? new OUTLINE_ARENA : NULL;
+  free_cracks = NULL;
+  chunks = NULL;
+  chunk_used = CRACK_CHUNK_SIZE;
+  cracks = 0;
+  reused = 0;
+  chunkcount = 0;
+}
+
+
+/**********************************************************************
+ * EDGE_SCAN::~EDGE_SCAN
+ *
+ * Really free all the CRACKEDGEs of the scan by deleting their chunks.
+ * The arena is closed, and goes when the last of its outlines goes.
+ * Must be called from the thread that made the scan.
+ **********************************************************************/
+
+EDGE_SCAN::~EDGE_SCAN() {  //destructor
+  CRACKEDGE_CHUNK *chunk;        //chunk to free
+
+  while (chunks != NULL) {
+    chunk = chunks;
+    chunks = chunk->next;
+    delete chunk;
+  }
+  total_scans++;
+  total_cracks += cracks;
+  total_reused += reused;
+  total_chunks += chunkcount;
+  if (edges_arena_stats) {
+    tprintf ("Edge scan: %d crack edges + %d reused in %d chunks",
+      cracks, reused, chunkcount);
+    if (arena != NULL)
+      tprintf (", %d outlines in %d bytes in %d chunks",
+        arena->get_outlines (), arena->get_bytes (),
+        arena->get_chunks ());
+    tprintf ("\n");
+  }
+  if (arena != NULL)
+    arena->close ();
+  if (edges_arena_stats) {
+    tprintf ("Edge totals: %d scans, %d crack edges + %d reused"
+      " in %d chunks\n", total_scans, total_cracks, total_reused,
+      total_chunks);
+    tprintf ("Arena totals: %d arenas (%d live), %d outlines"
+      " in %d bytes in %d chunks\n", OUTLINE_ARENA::total_arenas,
+      OUTLINE_ARENA::live_arenas, OUTLINE_ARENA::total_outlines,
+      OUTLINE_ARENA::total_bytes, OUTLINE_ARENA::total_chunks);
+  }
+}
 
-  for (current = start; current != NULL; current = next) {
-    next = current->next;
-    delete current;              //delete them all
+
+/**********************************************************************
+ * EDGE_SCAN::new_crackedge
+ *
+ * Get a CRACKEDGE from the free list, or the chunks of the scan,
+ * making a new chunk if the last is full.
+ **********************************************************************/
+
+CRACKEDGE *EDGE_SCAN::new_crackedge() {  //get an edge
+  CRACKEDGE *newpt;              //return value
+  CRACKEDGE_CHUNK *chunk;        //new chunk
+
+  if (free_cracks != NULL) {
+    newpt = free_cracks;
+    free_cracks = newpt->next;   //get one fast
+    reused++;
+    return newpt;
   }
+  if (chunk_used == CRACK_CHUNK_SIZE) {
+    chunk = new CRACKEDGE_CHUNK;
+    chunk->next = chunks;
+    chunks = chunk;
+    chunk_used = 0;
+    chunkcount++;
+  }
+  cracks++;
+  return &chunks->edges[chunk_used++];
+}
+
+
+/**********************************************************************
+ * EDGE_SCAN::free_loop
+ *
+ * Put a closed loop of CRACKEDGEs on the free list.
+ **********************************************************************/
+
+void EDGE_SCAN::free_loop(                  //reuse edges
+                          CRACKEDGE *start  //start of loop
+                         ) {
+                                 //attach freelist to end
+  start->prev->next = free_cracks;
+  free_cracks = start;           //and free list
 }
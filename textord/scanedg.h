@@ -25,12 +25,81 @@
 #include          "img.h"
 #include          "pdblock.h"
 #include          "crakedge.h"
+#include          "coutln.h"
+
+struct CRACKEDGE_CHUNK;
+
+                                 //state of an edge scan
+class EDGE_SCAN
+{
+  public:
+    EDGE_SCAN(                      //constructor
+              C_OUTLINE_IT *out_it);
+    ~EDGE_SCAN();                //frees all edges
+
+    CRACKEDGE *new_crackedge();  //get an edge
+    void free_loop(                    //reuse edges
+                   CRACKEDGE *start);  //start of loop
+
+    C_OUTLINE_IT *outline_it;    //where outlines go
+    OUTLINE_ARENA *arena;        //steps of outlines or NULL
+
+    static inT32 total_scans;    //scans finished
+    static inT32 total_cracks;   //crack edges from chunks
+    static inT32 total_reused;   //crack edges from freelists
+    static inT32 total_chunks;   //crack edge chunks
+
+  private:
+    CRACKEDGE *free_cracks;      //local freelist
+    CRACKEDGE_CHUNK *chunks;     //chunks of this scan
+    int chunk_used;              //edges used in first chunk
+    inT32 cracks;                //edges from chunks
+    inT32 reused;                //edges from freelist
+    inT32 chunkcount;            //chunks allocated
+};
 
 DLLSYM void block_edges(                      //get edges in a block
                         IMAGE *t_image,       //threshold image
                         PDBLK *block,         //block in image
-                        ICOORD page_tr        //corner of page
+                        ICOORD page_tr,       //corner of page
+                        C_OUTLINE_IT *out_it  //output iterator
                        );
+void scan_block_lines(                     //scan some lines
+                      IMAGE *t_image,      //threshold image
+                      PDBLK *block,        //block in image
+                      inT16 top,           //first line
+                      inT16 bottom,        //last line
+                      CRACKEDGE **ptrline, //edges in progress
+                      EDGE_SCAN *scan      //edge memory
+                     );
+void striped_block_edges(                      //get edges in stripes
+                         IMAGE *t_image,       //threshold image
+                         PDBLK *block,         //block in image
+                         int stripecount,      //no of stripes
+                         C_OUTLINE_IT *out_it  //output iterator
+                        );
+void *scan_stripe(            //scan a stripe
+                  void *arg   //EDGE_STRIPE to scan
+                 );
+void make_stubs(                      //start a stripe
+                IMAGE *t_image,       //threshold image
+                PDBLK *block,         //block in image
+                inT16 y,              //line above stripe
+                CRACKEDGE **ptrline,  //edges in progress
+                EDGE_SCAN *scan       //edge memory
+               );
+void stitch_edges(                    //join stripes
+                  CRACKEDGE *edge,    //edge from above
+                  CRACKEDGE *stub,    //stub standing for it
+                  EDGE_SCAN *scan     //for closed loops
+                 );
+void sort_outlines(                          //put in scan order
+                   C_OUTLINE_LIST *outlines  //outlines to sort
+                  );
+int outline_order(                 //compare orders
+                  const void *v1,  //first OUTLINE_ORDER
+                  const void *v2   //second OUTLINE_ORDER
+                 );
 void make_margins(                         //get a line
                   PDBLK *block,            //block in image
                   BLOCK_LINE_IT *line_it,  //for old style
@@ -40,6 +109,26 @@ void make_margins(                         //get a line
                   inT16 right,
                   inT16 y                  //line coord
                  );
+void get_packed_line(                  //get packed line
+                     IMAGE *t_image,   //1 bpp image
+                     inT16 x,          //coord to start at
+                     inT16 y,          //line to get
+                     inT16 xext,       //no of pixels to get
+                     uinT64 *words     //packed line
+                    );
+void make_packed_margins(                         //get a line
+                         PDBLK *block,            //block in image
+                         BLOCK_LINE_IT *line_it,  //for old style
+                         uinT64 *words,           //pixels to strip
+                         inT16 left,              //block edges
+                         inT16 right,
+                         inT16 y                  //line coord
+                        );
+void set_white_bits(                //set pixels white
+                    uinT64 *words,  //packed line
+                    int start,      //first pixel
+                    int end         //last pixel+1
+                   );
 void whiteout_block(                 //clean it
                     IMAGE *t_image,  //threshold image
                     PDBLK *block     //block in image
@@ -50,25 +139,64 @@ inT16 y,                         //coord of line
 inT16 xext,                      //width of line
 uinT8 uppercolour,               //start of prev line
 uinT8 * bwpos,                   //thresholded line
-CRACKEDGE ** prevline            //edges in progress
+CRACKEDGE ** prevline,           //edges in progress
+EDGE_SCAN * scan                 //edge memory
+);
+void packed_line_edges (         //scan for edges
+inT16 x,                         //coord of line start
+inT16 y,                         //coord of line
+inT16 xext,                      //width of line
+uinT8 uppercolour,               //start of prev line
+uinT64 * bwwords,                //packed thresholded line
+CRACKEDGE ** prevline,           //edges in progress
+uinT64 * activeline,             //used entries of prevline
+EDGE_SCAN * scan                 //edge memory
 );
+int next_packed_change(                   //find a change
+                       uinT64 *bwwords,     //packed line
+                       uinT64 *activeline,  //edges in progress
+                       int xindex,          //index to start at
+                       int xext,            //width of line
+                       int colour           //colour of run
+                      );
+int leading_zeros(              //count zero bits
+                  uinT64 word   //non-zero word
+                 );
+void pixel_edges(                       //do one pixel
+                 int xpos,              //x coord of pixel
+                 inT16 y,               //coord of line
+                 int colour,            //of current pixel
+                 int &prevcolour,       //of previous pixel
+                 int &uppercolour,      //of prev line
+                 CRACKEDGE *&current,   //current h edge
+                 CRACKEDGE **prevline,  //edge in progress here
+                 EDGE_SCAN *scan        //edge memory
+                );
+void line_end_edges(                       //finish a line
+                    int xpos,              //x coord past line
+                    inT16 y,               //coord of line
+                    int prevcolour,        //of last pixel
+                    CRACKEDGE *current,    //current h edge
+                    CRACKEDGE **prevline,  //edge in progress here
+                    EDGE_SCAN *scan        //edge memory
+                   );
 CRACKEDGE *h_edge (              //horizontal edge
 inT16 x,                         //xposition
 inT16 y,                         //y position
 inT8 sign,                       //sign of edge
-CRACKEDGE * join                 //edge to join to
+CRACKEDGE * join,                //edge to join to
+EDGE_SCAN * scan                 //edge memory
 );
 CRACKEDGE *v_edge (              //vertical edge
 inT16 x,                         //xposition
 inT16 y,                         //y position
 inT8 sign,                       //sign of edge
-CRACKEDGE * join                 //edge to join to
+CRACKEDGE * join,                //edge to join to
+EDGE_SCAN * scan                 //edge memory
 );
 void join_edges(                   //join edge fragments
                 CRACKEDGE *edge1,  //edges to join
-                CRACKEDGE *edge2   //no specific order
+                CRACKEDGE *edge2,  //no specific order
+                EDGE_SCAN *scan    //edge memory
                );
-void free_crackedges(                  //really free them
-                     CRACKEDGE *start  //start of loop
-                    );
 #endif
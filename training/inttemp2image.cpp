@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////
+// File:        inttemp2image.cpp
+// Description: Convert inttemp files to mappable template images.
+// Created:     Sat Oct 17 2026
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////
+
+// Given a unicharset and the inttemp file built for it, this program writes
+// a template image that the classifier maps read-only and uses in place,
+// so that processes sharing the image also share one copy of the class
+// pruners and proto sets. The image may replace the inttemp file in
+// tessdata, but it is only readable on machines of the same byte order.
+
+#include <stdio.h>
+
+#include "intproto.h"
+#include "globals.h"
+#include "freelist.h"
+
+int main(int argc, char** argv) {
+  if (argc != 4) {
+    printf("Usage: %s unicharset_file inttemp_file image_file\n", argv[0]);
+    return 1;
+  }
+  if (!unicharset.load_from_file(argv[1])) {
+    printf("Unable to load unicharset file %s\n", argv[1]);
+    return 1;
+  }
+  FILE* in = fopen(argv[2], "rb");
+  if (in == NULL) {
+    printf("Unable to open inttemp file %s\n", argv[2]);
+    return 1;
+  }
+  INT_TEMPLATES templates = ReadIntTemplates(in, TRUE);
+  fclose(in);
+
+  FILE* out = fopen(argv[3], "wb");
+  if (out == NULL) {
+    printf("Unable to create image file %s\n", argv[3]);
+    return 1;
+  }
+  printf("Writing template image '%s'\n", argv[3]);
+  WriteIntTemplatesImage(out, templates, unicharset);
+  fclose(out);
+  free_int_templates(templates);
+  return 0;
+}
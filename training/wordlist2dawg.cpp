@@ -18,7 +18,8 @@
 ///////////////////////////////////////////////////////////////////////
 
 // Given a file that contains a list of words (one word per line) this program
-// generates the corresponding squished DAWG file.
+// generates the corresponding squished DAWG file. With -n it converts a
+// squished DAWG file to the native format that tesseract maps in place.
 
 #include <stdio.h>
 
@@ -60,10 +61,19 @@ int main(int argc, char** argv) {
   } else if (argc == 4 && strcmp(argv[1], "-t") == 0) {
     EDGE_ARRAY words = read_squished_dawg(argv[3]);
     check_for_words(words, argv[2]);
-    memfree(words);
+    free_squished_dawg(words);
+    return 0;
+  } else if (argc == 4 && strcmp(argv[1], "-n") == 0) {
+    // Convert a squished DAWG to the native format that is mapped in place.
+    inT32 num_edges;
+    EDGE_ARRAY words = read_squished_dawg(argv[2], &num_edges);
+    printf("Writing native DAWG file, '%s'\n", argv[3]);
+    write_native_dawg(argv[3], words, num_edges);
+    free_squished_dawg(words);
     return 0;
   }
 
   printf("Usage: %s [-t] word_list_file dawg_file\n", argv[0]);
+  printf("       %s -n dawg_file native_dawg_file\n", argv[0]);
   return 1;
 }
@@ -99,12 +99,21 @@ void SVSync::StartProcess(const char* executable, const char* args) {
 
 SVSemaphore::SVSemaphore() {
 #ifdef WIN32
-  semaphore_ = CreateSemaphore(0, 0, 10, 0);
+  // No limit on the count, as with sem_init.
+  semaphore_ = CreateSemaphore(0, 0, MAXLONG, 0);
 #else
   sem_init(&semaphore_, 0, 0);
 #endif
 }
 
+SVSemaphore::~SVSemaphore() {
+#ifdef WIN32
+  CloseHandle(semaphore_);
+#else
+  sem_destroy(&semaphore_);
+#endif
+}
+
 void SVSemaphore::Signal() {
 #ifdef WIN32
   ReleaseSemaphore(semaphore_, 1, NULL);
@@ -146,21 +155,45 @@ void SVMutex::Unlock() {
 }
 
 // Create new thread.
+bool SVSync::StartThread(void *(*func)(void*), void* arg) {
+  SVThread thread;
+  if (!StartJoinableThread(func, arg, &thread))
+    return false;
+  // Nobody waits for the thread, so let it go as soon as it ends.
+#ifdef WIN32
+  CloseHandle(thread);
+#else
+  pthread_detach(thread);
+#endif
+  return true;
+}
 
-void SVSync::StartThread(void *(*func)(void*), void* arg) {
+// Create new thread that is joined later.
+bool SVSync::StartJoinableThread(void *(*func)(void*), void* arg,
+                                 SVThread* thread) {
 #ifdef WIN32
   LPTHREAD_START_ROUTINE f = (LPTHREAD_START_ROUTINE) func;
   DWORD threadid;
-  HANDLE newthread = CreateThread(
+  *thread = CreateThread(
   NULL,          // default security attributes
   0,             // use default stack size
   f,             // thread function
   arg,           // argument to thread function
   0,             // use default creation flags
   &threadid);    // returns the thread identifier
+  return *thread != NULL;
+#else
+  return pthread_create(thread, NULL, func, arg) == 0;
+#endif
+}
+
+// Wait for a joinable thread to end.
+void SVSync::JoinThread(SVThread thread) {
+#ifdef WIN32
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
 #else
-  pthread_t helper;
-  pthread_create(&helper, NULL, func, arg);
+  pthread_join(thread, NULL);
 #endif
 }
 
@@ -44,11 +44,24 @@
 #define MIN(a, b)  ((a < b) ? a : b)
 #endif
 
+#ifdef WIN32
+typedef HANDLE SVThread;
+#else
+typedef pthread_t SVThread;
+#endif
+
 // The SVSync class provides functionality for Thread & Process Creation
 class SVSync {
  public:
-  // Create new thread.
-  static void StartThread(void *(*func)(void*), void* arg);
+  // Create new thread that nobody waits for. Returns false if the thread
+  // could not be started, in which case the caller must do the work.
+  static bool StartThread(void *(*func)(void*), void* arg);
+  // Create new thread that must be waited for with JoinThread. Returns
+  // false if the thread could not be started.
+  static bool StartJoinableThread(void *(*func)(void*), void* arg,
+                                  SVThread* thread);
+  // Waits for a thread from StartJoinableThread to end.
+  static void JoinThread(SVThread thread);
   // Signals a thread to exit.
   static void ExitThread();
   // Starts a new process.
@@ -61,6 +74,8 @@ class SVSemaphore {
  public:
   // Sets up a semaphore.
   SVSemaphore();
+  // Frees the semaphore, which nobody may be waiting on.
+  ~SVSemaphore();
   // Signal a semaphore.
   void Signal();
   // Wait on a semaphore.
@@ -55,6 +55,9 @@ make_int_var (num_seg_states, 30, make_seg_states,
 
 make_float_var (worst_state, 1, make_worst_state,
 9, 9, set_worst_state, "Worst segmentation state");
+
+BOOL_VAR (segment_search_stats, FALSE,
+          "Print the states looked at by each segmentation search");
 /**/
 /*----------------------------------------------------------------------
           F u n c t i o n s
@@ -172,6 +175,19 @@ void delete_search(SEARCH_RECORD *the_search) {
 
   record_search_status (the_search->num_states,
     the_search->before_best, closeness);
+  if (segment_search_stats)
+    cprintf ("Search: %d joints, %ld states evaluated, %d pushed,"
+             " %d popped, %d closed in %d slots (grown %d times),"
+             " %.2f probes per lookup\n",
+             the_search->num_joints, the_search->num_states,
+             num_pushed - the_search->pushed_at_start,
+             num_popped - the_search->popped_at_start,
+             the_search->closed_states->used,
+             the_search->closed_states->size,
+             the_search->closed_states->grown,
+             the_search->closed_states->lookups > 0 ?
+             (float) the_search->closed_states->probes /
+             the_search->closed_states->lookups : 0.0f);
 
   free_state (the_search->first_state);
   free_state (the_search->best_state);
@@ -449,6 +465,8 @@ SEARCH_RECORD *new_search(CHUNKS_RECORD *chunks_record,
   this_search->num_joints = num_joints;
   this_search->num_states = 0;
   this_search->before_best = 0;
+  this_search->pushed_at_start = num_pushed;
+  this_search->popped_at_start = num_popped;
 
   return (this_search);
 }
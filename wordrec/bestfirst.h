@@ -53,6 +53,8 @@ typedef struct
   int num_joints;
   long num_states;
   long before_best;
+  int pushed_at_start;
+  int popped_at_start;
   A_CHOICE *best_choice;
   A_CHOICE *raw_choice;
 } SEARCH_RECORD;
@@ -177,6 +177,7 @@ SEAM *attempt_blob_chop(TWERD *word, inT32 blob_number, SEAMS seam_list) {
   TBLOB *last_blob;
   TBLOB *next_blob;
   inT16 x;
+  int pool_mark;                 /* Points before the chop */
 
   if (first_pass)
     chops_attempted1++;
@@ -191,6 +192,7 @@ SEAM *attempt_blob_chop(TWERD *word, inT32 blob_number, SEAMS seam_list) {
   }
   next_blob = blob->next;
 
+  pool_mark = edgept_pool_mark ();
   if (repair_unchopped_blobs)
     preserve_outline_tree (blob->outlines);
   other_blob = newblob ();       /* Make new blob */
@@ -236,8 +238,11 @@ SEAM *attempt_blob_chop(TWERD *word, inT32 blob_number, SEAMS seam_list) {
       oldblob(other_blob);
     }
 
-    if (repair_unchopped_blobs)
+    if (repair_unchopped_blobs) {
       restore_outline_tree (blob->outlines);
+                                 /* All new points are gone */
+      edgept_pool_rollback(pool_mark);
+    }
     return (NULL);
   }
   return (seam);
@@ -422,6 +427,7 @@ CHOICES_LIST chop_word_main(register TWERD *word,
   static STATE chop_states[64];  //in between states
 
   state_count = 0;
+  reset_edgept_pool();
   set_null_choice(best_choice);
   set_null_choice(raw_choice);
 
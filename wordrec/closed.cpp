@@ -37,45 +37,107 @@
 /*----------------------------------------------------------------------
               V a r i a b l e s
 ----------------------------------------------------------------------*/
-#define TABLE_SIZE 2000
+#define TABLE_SIZE 2048          /* Starting slots, a power of 2 */
 HASH_TABLE global_hash = NULL;
 
+/*----------------------------------------------------------------------
+              M a c r o s
+----------------------------------------------------------------------*/
+/**********************************************************************
+ * hash_slot
+ *
+ * Return the first slot to try for a state. Both halves of the state
+ * are mixed in, as long words only differ in part1.
+ **********************************************************************/
+#define hash_slot(state_table,state)  \
+(state_hash (state) & ((state_table)->size - 1))
+
 /*----------------------------------------------------------------------
               F u n c t i o n s
 ----------------------------------------------------------------------*/
+/**********************************************************************
+ * state_hash
+ *
+ * Mix the two halves of a state into one word.
+ **********************************************************************/
+static unsigned int state_hash(STATE *state) { 
+  unsigned int h;
+
+  h = state->part2 * 0x9e3779b1u ^ state->part1 * 0x85ebca77u;
+  return (h ^ (h >> 16));
+}
+
+
+/**********************************************************************
+ * clear_slots
+ *
+ * Mark every slot of a hash table empty.
+ **********************************************************************/
+static void clear_slots(HASH_TABLE state_table) { 
+  int x;
+
+  for (x = 0; x < state_table->size; x++) {
+    state_table->states[x].part1 = NO_STATE;
+    state_table->states[x].part2 = NO_STATE;
+  }
+  state_table->used = 0;
+}
+
+
+/**********************************************************************
+ * grow_hash_table
+ *
+ * Double the number of slots in a hash table, keeping its states.
+ **********************************************************************/
+static void grow_hash_table(HASH_TABLE state_table) { 
+  STATE *old_states;
+  int old_size;
+  int x;
+
+  old_states = state_table->states;
+  old_size = state_table->size;
+  state_table->size *= 2;
+  state_table->states =
+    (STATE *) memalloc (state_table->size * sizeof (STATE));
+  clear_slots(state_table);
+  for (x = 0; x < old_size; x++) {
+    if (old_states[x].part1 != (uinT32) NO_STATE ||
+        old_states[x].part2 != (uinT32) NO_STATE)
+      hash_add(state_table, &old_states[x]);
+  }
+  memfree(old_states);
+  state_table->grown++;
+}
+
+
 /**********************************************************************
  * hash_add
  *
  * Look in the hash table for a particular value. If it is not there
- * then add it.
+ * then add it. The table is doubled when it is half full.
  **********************************************************************/
 int hash_add(HASH_TABLE state_table, STATE *state) { 
   int x;
-  int i = 0;
-  int table_limit = TABLE_SIZE;
 
-  x = state->part2 % table_limit;
-  while (i < table_limit) {
-    assert (0 <= x && x < table_limit);
+  if ((state_table->used + 1) * 2 > state_table->size)
+    grow_hash_table(state_table);
+  x = hash_slot (state_table, state);
+  while (TRUE) {
     /* Found it */
-    if ((state_table[x].part2 == state->part2) &&
-    (state_table[x].part1 == state->part1)) {
+    if ((state_table->states[x].part2 == state->part2) &&
+    (state_table->states[x].part1 == state->part1)) {
       return (FALSE);
     }
     /* Not in table */
-    else if (state_table[x].part1 == NO_STATE) {
-      state_table[x].part2 = state->part2;
-      state_table[x].part1 = state->part1;
+    else if (state_table->states[x].part1 == NO_STATE) {
+      state_table->states[x].part2 = state->part2;
+      state_table->states[x].part1 = state->part1;
+      state_table->used++;
       return (TRUE);
     }
-    i++;
-    if (++x >= table_limit)
+    if (++x >= state_table->size)
       x = 0;
   }
-  cprintf("warning: hash table is full");
-  
-  abort(); 
-  return 0;
 }
 
 
@@ -87,50 +149,63 @@ int hash_add(HASH_TABLE state_table, STATE *state) {
  **********************************************************************/
 int hash_lookup(HASH_TABLE state_table, STATE *state) { 
   int x;
-  int i = 0;
-  int table_limit = TABLE_SIZE;
 
-  x = state->part2 % table_limit;
-  while (i < table_limit) {
-    assert (0 <= x && x < table_limit);
+  state_table->lookups++;
+  x = hash_slot (state_table, state);
+  while (TRUE) {
+    state_table->probes++;
     /* Found it */
-    if ((state_table[x].part2 == state->part2) &&
-    (state_table[x].part1 == state->part1)) {
+    if ((state_table->states[x].part2 == state->part2) &&
+    (state_table->states[x].part1 == state->part1)) {
       return (TRUE);
     }
     /* Not in table */
-    else if (state_table[x].part1 == NO_STATE) {
+    else if (state_table->states[x].part1 == NO_STATE) {
       return (FALSE);
     }
-
-    i++;
-    if (++x >= table_limit)
+    if (++x >= state_table->size)
       x = 0;
   }
-  cprintf ("warning: fell off end of hash table  (%x) %x\n",
-    state->part2, state->part2 % table_limit);
-  abort(); 
-  return 0;
 }
 
 
 /**********************************************************************
  * new_hash_table
  *
- * Create and initialize a hash table.
+ * Create and initialize a hash table. The table of the last search is
+ * used again, cut back to its starting size if it grew.
  **********************************************************************/
 HASH_TABLE new_hash_table() { 
   HASH_TABLE ht;
-  int x;
 
-  if (global_hash == NULL)
-    ht = (HASH_TABLE) memalloc (TABLE_SIZE * sizeof (STATE));
-  else
+  if (global_hash == NULL) {
+    ht = (HASH_TABLE) memalloc (sizeof (CLOSED_TABLE));
+    ht->size = TABLE_SIZE;
+    ht->states = (STATE *) memalloc (TABLE_SIZE * sizeof (STATE));
+  }
+  else {
     ht = global_hash;
-
-  for (x = 0; x < TABLE_SIZE; x++) {
-    ht[x].part1 = NO_STATE;
-    ht[x].part2 = NO_STATE;
+    global_hash = NULL;
+    if (ht->size > TABLE_SIZE) {
+      memfree (ht->states);
+      ht->size = TABLE_SIZE;
+      ht->states = (STATE *) memalloc (TABLE_SIZE * sizeof (STATE));
+    }
   }
+  clear_slots(ht);
+  ht->grown = 0;
+  ht->lookups = 0;
+  ht->probes = 0;
   return (ht);
 }
+
+
+/**********************************************************************
+ * delete_hash_table
+ *
+ * Free the memory taken by a hash table.
+ **********************************************************************/
+void delete_hash_table(HASH_TABLE state_table) { 
+  memfree (state_table->states);
+  memfree(state_table);
+}
@@ -35,7 +35,17 @@
 /*----------------------------------------------------------------------
               T y p e s
 ----------------------------------------------------------------------*/
-typedef STATE *HASH_TABLE;
+typedef struct
+{
+  STATE *states;                 /* Slots, NO_STATE when empty */
+  int size;                      /* Number of slots, a power of 2 */
+  int used;                      /* Slots holding a state */
+  int grown;                     /* Times doubled in this search */
+  long lookups;                  /* Calls to hash_lookup */
+  long probes;                   /* Slots looked at by them */
+} CLOSED_TABLE;
+
+typedef CLOSED_TABLE *HASH_TABLE;
 #define NO_STATE ~0
 
 /*----------------------------------------------------------------------
@@ -49,7 +59,7 @@ extern HASH_TABLE global_hash;
 /**********************************************************************
  * free_hash_table
  *
- * Free the memory taken by a state variable.
+ * Finish with a hash table. It is kept for the next search.
  **********************************************************************/
 #define free_hash_table(table) \
 	global_hash = table
@@ -62,4 +72,6 @@ int hash_add(HASH_TABLE state_table, STATE *state);
 int hash_lookup(HASH_TABLE state_table, STATE *state); 
 
 HASH_TABLE new_hash_table(); 
+
+void delete_hash_table(HASH_TABLE state_table); 
 #endif
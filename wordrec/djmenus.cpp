@@ -95,14 +95,15 @@ void init_dj_debug() {
       handle_menu_19);
     #endif
     #endif
-    InitAdaptiveClassifierVars(); 
-    InitMFOutlineVars(); 
-    InitNormProtoVars(); 
-    InitIntProtoVars(); 
-    InitIntegerMatcherVars(); 
-    InitSpeckleVars(); 
-    InitStopperVars(); 
   }
+  /* Install the variables on every init, as end_recog frees them */
+  InitAdaptiveClassifierVars();
+  InitMFOutlineVars();
+  InitNormProtoVars();
+  InitIntProtoVars();
+  InitIntegerMatcherVars();
+  InitSpeckleVars();
+  InitStopperVars();
 }
 
 
@@ -29,6 +29,9 @@
 #include "freelist.h"
 #include "callcpp.h"
 #include "blobs.h"
+#include "adaptmatch.h"
+#include "varable.h"
+#include "tprintf.h"
 
 /*----------------------------------------------------------------------
               T y p e s
@@ -40,16 +43,51 @@ typedef struct _MATCH_
   LIST rating;
 } MATCH;
 
+typedef struct _BLOB_MATCH_
+{
+  unsigned int hash;             /* Hash of the blob outlines */
+  unsigned int check;            /* Second hash of the same */
+  int width;                     /* Bounds of the blob, less its x */
+  int top;
+  int bottom;
+  float ascrise;                 /* Row the blob was matched in */
+  float descdrop;
+  int changes;                   /* AdaptedTemplatesChanges when matched */
+  int last_used;                 /* Clock of last put or hit */
+  LIST rating;                   /* NULL if slot is free */
+} BLOB_MATCH;
+
 /*----------------------------------------------------------------------
               V a r i a b l e s
 ----------------------------------------------------------------------*/
 MATCH *match_table;
+int match_table_size = 0;
+int match_table_used = 0;
 //?int   missed_count = 0;
 
+BLOB_MATCH *blob_cache = NULL;   /* Matches kept between words */
+int blob_cache_slots = 0;        /* Size of blob_cache */
+int blob_cache_used = 0;         /* Slots with a rating */
+int blob_cache_clock = 0;        /* Count of puts and hits */
+float match_ascrise = 0.0f;      /* Row of the current word */
+float match_descdrop = 0.0f;
+
+int blob_cache_hits = 0;
+int blob_cache_misses = 0;
+int blob_cache_stale = 0;
+int blob_cache_evictions = 0;
+
+INT_VAR (blob_cache_size, 8192,
+         "Most blob matches kept between words, 0 for none");
+BOOL_VAR (blob_cache_debug, FALSE,
+          "Print blob cache counts at exit");
+
 /*----------------------------------------------------------------------
               M a c r o s
 ----------------------------------------------------------------------*/
-#define NUM_MATCH_ENTRIES 500    /* Entries in match_table */
+#define NUM_MATCH_ENTRIES 500    /* Starting entries in match_table */
+#define MIN_CACHE_SLOTS   1024   /* Starting slots in blob_cache */
+#define CACHE_PROBES      8      /* Slots tried for a blob */
 
 /**********************************************************************
  * blank_entry
@@ -61,6 +99,317 @@ MATCH *match_table;
 #define blank_entry(match_table,x)  \
 (! (match_table[x].topleft | match_table[x].botright))
 
+/**********************************************************************
+ * add_to_hash
+ *
+ * Mix a value into the pair of blob hashes.
+ **********************************************************************/
+
+#define add_to_hash(hash,check,value)  \
+{                                      \
+  hash = (hash ^ (unsigned int) (value)) * 16777619u;  \
+  check = (check + (unsigned int) (value)) * 0x5bd1e995u;  \
+  check ^= check >> 15;                \
+}
+
+/**********************************************************************
+ * pack_point
+ *
+ * Pack an x and y of a blob into one value to hash.
+ **********************************************************************/
+
+#define pack_point(x,y)  \
+(((unsigned int) (x) & 0xffff) | ((unsigned int) (y) << 16))
+
+/*----------------------------------------------------------------------
+          Private Function Code
+----------------------------------------------------------------------*/
+/**********************************************************************
+ * clear_match_table
+ *
+ * Free the ratings in the match table and mark every entry blank.
+ **********************************************************************/
+static void clear_match_table() {
+  int x;
+
+  for (x = 0; x < match_table_size; x++) {
+    if ((!blank_entry (match_table, x)) && match_table[x].rating)
+      destroy_nodes (match_table[x].rating, free_choice);
+    match_table[x].topleft = 0;
+    match_table[x].botright = 0;
+    match_table[x].rating = NULL;
+  }
+  match_table_used = 0;
+}
+
+
+/**********************************************************************
+ * add_match_entry
+ *
+ * Put an entry in the match table, which must have a blank entry.
+ **********************************************************************/
+static void add_match_entry(unsigned int topleft,
+                            unsigned int botright,
+                            LIST rating) {
+  int x;
+
+  x = (topleft * botright) % match_table_size;
+  while (!blank_entry (match_table, x)) {
+    if (++x >= match_table_size)
+      x = 0;
+  }
+  match_table[x].topleft = topleft;
+  match_table[x].botright = botright;
+  match_table[x].rating = rating;
+  match_table_used++;
+}
+
+
+/**********************************************************************
+ * grow_match_table
+ *
+ * Double the size of the match table, keeping its entries.
+ **********************************************************************/
+static void grow_match_table() {
+  MATCH *old_table;
+  int old_size;
+  int x;
+
+  old_table = match_table;
+  old_size = match_table_size;
+  match_table_size *= 2;
+  match_table = (MATCH *) memalloc (sizeof (MATCH) * match_table_size);
+  for (x = 0; x < match_table_size; x++) {
+    match_table[x].topleft = 0;
+    match_table[x].botright = 0;
+    match_table[x].rating = NULL;
+  }
+  match_table_used = 0;
+  for (x = 0; x < old_size; x++) {
+    if (!blank_entry (old_table, x))
+      add_match_entry (old_table[x].topleft, old_table[x].botright,
+        old_table[x].rating);
+  }
+  memfree(old_table);
+}
+
+
+/**********************************************************************
+ * hash_outlines
+ *
+ * Add the points of a list of outlines and their children to the blob
+ * hashes, with x taken from origin. Everything that make_ed_blob reads
+ * from them is included, so blobs with the same hashes have the same
+ * shape.
+ **********************************************************************/
+static void hash_outlines(TESSLINE *outline,
+                          int origin,
+                          unsigned int *hash,
+                          unsigned int *check) {
+  EDGEPT *edgept;
+  unsigned int h;
+  unsigned int c;
+
+  h = *hash;
+  c = *check;
+  for (; outline != NULL; outline = outline->next) {
+    edgept = outline->loop;
+    if (edgept != NULL) {
+      do {
+        add_to_hash (h, c, pack_point (edgept->pos.x - origin,
+                                       edgept->pos.y));
+        add_to_hash (h, c, pack_point (edgept->vec.x, edgept->vec.y));
+        add_to_hash (h, c, edgept->flags[0]);
+        edgept = edgept->next;
+      }
+      while (edgept != outline->loop);
+    }
+    add_to_hash (h, c, 0x7fffffff);  /* End of outline */
+    if (outline->child != NULL)
+      hash_outlines (outline->child, origin, &h, &c);
+  }
+  *hash = h;
+  *check = c;
+}
+
+
+/**********************************************************************
+ * find_blob_match
+ *
+ * Return the blob cache slot holding a blob of this shape, or NULL if
+ * none. Matches made before the adapted templates last changed are freed.
+ **********************************************************************/
+static BLOB_MATCH *find_blob_match(const BLOB_MATCH *key) {
+  unsigned int hash;
+  BLOB_MATCH *entry;
+  int probe;
+
+  if (blob_cache == NULL)
+    return NULL;
+  hash = key->hash;
+  for (probe = 0; probe < CACHE_PROBES; probe++) {
+    entry = &blob_cache[(hash + probe) & (blob_cache_slots - 1)];
+    if (entry->rating != NULL && entry->changes != AdaptedTemplatesChanges) {
+      destroy_nodes (entry->rating, free_choice);
+      entry->rating = NULL;
+      blob_cache_used--;
+      blob_cache_stale++;
+    }
+    if (entry->rating != NULL && entry->hash == hash &&
+        entry->check == key->check && entry->width == key->width &&
+        entry->top == key->top && entry->bottom == key->bottom &&
+        entry->ascrise == key->ascrise && entry->descdrop == key->descdrop)
+      return entry;
+  }
+  return NULL;
+}
+
+
+/**********************************************************************
+ * resize_blob_cache
+ *
+ * Make the blob cache the given number of slots, keeping the matches
+ * that are still current and fit.
+ **********************************************************************/
+static void resize_blob_cache(int slots) {
+  BLOB_MATCH *old_cache;
+  BLOB_MATCH *entry;
+  int old_slots;
+  int x;
+  int probe;
+
+  old_cache = blob_cache;
+  old_slots = blob_cache_slots;
+  blob_cache = (BLOB_MATCH *) memalloc (sizeof (BLOB_MATCH) * slots);
+  blob_cache_slots = slots;
+  blob_cache_used = 0;
+  for (x = 0; x < slots; x++)
+    blob_cache[x].rating = NULL;
+  for (x = 0; x < old_slots; x++) {
+    if (old_cache[x].rating == NULL)
+      continue;
+    for (probe = 0; probe < CACHE_PROBES; probe++) {
+      entry = &blob_cache[(old_cache[x].hash + probe) & (slots - 1)];
+      if (entry->rating == NULL)
+        break;
+    }
+    if (probe < CACHE_PROBES &&
+        old_cache[x].changes == AdaptedTemplatesChanges) {
+      *entry = old_cache[x];
+      blob_cache_used++;
+    }
+    else
+      destroy_nodes (old_cache[x].rating, free_choice);
+  }
+  if (old_cache != NULL)
+    memfree(old_cache);
+}
+
+
+/**********************************************************************
+ * put_blob_match
+ *
+ * Keep a copy of the ratings of a blob in the blob cache. The cache
+ * starts with MIN_CACHE_SLOTS slots, or fewer if blob_cache_size is
+ * smaller, and doubles whenever a put finds it half full, as long as it
+ * stays within blob_cache_size slots. Once it can grow no more, a blob
+ * whose CACHE_PROBES slots are all taken replaces the least recently
+ * used of them.
+ **********************************************************************/
+static void put_blob_match(const BLOB_MATCH *key, CHOICES ratings) {
+  BLOB_MATCH *entry;
+  BLOB_MATCH *oldest;
+  int probe;
+  int slots;
+
+  if (ratings == NIL)
+    return;
+  entry = find_blob_match (key);
+  if (entry != NULL) {
+    destroy_nodes (entry->rating, free_choice);
+    entry->rating = copy_choices (ratings);
+    entry->last_used = ++blob_cache_clock;
+    return;
+  }
+  if (blob_cache == NULL) {
+    for (slots = MIN_CACHE_SLOTS;
+         slots > blob_cache_size && slots > CACHE_PROBES; slots /= 2);
+    resize_blob_cache(slots);
+  }
+  else if (blob_cache_used * 2 >= blob_cache_slots &&
+           blob_cache_slots * 2 <= blob_cache_size)
+    resize_blob_cache (blob_cache_slots * 2);
+  oldest = NULL;
+  for (probe = 0; probe < CACHE_PROBES; probe++) {
+    entry = &blob_cache[(key->hash + probe) & (blob_cache_slots - 1)];
+    if (entry->rating == NULL)
+      break;
+    if (oldest == NULL || entry->last_used < oldest->last_used)
+      oldest = entry;
+  }
+  if (probe == CACHE_PROBES) {
+    entry = oldest;
+    destroy_nodes (entry->rating, free_choice);
+    blob_cache_used--;
+    blob_cache_evictions++;
+  }
+  *entry = *key;
+  entry->changes = AdaptedTemplatesChanges;
+  entry->last_used = ++blob_cache_clock;
+  entry->rating = copy_choices (ratings);
+  blob_cache_used++;
+}
+
+
+/**********************************************************************
+ * make_blob_key
+ *
+ * Fill in the blob cache key of a blob with the given bounds in the
+ * current row. The key holds the shape of the blob, wherever it is
+ * along the row, as the classifier measures x from the mean x of the
+ * blob, and its height above the baseline, which the classifier uses.
+ * Blobs that start left of x = 0 are kept where they are, as the
+ * rounding of the mean x is only the same for all the copies of a
+ * shape while its x are not negative.
+ **********************************************************************/
+static void make_blob_key(TBLOB *blob,
+                          TPOINT *topleft,
+                          TPOINT *botright,
+                          BLOB_MATCH *key) {
+  int origin;
+
+  origin = topleft->x >= 0 ? topleft->x : 0;
+  key->hash = 2166136261u;
+  key->check = 0;
+  hash_outlines (blob->outlines, origin, &key->hash, &key->check);
+  key->width = botright->x - origin;
+  key->top = topleft->y;
+  key->bottom = botright->y;
+  key->ascrise = match_ascrise;
+  key->descdrop = match_descdrop;
+}
+
+
+/**********************************************************************
+ * free_blob_cache
+ *
+ * Free the blob cache and all its matches.
+ **********************************************************************/
+static void free_blob_cache() {
+  int x;
+
+  for (x = 0; x < blob_cache_slots; x++) {
+    if (blob_cache[x].rating != NULL)
+      destroy_nodes (blob_cache[x].rating, free_choice);
+  }
+  if (blob_cache != NULL)
+    memfree(blob_cache);
+  blob_cache = NULL;
+  blob_cache_slots = 0;
+  blob_cache_used = 0;
+}
+
+
 /*----------------------------------------------------------------------
           Public Function Code
 ----------------------------------------------------------------------*/
@@ -68,38 +417,63 @@ MATCH *match_table;
  * init_match_table
  *
  * Create and clear a match table to be used to speed up the splitter.
+ * The blob cache is kept, as its matches hold across words.
  **********************************************************************/
-static int been_initialized = 0;
 void init_match_table() {
   int x;
 
-  if (been_initialized) {
+  if (match_table_size > 0) {
     /* Reclaim old choices */
-    for (x = 0; x < NUM_MATCH_ENTRIES; x++) {
-      if ((!blank_entry (match_table, x)) && match_table[x].rating)
-        destroy_nodes (match_table[x].rating, free_choice);
-    }
+    clear_match_table();
   }
   else {
     /* Allocate memory once */
-    been_initialized = 1;
-    match_table = (MATCH *) memalloc (sizeof (MATCH) * NUM_MATCH_ENTRIES);
-  }
-  /* Initialize the table */
-  for (x = 0; x < NUM_MATCH_ENTRIES; x++) {
-    match_table[x].topleft = 0;
-    match_table[x].botright = 0;
-    match_table[x].rating = NULL;
+    match_table_size = NUM_MATCH_ENTRIES;
+    match_table = (MATCH *) memalloc (sizeof (MATCH) * match_table_size);
+    for (x = 0; x < match_table_size; x++) {
+      match_table[x].topleft = 0;
+      match_table[x].botright = 0;
+      match_table[x].rating = NULL;
+    }
+    match_table_used = 0;
   }
 }
 
 void end_match_table() {
-  if (been_initialized) {
-    init_match_table();
+  if (match_table_size > 0) {
+    clear_match_table();
     memfree(match_table);
     match_table = NULL;
-    been_initialized = 0;
+    match_table_size = 0;
   }
+  if (blob_cache_debug)
+    print_match_stats();
+  free_blob_cache();
+}
+
+
+/**********************************************************************
+ * set_match_row
+ *
+ * Give the row of the word about to be recognized, as the classifier
+ * sees it. Blobs in the blob cache only match blobs from a like row.
+ **********************************************************************/
+void set_match_row(float ascrise, float descdrop) {
+  match_ascrise = ascrise;
+  match_descdrop = descdrop;
+}
+
+
+/**********************************************************************
+ * print_match_stats
+ *
+ * Print the counts of the blob cache.
+ **********************************************************************/
+void print_match_stats() {
+  tprintf ("Blob cache: %d hits, %d misses, %d stale, %d evicted,"
+           " %d of %d slots used\n",
+           blob_cache_hits, blob_cache_misses, blob_cache_stale,
+           blob_cache_evictions, blob_cache_used, blob_cache_slots);
 }
 
 
@@ -107,37 +481,25 @@ void end_match_table() {
  * put_match
  *
  * Put a new blob and its corresponding match ratings into the match
- * table.
+ * table, and into the blob cache for later words.
  **********************************************************************/
 void put_match(TBLOB *blob, CHOICES ratings) {
   unsigned int topleft;
   unsigned int botright;
-  unsigned int start;
+  BLOB_MATCH key;
   TPOINT tp_topleft;
   TPOINT tp_botright;
-  int x;
-  /* Hash into table */
+
   blob_bounding_box(blob, &tp_topleft, &tp_botright);
   topleft = *(unsigned int *) &tp_topleft;
   botright = *(unsigned int *) &tp_botright;
-  start = (topleft * botright) % NUM_MATCH_ENTRIES;
-
-  /* Look for empty */
-  x = start;
-  do {
-    if (blank_entry (match_table, x)) {
-      /* Add this entry */
-      match_table[x].topleft = topleft;
-      match_table[x].botright = botright;
-      match_table[x].rating = copy_choices (ratings);
-      return;
-    }
-    if (++x >= NUM_MATCH_ENTRIES)
-      x = 0;
+  if ((match_table_used + 1) * 4 > match_table_size * 3)
+    grow_match_table();
+  add_match_entry (topleft, botright, copy_choices (ratings));
+  if (blob_cache_size > 0) {
+    make_blob_key(blob, &tp_topleft, &tp_botright, &key);
+    put_blob_match(&key, ratings);
   }
-  while (x != start);
-
-  cprintf ("error: Match table is full\n");
 }
 
 
@@ -145,18 +507,37 @@ void put_match(TBLOB *blob, CHOICES ratings) {
  * get_match
  *
  * Look up this blob in the match table to see if it needs to be
- * matched.  If it is not present then NULL is returned.
+ * matched. If it is not there, try the blob cache, and copy what is
+ * found to the match table. If it is not present then NULL is returned.
  **********************************************************************/
 CHOICES get_match(TBLOB *blob) {
   unsigned int topleft;
   unsigned int botright;
+  BLOB_MATCH key;
+  CHOICES rating;
+  BLOB_MATCH *entry;
   TPOINT tp_topleft;
   TPOINT tp_botright;
   /* Do starting hash */
   blob_bounding_box(blob, &tp_topleft, &tp_botright);
   topleft = *(unsigned int *) &tp_topleft;
   botright = *(unsigned int *) &tp_botright;
-  return (get_match_by_bounds (topleft, botright));
+  rating = get_match_by_bounds (topleft, botright);
+  if (rating != NIL || blob_cache_size <= 0)
+    return rating;
+
+  make_blob_key(blob, &tp_topleft, &tp_botright, &key);
+  entry = find_blob_match (&key);
+  if (entry == NULL) {
+    blob_cache_misses++;
+    return NIL;
+  }
+  blob_cache_hits++;
+  entry->last_used = ++blob_cache_clock;
+  if ((match_table_used + 1) * 4 > match_table_size * 3)
+    grow_match_table();
+  add_match_entry (topleft, botright, copy_choices (entry->rating));
+  return (copy_choices (entry->rating));
 }
 
 
@@ -167,10 +548,21 @@ CHOICES get_match(TBLOB *blob) {
  * matched.  If it is not present then NULL is returned.
  **********************************************************************/
 CHOICES get_match_by_bounds(unsigned int topleft, unsigned int botright) {
+  return (copy_choices (find_match_by_bounds (topleft, botright)));
+}
+
+
+/**********************************************************************
+ * find_match_by_bounds
+ *
+ * As get_match_by_bounds, but return the list in the match table
+ * itself.  It must not be kept past the end of the word.
+ **********************************************************************/
+CHOICES find_match_by_bounds(unsigned int topleft, unsigned int botright) {
   unsigned int start;
   int x;
   /* Do starting hash */
-  start = (topleft * botright) % NUM_MATCH_ENTRIES;
+  start = (topleft * botright) % match_table_size;
   /* Search for match */
   x = start;
   do {
@@ -180,9 +572,9 @@ CHOICES get_match_by_bounds(unsigned int topleft, unsigned int botright) {
     /* Is this the match ? */
     if (match_table[x].topleft == topleft &&
     match_table[x].botright == botright) {
-      return (copy_choices (match_table[x].rating));
+      return (match_table[x].rating);
     }
-    if (++x >= NUM_MATCH_ENTRIES)
+    if (++x >= match_table_size)
       x = 0;
   }
   while (x != start);
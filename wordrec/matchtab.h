@@ -37,9 +37,15 @@
 void init_match_table();
 void end_match_table();
 
+void set_match_row(float ascrise, float descdrop);
+
+void print_match_stats();
+
 void put_match(TBLOB *blob, CHOICES ratings);
 
 CHOICES get_match(TBLOB *blob);
 
 CHOICES get_match_by_bounds(unsigned int topleft, unsigned int botright);
+
+CHOICES find_match_by_bounds(unsigned int topleft, unsigned int botright);
 #endif
@@ -30,47 +30,155 @@
 #include "freelist.h"
 #include "callcpp.h"
 
+/*----------------------------------------------------------------------
+              V a r i a b l e s
+----------------------------------------------------------------------*/
+#define POOL_BLOCK_SIZE 4096     /* bytes in a normal block */
+#define POOL_ALIGN      8        /* alignment of each piece */
+
+#define pool_round(size)  \
+(((size) + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1))
+
+#define pool_data(block)  \
+((char *) (block) + pool_round (sizeof (POOL_BLOCK)))
+
+static POOL_BLOCK *spare_blocks = NULL;  /* kept for the next word */
+
 /*----------------------------------------------------------------------
               F u n c t i o n s
 ----------------------------------------------------------------------*/
+/**********************************************************************
+ * pool_alloc
+ *
+ * Take a piece of memory for the cells of this matrix.  It lasts until
+ * the matrix is freed.  Normal blocks are reused from the last word.
+ **********************************************************************/
+static char *pool_alloc(MATRIX matrix, int size) {
+  POOL_BLOCK *block;
+  int block_size;
+
+  size = pool_round (size);
+  block = matrix->pool;
+  if (block == NULL || block->used + size > block->size) {
+    if (size <= POOL_BLOCK_SIZE && spare_blocks != NULL) {
+      block = spare_blocks;
+      spare_blocks = block->next;
+    }
+    else {
+      block_size = size > POOL_BLOCK_SIZE ? size : POOL_BLOCK_SIZE;
+      block = (POOL_BLOCK *)
+        memalloc (pool_round (sizeof (POOL_BLOCK)) + block_size);
+      block->size = block_size;
+    }
+    block->used = 0;
+    /* Keep filling the current block after a big one */
+    if (size > POOL_BLOCK_SIZE && matrix->pool != NULL) {
+      block->next = matrix->pool->next;
+      matrix->pool->next = block;
+    }
+    else {
+      block->next = matrix->pool;
+      matrix->pool = block;
+    }
+  }
+  block->used += size;
+  return (pool_data (block) + block->used - size);
+}
+
+
 /**********************************************************************
  * create_matrix
  *
  * Allocate a piece of memory to hold a matrix of choice list pointers.
- * initialize all the elements of the matrix to NULL.
+ * initialize all the elements of the matrix to NOT_CLASSIFIED.
  **********************************************************************/
 MATRIX create_matrix(int dimension) {
   MATRIX m;
   int x;
-  int y;
+  int cells;
 
-  m = (MATRIX) memalloc ((dimension * dimension + 1) * sizeof (LIST));
-  m[0] = (LIST) dimension;
-  for (x = 0; x < dimension; x++)
-    for (y = 0; y < dimension; y++)
-      matrix_put(m, x, y, NOT_CLASSIFIED);
+  cells = dimension * (dimension + 1) / 2;
+  m = (MATRIX) memalloc (sizeof (MATRIX_STRUCT));
+  m->dimension = dimension;
+  m->cells = (CHOICES *) memalloc (cells * sizeof (CHOICES));
+  m->pool = NULL;
+  for (x = 0; x < cells; x++)
+    m->cells[x] = NOT_CLASSIFIED;
   return (m);
 }
 
 
+/**********************************************************************
+ * matrix_put
+ *
+ * Put a copy of a list of choices into the matrix at a specific
+ * location.  The list cells, the choices and their strings are kept
+ * together in one piece of the matrix pool, and go when the matrix is
+ * freed.  The caller still owns the list it passed in.
+ **********************************************************************/
+void matrix_put(MATRIX matrix, int column, int row, CHOICES choices) {
+  CHOICES l;
+  LIST cells;
+  A_CHOICE *copies;
+  char *strings;
+  int num_choices = 0;
+  int size = 0;
+  int x;
+
+  if (choices == NIL || choices == NOT_CLASSIFIED) {
+    matrix->cells[matrix_index (matrix, column, row)] = choices;
+    return;
+  }
+  iterate_list(l, choices) {
+    num_choices++;
+    if (class_string (first_node (l)) != NULL)
+      size += strlen (class_string (first_node (l))) + 1;
+    if (class_lengths (first_node (l)) != NULL)
+      size += strlen (class_lengths (first_node (l))) + 1;
+  }
+  cells = (LIST) pool_alloc (matrix, num_choices * sizeof (_LIST_) +
+    num_choices * sizeof (A_CHOICE) + size);
+  copies = (A_CHOICE *) (cells + num_choices);
+  strings = (char *) (copies + num_choices);
+
+  x = 0;
+  iterate_list(l, choices) {
+    copies[x] = *(A_CHOICE *) first_node (l);
+    if (copies[x].string != NULL) {
+      copies[x].string = strcpy (strings, copies[x].string);
+      strings += strlen (strings) + 1;
+    }
+    if (copies[x].lengths != NULL) {
+      copies[x].lengths = strcpy (strings, copies[x].lengths);
+      strings += strlen (strings) + 1;
+    }
+    cells[x].node = (LIST) &copies[x];
+    cells[x].next = x + 1 < num_choices ? &cells[x + 1] : NIL;
+    x++;
+  }
+  matrix->cells[matrix_index (matrix, column, row)] = cells;
+}
+
+
 /**********************************************************************
  * free_matrix
  *
  * Deallocate the memory taken up by a matrix of match ratings.
  *********************************************************************/
 void free_matrix(MATRIX matrix) {
-  int x;
-  int y;
-  int dimension = matrix_dimension (matrix);
-  CHOICES matrix_cell;
-
-  for (x = 0; x < dimension; x++) {
-    for (y = 0; y < dimension; y++) {
-      matrix_cell = matrix_get (matrix, x, y);
-      if (matrix_cell != NOT_CLASSIFIED)
-        free_choices(matrix_cell);
+  POOL_BLOCK *block;
+  POOL_BLOCK *next_block;
+
+  for (block = matrix->pool; block != NULL; block = next_block) {
+    next_block = block->next;
+    if (block->size == POOL_BLOCK_SIZE) {
+      block->next = spare_blocks;
+      spare_blocks = block;
     }
+    else
+      memfree(block);
   }
+  memfree (matrix->cells);
   memfree(matrix);
 }
 
@@ -31,7 +31,21 @@
 /*----------------------------------------------------------------------
               T y p e s
 ----------------------------------------------------------------------*/
-typedef LIST *MATRIX;            /* Matrix of LIST */
+typedef struct poolblock
+{                                /* POOL_BLOCK */
+  struct poolblock *next;        /* next block of pool */
+  int size;                      /* bytes after header */
+  int used;                      /* bytes given out */
+} POOL_BLOCK;
+
+typedef struct
+{                                /* MATRIX_STRUCT */
+  int dimension;                 /* no of chunks */
+  CHOICES *cells;                /* upper triangle, by column */
+  POOL_BLOCK *pool;              /* choices in the cells */
+} MATRIX_STRUCT;
+
+typedef MATRIX_STRUCT *MATRIX;   /* Matrix of LIST */
 #define NOT_CLASSIFIED (CHOICES) -1
 
 /*----------------------------------------------------------------------
@@ -44,25 +58,19 @@ typedef LIST *MATRIX;            /* Matrix of LIST */
  **********************************************************************/
 
 #define matrix_dimension(matrix)  \
-((long) matrix [0])
+((long) (matrix)->dimension)
 
 /**********************************************************************
  * matrix_index
  *
- * Expression to select a specific location in the matrix.
+ * Expression to select a specific location in the matrix.  Only the
+ * cells with column <= row are kept.  The cells of each column are
+ * together, from row = column down to the last row.
  **********************************************************************/
 
 #define matrix_index(matrix,column,row)  \
-((row) * matrix_dimension(matrix) + (column) + 1)
-
-/**********************************************************************
- * matrix_put
- *
- * Put a list element into the matrix at a specific location.
- **********************************************************************/
-
-#define matrix_put(matrix,column,row,thing)  \
-((matrix) [matrix_index ((matrix), (column), (row))] = (thing))
+((column) * matrix_dimension(matrix) - \
+  (column) * ((column) - 1) / 2 + (row) - (column))
 
 /**********************************************************************
  * matrix_get
@@ -71,13 +79,15 @@ typedef LIST *MATRIX;            /* Matrix of LIST */
  **********************************************************************/
 
 #define matrix_get(matrix,column,row)  \
-((matrix) [matrix_index ((matrix), (column), (row))])
+((matrix)->cells [matrix_index ((matrix), (column), (row))])
 
 /*---------------------------------------------------------------------
           Public Function Prototypes
 ----------------------------------------------------------------------*/
 MATRIX create_matrix(int dimension); 
 
+void matrix_put(MATRIX matrix, int column, int row, CHOICES choices); 
+
 void free_matrix(MATRIX matrix); 
 
 void print_matrix(MATRIX rating_matrix); 
@@ -78,20 +78,22 @@ void init_ms_debug() {
     AddSignalMenuItem (SIGINT, 8, "Context", handle_menu_8);
     AddSignalMenuItem (SIGINT, 9, "Joiner", handle_menu_9);
     #endif
-
-    init_plotseg();
-    init_render_vars();
     #endif
+  }
+  /* Install the variables on every init, as end_recog frees them */
+  #ifndef GRAPHICS_DISABLED
+  init_plotseg();
+  init_render_vars();
+  #endif
 
-    init_baseline();
-    init_bestfirst_vars();
-    init_splitter_vars();
-    init_associate_vars();
-    init_chop();
+  init_baseline();
+  init_bestfirst_vars();
+  init_splitter_vars();
+  init_associate_vars();
+  init_chop();
 
-    init_textord_vars();
-    init_permute_vars();
-  }
+  init_textord_vars();
+  init_permute_vars();
 }
 
 
@@ -341,6 +341,8 @@ CHOICES get_piece_rating(MATRIX ratings,
                      pass,
                      blob_index);
     matrix_put(ratings, start, end, choices);
+    free_choices(choices);
+    choices = matrix_get (ratings, start, end);
   }
   return (choices);
 }
@@ -399,7 +401,7 @@ MATRIX record_piece_ratings(TBLOB *blobs) {
       bounds_of_piece(bounds, x, y, &tp_topleft, &tp_botright);
       topleft = *(unsigned int *) &tp_topleft;
       botright = *(unsigned int *) &tp_botright;
-      choices = get_match_by_bounds (topleft, botright);
+      choices = find_match_by_bounds (topleft, botright);
       if (choices != NIL) {
         matrix_put(ratings, x, y, choices);
       }
@@ -45,6 +45,11 @@ make_toggle_var (display_splits, 0, make_display_splits,
 makestructure (newsplit, free_split, printsplit, SPLIT,
 freesplit, SPLITBLOCK, "SPLIT", splitcount);
 
+#define POOLBLOCK  1024          /* Points per pool block */
+static EDGEPT **pool_blocks = NULL;  /* Points made by the chopper */
+static int pool_num_blocks = 0;
+static int pool_used = 0;        /* Points given out */
+
 /*----------------------------------------------------------------------
               F u n c t i o n s
 ----------------------------------------------------------------------*/
@@ -72,6 +77,82 @@ void delete_split(SPLIT *split) {
 }
 
 
+/**********************************************************************
+ * new_pool_edgept
+ *
+ * Take the next EDGEPT from the pool of points made while chopping the
+ * current word.  The pool grows a block at a time and its points stay
+ * until reset_edgept_pool, so oldedgept leaves them alone.
+ **********************************************************************/
+EDGEPT *new_pool_edgept() { 
+  EDGEPT *this_edgept;
+
+  if (pool_used == pool_num_blocks * POOLBLOCK) {
+    if (pool_blocks == NULL)
+      pool_blocks = (EDGEPT **) memalloc (sizeof (EDGEPT *));
+    else
+      pool_blocks = (EDGEPT **) memrealloc (pool_blocks,
+        (pool_num_blocks + 1) * sizeof (EDGEPT *),
+        pool_num_blocks * sizeof (EDGEPT *));
+    pool_blocks[pool_num_blocks++] =
+      (EDGEPT *) memalloc (POOLBLOCK * sizeof (EDGEPT));
+  }
+  this_edgept = &pool_blocks[pool_used / POOLBLOCK][pool_used % POOLBLOCK];
+  pool_used++;
+  this_edgept->flags[EDGEPT_POOLED] = 1;
+  return (this_edgept);
+}
+
+
+/**********************************************************************
+ * edgept_pool_mark
+ *
+ * Return a checkpoint of the point pool for edgept_pool_rollback.
+ **********************************************************************/
+int edgept_pool_mark() { 
+  return (pool_used);
+}
+
+
+/**********************************************************************
+ * edgept_pool_rollback
+ *
+ * Take back all the points made since this checkpoint.  None of them
+ * may still be linked into an outline.
+ **********************************************************************/
+void edgept_pool_rollback(int mark) { 
+  pool_used = mark;
+}
+
+
+/**********************************************************************
+ * reset_edgept_pool
+ *
+ * Empty the point pool for the next word.  The outlines of the last
+ * word chopped must have been deleted already.
+ **********************************************************************/
+void reset_edgept_pool() { 
+  pool_used = 0;
+}
+
+
+/**********************************************************************
+ * free_edgept_pool
+ *
+ * Give back all the memory of the point pool.
+ **********************************************************************/
+void free_edgept_pool() { 
+  int x;
+
+  for (x = 0; x < pool_num_blocks; x++)
+    memfree (pool_blocks[x]);
+  memfree(pool_blocks);
+  pool_blocks = NULL;
+  pool_num_blocks = 0;
+  pool_used = 0;
+}
+
+
 /**********************************************************************
  * make_edgept
  *
@@ -80,7 +161,7 @@ void delete_split(SPLIT *split) {
 EDGEPT *make_edgept(int x, int y, EDGEPT *next, EDGEPT *prev) { 
   EDGEPT *this_edgept;
   /* Create point */
-  this_edgept = newedgept ();
+  this_edgept = new_pool_edgept ();
   this_edgept->pos.x = x;
   this_edgept->pos.y = y;
   /* Hook it up */
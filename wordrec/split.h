@@ -71,6 +71,16 @@ void init_splitter_vars();
 
 void delete_split(SPLIT *split); 
 
+EDGEPT *new_pool_edgept(); 
+
+int edgept_pool_mark(); 
+
+void edgept_pool_rollback(int mark); 
+
+void reset_edgept_pool(); 
+
+void free_edgept_pool(); 
+
 EDGEPT *make_edgept(int x, int y, EDGEPT *next, EDGEPT *prev); 
 
 SPLIT *new_split(EDGEPT *point1, EDGEPT *point2); 
@@ -182,9 +182,10 @@ void program_editdown(inT32 elasped_time) {
   if (tessedit_save_stats)
     save_summary (elasped_time);
   end_match_table();
+  free_edgept_pool();
   InitChoiceAccum();
   if (global_hash != NULL) {
-    free_mem(global_hash);
+    delete_hash_table(global_hash);
     global_hash = NULL;
   }
   end_metrics();